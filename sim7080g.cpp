@@ -1,5 +1,54 @@
 //Header files
 #include "sim7080g.h"
+#if SIM7080G_NET_STORE
+#include <Preferences.h>
+#endif
+
+//Hot path events go to the trace ring instead of the debug interface
+#if SIM7080G_TRACE
+#define SIM7080G_TRACE_EVENT(id, a, b)      Trace(id, a, b)
+static_assert((SIM7080G_TRACE_EVENTS & (SIM7080G_TRACE_EVENTS - 1)) == 0, "SIM7080G_TRACE_EVENTS must be a power of two");
+#else
+#define SIM7080G_TRACE_EVENT(id, a, b)
+#endif
+
+//Public functions run as one transaction of their lane
+#if SIM7080G_THREAD_SAFE
+#define SIM7080G_LANE_GUARD(lane)           SIM7080G_LOCK laneGuard(this, lane)
+#else
+#define SIM7080G_LANE_GUARD(lane)
+#endif
+
+//Trace event formats (index: SIM7080G_TRACE_ID, arguments: a, b)
+static const char* const traceFormats[SIM_TRACE_IDS] = {
+    "Network Registration status: %ld",
+    "APP Network %ld status: %ld",
+    "GNSS Power status: %ld",
+    "GNSS update: run status %ld, %ld GNSS satellites in view",
+    "Battery voltage: %ld mV",
+    "Ping replies received: %ld out of %ld"
+};
+
+//Session profile parameters (bits of profileKnown)
+enum SIM7080G_PROFILE_FIELD {
+    SIM_PROFILE_FTP_PORT,
+    SIM_PROFILE_FTP_MODE,
+    SIM_PROFILE_FTP_TYPE,
+    SIM_PROFILE_FTP_CID,
+    SIM_PROFILE_FTP_SERVER,
+    SIM_PROFILE_FTP_USER,
+    SIM_PROFILE_FTP_PASS,
+    SIM_PROFILE_FTP_UPNAME,
+    SIM_PROFILE_FTP_UPPATH,
+    SIM_PROFILE_FTP_DOWNNAME,
+    SIM_PROFILE_FTP_DOWNPATH,
+    SIM_PROFILE_HTTP_URL,
+    SIM_PROFILE_HTTP_BODYLEN,
+    SIM_PROFILE_HTTP_HEADERLEN,
+    SIM_PROFILE_HTTP_SSL
+};
+
+#define SIM7080G_PROFILE_HTTP_MASK          ((1UL << SIM_PROFILE_HTTP_URL) | (1UL << SIM_PROFILE_HTTP_BODYLEN) | (1UL << SIM_PROFILE_HTTP_HEADERLEN) | (1UL << SIM_PROFILE_HTTP_SSL))
 
 //  "It ain't much but it's honest work"
 /**
@@ -45,23 +94,326 @@ long long int CharToNmbr(char* number, size_t len = 0) {
     return val;
 }
 
+/**
+ *  @brief 32 bit FNV-1a hash
+ * 
+ *  @param data         Data to hash
+ *  @param len          Data length
+ * 
+ *  @returns Hash value
+*/
+uint32_t Fnv1a(const uint8_t* data, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/**
+ *  @brief Convert a bit string ("0101") to a number
+ * 
+ *  @param bits         Start of the bit string (a leading quote is skipped)
+ *  @param len          Number of bits
+ * 
+ *  @returns Value or -1 if the string is invalid
+*/
+long BitsToNmbr(const char* bits, size_t len) {
+    if (*bits == '\"')
+        bits++;
+
+    long value = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (bits[i] != '0' && bits[i] != '1')
+            return -1;
+        value = (value << 1) | (bits[i] - '0');
+    }
+    return value;
+}
+
+/**
+ *  @brief Moving average of RAT measurements (weight of a new sample: 1/4)
+ * 
+ *  @param average      Current average (0: no samples yet)
+ *  @param sample       New sample
+ * 
+ *  @returns Updated average
+*/
+static uint32_t SmoothAverage(uint32_t average, uint32_t sample) {
+    return average ? (uint32_t)(((uint64_t)average * 3 + sample) / 4) : sample;
+}
+
+/**
+ *  @brief Convert a UTC date to milliseconds since 1970-01-01
+ * 
+ *  @returns Milliseconds or 0 if the date is invalid (or before 2020 from a clock that was never set)
+*/
+static uint64_t UnixMillis(int year, int month, int day, int hour, int minute, int second) {
+    if (year < 2020 || month < 1 || month > 12 || day < 1 || day > 31 || hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60)
+        return 0;
+
+    //Days from the civil date, years starting in March put the leap day last
+    year -= month <= 2;
+    uint32_t era = year / 400;
+    uint32_t yoe = year - era * 400;
+    uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    uint64_t days = (uint64_t)era * 146097 + doe - 719468;
+    return (days * 86400 + hour * 3600 + minute * 60 + second) * 1000;
+}
+
+//
+SIM7080G* SIM7080G::instances[SIM7080G_MAX_INSTANCES] = { nullptr };
+TaskHandle_t SIM7080G::workerTask = nullptr;
+SemaphoreHandle_t SIM7080G::workerExit = nullptr;
+volatile bool SIM7080G::workerRun = false;
+uint32_t SIM7080G::workerInterval = 10;
+SIM7080G_WORKER_HOOK SIM7080G::workerHook = nullptr;
+
 //
-SIM7080G::SIM7080G(uint8_t rx, uint8_t tx, uint8_t pwr, int dtr, bool openUART) {
+SIM7080G::SIM7080G(uint8_t rx, uint8_t tx, uint8_t pwr, int dtr, bool openUART, HardwareSerial& uart) : uartInterface(uart) {
     this->uartRX = rx;
     this->uartTX = tx;
     this->pwrKey = pwr;
     this->dtrKey = dtr;
 
+#if SIM7080G_SHADOW
+    bootStart = millis();
+#endif
+
+#if SIM7080G_THREAD_SAFE
+    //Command arbitration
+    laneMutex = xSemaphoreCreateMutex();
+#if SIM7080G_ENABLE_CMUX
+    cmuxMutex = xSemaphoreCreateRecursiveMutex();
+#endif
+#endif
+
+#if SIM7080G_ENABLE_CMUX
+    //Virtual channels of the multiplexer
+    for (uint8_t i = 0; i < SIM7080G_CMUX_CHANNELS; i++) {
+        cmuxChannels[i].owner = this;
+        cmuxChannels[i].dlci = i + 1;
+    }
+#endif
+
     //Setup DTR key
     if (dtr >= 0) {
         pinMode(dtrKey, OUTPUT);
         digitalWrite(dtrKey, LOW);
     }
 
+    //Register for PollAll() and the worker
+    uint8_t slot = 0;
+    while (slot < SIM7080G_MAX_INSTANCES && instances[slot])
+        slot++;
+    if (slot < SIM7080G_MAX_INSTANCES)
+        instances[slot] = this;
+#if SIM7080G_DEBUG_LEVEL >= 1
+    else
+        uartDebugInterface.printf("\tSIM7080G - Instance not registered, SIM7080G_MAX_INSTANCES (%u) reached, call Loop() directly\n", (unsigned)SIM7080G_MAX_INSTANCES);
+#endif
+
     if(openUART) {
         OpenUART();
-        SetTAResponseFormat();
+        ApplyInitProfile();     //Only configures a running module without the stored profile
+    }
+}
+
+//
+SIM7080G::~SIM7080G() {
+    for (uint8_t i = 0; i < SIM7080G_MAX_INSTANCES; i++)
+        if (instances[i] == this)
+            instances[i] = nullptr;
+
+#if SIM7080G_THREAD_SAFE
+    if (laneMutex)
+        vSemaphoreDelete(laneMutex);
+#if SIM7080G_ENABLE_CMUX
+    if (cmuxMutex)
+        vSemaphoreDelete(cmuxMutex);
+#endif
+#endif
+}
+
+//  #
+//  #   Instances
+//  #
+
+//
+void SIM7080G::PollAll() {
+    for (uint8_t i = 0; i < SIM7080G_MAX_INSTANCES; i++)
+        if (instances[i])
+            instances[i]->Loop(false);
+}
+
+//
+bool SIM7080G::StartWorker(uint32_t interval, SIM7080G_WORKER_HOOK hook, uint32_t stackSize, uint8_t priority) {
+    workerInterval = interval;
+    workerHook = hook;
+    if (workerTask && workerRun)
+        return true;
+
+    //Let a stopping worker exit first
+    StopWorker();
+    if (workerTask) {
+        //Restarted from the hook, the worker simply keeps running
+        workerRun = true;
+        return true;
+    }
+
+    if (!workerExit)
+        workerExit = xSemaphoreCreateBinary();
+    if (!workerExit)
+        return false;
+
+    workerRun = true;
+    if (xTaskCreate(WorkerTask, "SIM7080G", stackSize, nullptr, priority, &workerTask) != pdPASS) {
+        workerRun = false;
+        workerTask = nullptr;
+        return false;
+    }
+    return true;
+}
+
+//
+void SIM7080G::StopWorker() {
+    workerRun = false;
+    if (!workerTask || xTaskGetCurrentTaskHandle() == workerTask)
+        return;
+
+    //Wait until the worker left its loop
+    xSemaphoreTake(workerExit, portMAX_DELAY);
+    workerTask = nullptr;
+}
+
+//
+uint8_t SIM7080G::GetInstanceCount() {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < SIM7080G_MAX_INSTANCES; i++)
+        if (instances[i])
+            count++;
+    return count;
+}
+
+//
+SIM7080G* SIM7080G::GetInstance(uint8_t index) {
+    for (uint8_t i = 0; i < SIM7080G_MAX_INSTANCES; i++)
+        if (instances[i] && !index--)
+            return instances[i];
+    return nullptr;
+}
+
+//  #
+//  #   Arbitration
+//  #
+
+//
+bool SIM7080G::Lock(SIM7080G_LANE lane, uint32_t timeout) {
+    return AcquireLane(lane, timeout, true);
+}
+
+//
+bool SIM7080G::AcquireLane(SIM7080G_LANE lane, uint32_t timeout, bool count) {
+#if SIM7080G_THREAD_SAFE
+    //Single task before the scheduler runs (e.g. global constructors)
+    if (!laneMutex || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING)
+        return true;
+
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    xSemaphoreTake(laneMutex, portMAX_DELAY);
+
+    //Nested call of the running transaction
+    if (laneDepth && laneOwner == self) {
+        laneDepth++;
+        xSemaphoreGive(laneMutex);
+        return true;
     }
+
+    uint32_t start = millis();
+    bool contended = false;
+    laneWaiting[lane]++;
+
+    while (true) {
+        //Free and no task waiting in a higher lane
+        bool higher = false;
+        for (uint8_t i = 0; i < lane; i++)
+            higher |= laneWaiting[i] > 0;
+
+        if (!laneDepth && !higher) {
+            uint32_t wait = millis() - start;
+            laneWaiting[lane]--;
+            laneOwner = self;
+            laneOwnerLane = lane;
+            laneDepth = 1;
+
+            if (count) {
+                SIM7080G_LANE_STATS& stats = laneStats[lane];
+                stats.acquisitions++;
+                stats.totalWait += wait;
+                if (contended)
+                    stats.contended++;
+                if (wait > stats.maxWait)
+                    stats.maxWait = wait;
+            }
+
+            xSemaphoreGive(laneMutex);
+            return true;
+        }
+
+        if (millis() - start >= timeout) {
+            laneWaiting[lane]--;
+            if (timeout)
+                laneStats[lane].timeouts++;
+            xSemaphoreGive(laneMutex);
+            return false;
+        }
+
+        //Waiters poll, the owner is never blocked on the lane state
+        contended = true;
+        xSemaphoreGive(laneMutex);
+        vTaskDelay(1);
+        xSemaphoreTake(laneMutex, portMAX_DELAY);
+    }
+#else
+    (void)lane;
+    (void)timeout;
+    (void)count;
+    return true;
+#endif
+}
+
+//
+void SIM7080G::Unlock() {
+#if SIM7080G_THREAD_SAFE
+    if (!laneMutex || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING)
+        return;
+
+    xSemaphoreTake(laneMutex, portMAX_DELAY);
+    if (laneDepth && laneOwner == xTaskGetCurrentTaskHandle() && !--laneDepth)
+        laneOwner = nullptr;
+    xSemaphoreGive(laneMutex);
+#endif
+}
+
+//
+SIM7080G_LANE_STATS SIM7080G::GetLaneStats(SIM7080G_LANE lane) const {
+#if SIM7080G_THREAD_SAFE
+    if (lane < SIM_LANES)
+        return laneStats[lane];
+#else
+    (void)lane;
+#endif
+    return SIM7080G_LANE_STATS();
+}
+
+//
+void SIM7080G::ResetLaneStats() {
+#if SIM7080G_THREAD_SAFE
+    for (uint8_t i = 0; i < SIM_LANES; i++)
+        laneStats[i] = SIM7080G_LANE_STATS();
+#endif
 }
 
 //  #
@@ -78,19 +430,28 @@ void SIM7080G::SetDTR(int dtr) {
 }
 
 //
-void SIM7080G::PowerUp() {
+void SIM7080G::SetStatusPin(int status) {
+    statusPin = status;
+    if (status >= 0)
+        pinMode(statusPin, INPUT);
+}
+
+//
+bool SIM7080G::PowerUp() {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
 #if v
     uartDebugInterface.printf("DEBUG START: PowerUp()\n");
 #endif
-    //Test if device is already powered up
-    if (TestUART()){
+    //Test if device is already powered up (answers in any response format)
+    bool stored = false;
+    if ((statusPin < 0 || digitalRead(statusPin) == HIGH) && ProbeAT(stored)){
 #if SIM7080G_DEBUG_LEVEL >= 2
         uartDebugInterface.printf("\tDevice already powered up! Nothing to do here...\nDEBUG END: PowerUp()\n");
 #elif SIM7080G_DEBUG_LEVEL == 1
         uartDebugInterface.printf("\tSIM7080G - Device already powered up! Nothing to do here...\n");
 #endif
         pwrState = SIM_PWUP;
-        return;
+        return ApplyInitProfile();
     }
 
     //Power cycle device
@@ -102,22 +463,136 @@ void SIM7080G::PowerUp() {
 #endif
         pwrState = SIM_PWUP;
         PowerCycle();
-        delay(2000);    //Min delay specified is 1.8s
-        SetTAResponseFormat();
+        ShadowBoot();
+        if (!WaitReady())
+            return false;
+        return ApplyInitProfile();
+    }
+
+    return false;
+}
+
+//
+bool SIM7080G::WaitReady(uint32_t timeout) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    uint32_t start = millis();
+    bool ready = false;
+    bool rdy = false;
+    bool stored = false;
+    rxBuffer[0] = '\0';
+
+    while (!ready && millis() - start < timeout) {
+        //STATUS goes high once the module runs, the UART answers shortly after
+        if (statusPin >= 0 && digitalRead(statusPin) == LOW) {
+            delay(10);
+            continue;
+        }
+
+        //RDY is only sent with a fixed baud rate (AT+IPR set by the application)
+        rdy |= WaitForResponse("RDY", SIM7080G_BOOT_PROBE);
+
+        bootStats.probes++;
+        ready = ProbeAT(stored);
+    }
+
+    uint32_t elapsed = millis() - start;
+    bootStats.boots++;
+    if (!ready) {
+        bootStats.failures++;
+#if SIM7080G_DEBUG_LEVEL >= 1
+        uartDebugInterface.printf("\tSIM7080G - No answer %lu ms after boot\n", (unsigned long)elapsed);
+#endif
+        return false;
+    }
+
+    if (rdy)
+        bootStats.rdy++;
+    bootStats.lastTime = elapsed;
+    bootStats.totalTime += elapsed;
+    if (elapsed > bootStats.maxTime)
+        bootStats.maxTime = elapsed;
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+    uartDebugInterface.printf("\tSIM7080G - Ready %lu ms after boot (%s)\n", (unsigned long)elapsed, rdy ? "RDY" : "AT probe");
+#endif
+    return true;
+}
+
+//
+bool SIM7080G::ApplyInitProfile(bool force) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+#if SIM7080G_ENABLE_CMUX
+    //AT+IPR and AT+IFC are not safe below the multiplexer
+    if (cmuxActive)
+        return true;
+#endif
+
+    //The factory default answers with echo and verbose result codes, the saved profile does not
+    bool stored = false;
+    if (!ProbeAT(stored))
+        return false;
+
+    //A module only left in ATE0V0 (e.g. by NegotiateBaudrate()) answers the same way, the saved URC setting tells them apart
+    if (stored && !force) {
+        SendCommand("AT+CEREG?\r", rxBuffer);
+        stored = strstr(rxBuffer, "+CEREG: 4,") != nullptr;
+    }
+
+    bool result = true;
+    if (stored && !force)
+        bootStats.profileStored++;
+    else {
+        //Basic commands in one line, any response format is accepted
+        SendCommand("ATE0V0\r", rxBuffer);
+
+        //Numeric "+CME ERROR: <n>" codes could end like the result code 0
+        result = SendCommand("AT+CMEE=0\r");
+        result = result && SendCommand("AT+CEREG=4\r");
+        result = result && SendCommand("AT&W\r");
+
+        if (result)
+            bootStats.profileWritten++;
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+        uartDebugInterface.printf("\tSIM7080G - Init profile saved: %s\n", result ? "OK" : "FAILED");
+#endif
     }
+
+    //Flow control is set after AT&W and lasts until the module restarts, saved it could lock out a host restarting without RTS/CTS
+    return SendCommand(uartRTS >= 0 && uartCTS >= 0 ? "AT+IFC=2,2\r" : "AT+IFC=0,0\r") && result;
+}
+
+//
+SIM7080G_BOOT_STATS SIM7080G::GetBootStats(void) const {
+    return bootStats;
+}
+
+//
+void SIM7080G::ResetBootStats(void) {
+    bootStats = SIM7080G_BOOT_STATS();
 }
 
 //
 void SIM7080G::PowerDown() {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
     if(pwrState == SIM_PWUP) {
         PowerCycle();
         pwrState = SIM_PWDN;
+        InvalidateShadow(true);
+#if SIM7080G_ENABLE_CMUX
+        CMUXReset();
+#endif
     }
 }
 
 //
 void SIM7080G::Reboot() {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
     SendCommand("AT+CREBOOT\r");
+    ShadowBoot();
+#if SIM7080G_ENABLE_CMUX
+    CMUXReset();    //Module boots with the plain AT interface
+#endif
 }
 
 //
@@ -147,14 +622,21 @@ SIM7080G_PWR SIM7080G::GetPowerState() const {
 
 //
 void SIM7080G::OpenUART() {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
     if(!uartOpen) {
+        uartInterface.setRxBufferSize(SIM7080G_UART_RX_FIFO);     //Must be set before begin()
         uartInterface.begin(uartBaudrate, SERIAL_8N1, uartRX, uartTX);
+        if (uartRTS >= 0 && uartCTS >= 0) {
+            uartInterface.setPins(uartRX, uartTX, uartCTS, uartRTS);
+            uartInterface.setHwFlowCtrlMode(UART_HW_FLOWCTRL_CTS_RTS);
+        }
         uartOpen = true;
     }
 }
 
 //
 void SIM7080G::CloseUART() {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
     if(uartOpen) {
         uartInterface.end();
         uartOpen = false;
@@ -163,21 +645,36 @@ void SIM7080G::CloseUART() {
 
 //
 void SIM7080G::FlushUART() {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
     uartInterface.flush(false);
 }
 
 //
 size_t SIM7080G::AvailableUART() {
-    return uartInterface.available();
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    return Transport().available();
 }
 
 //
 size_t SIM7080G::SendCommand(const char* command, char* response, uint32_t timeout) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
     if(!command)
         return 0;   //Retur 0 if command is nullptr
     
+    Stream& io = Transport();
+
+#if SIM7080G_METRICS
+    MetricsBegin(command);
+#endif
+
     //Send command
-    uartInterface.print(command);
+    io.print(command);
+
+#if SIM7080G_SHADOW
+    shadowStats.roundTrips++;
+    if (bootCounting)
+        shadowStats.bootRoundTrips++;
+#endif
 
     //Read data from device
     size_t bytesRecv = 0;
@@ -185,16 +682,23 @@ size_t SIM7080G::SendCommand(const char* command, char* response, uint32_t timeo
     if(response) {
         //Wait for response
         if (timeout > 0)
-            for(size_t i = 0; i < timeout && !uartInterface.available(); i++)
+            for(size_t i = 0; i < timeout && !io.available(); i++)
                 delay(1);
         else
             delay(uartRecvtimeout);
     
-        while(uartInterface.available() && bytesRecv < uartMaxRecvSize)
-            response[bytesRecv++] = (char)uartInterface.read();
+        while(io.available() && bytesRecv < uartMaxRecvSize - 1)
+            response[bytesRecv++] = (char)io.read();
         response[bytesRecv] = 0;
+
+        //URCs might arrive mixed into the response
+        ScanURC(response);
     }
 
+#if SIM7080G_METRICS
+    MetricsEnd(bytesRecv, response && !bytesRecv);
+#endif
+
 #if SIM7080G_DEBUG_LEVEL >= 3
     //Command debug
     uartDebugInterface.printf("DEBUG START: SendCommand(char*, char*)\n");
@@ -220,10 +724,16 @@ size_t SIM7080G::SendCommand(const char* command, char* response, uint32_t timeo
 
 //
 bool SIM7080G::SendCommand(const char* command, uint32_t timeout) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
     size_t bytesRecv = SendCommand(command, rxBuffer, timeout);
 
     bool result = bytesRecv >= 2 && rxBuffer[bytesRecv - 2] == '0';
 
+#if SIM7080G_METRICS
+    if (!result)
+        MetricsFail();
+#endif
+
 #if SIM7080G_DEBUG_LEVEL >= 3
     //Command debug
     uartDebugInterface.printf("DEBUG START: SendCommand(char*)\n");
@@ -241,19 +751,30 @@ bool SIM7080G::SendCommand(const char* command, uint32_t timeout) {
 
 //
 void SIM7080G::Send(uint8_t* src, size_t len) {
-    uartInterface.write(src, len);
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    Transport().write(src, len);
+#if SIM7080G_METRICS
+    if (metricsOpen)
+        metrics[metricsSpan.family].bytesOut += len;
+#endif
 }
 
 //
 size_t SIM7080G::Receive(uint8_t* dst, size_t len, uint32_t timeout) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    Stream& io = Transport();
     size_t bytesRecv = 0;
 
     if (timeout > 0)
-        for(size_t i = 0; i < timeout && !uartInterface.available(); i++)
+        for(size_t i = 0; i < timeout && !io.available(); i++)
             delay(1);
 
-    for (;uartInterface.available() && (len ? bytesRecv < len : true);) 
-        dst[bytesRecv++] = (uint8_t)uartInterface.read();
+    for (;io.available() && (len ? bytesRecv < len : true);) 
+        dst[bytesRecv++] = (uint8_t)io.read();
+
+#if SIM7080G_METRICS
+    MetricsEnd(bytesRecv, false);
+#endif
     
     return bytesRecv;
 }
@@ -264,831 +785,5863 @@ bool SIM7080G::GetUART() const { return uartOpen; }
 //
 uint64_t SIM7080G::GetBaudrate() const { return uartBaudrate; }
 
+//
+uint32_t SIM7080G::NegotiateBaudrate(uint32_t maxBaudrate, int rtsPin, int ctsPin) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    const uint32_t rates[] = { 3686400, 3000000, 921600, 460800, 230400, 115200 };
+    const uint8_t rateCount = sizeof(rates) / sizeof(rates[0]);
+
+#if SIM7080G_ENABLE_CMUX
+    //AT+IPR is not safe below the multiplexer
+    if (cmuxActive)
+        return uartBaudrate;
+#endif
+
+    //Find the module's current rate if the configured one does not work
+    if (!TestUART()) {
+        uint8_t i = 0;
+        for (; i < rateCount; i++) {
+            SetHostBaudrate(rates[i]);
+            if (TestUART())
+                break;
+        }
+        if (i == rateCount) {
+#if SIM7080G_DEBUG_LEVEL >= 1
+            uartDebugInterface.printf("\tSIM7080G - Baudrate negotiation: No response from device!\n");
+#endif
+            return 0;
+        }
+    }
+
+    //The verification switches echo on, the answer shows what to restore
+    bool echo = !strncmp(rxBuffer, "AT+CGMI=?\r", 10);
+
+    //Hardware flow control on both sides, before the rate goes up
+    if (rtsPin >= 0 && ctsPin >= 0 && SendCommand("AT+IFC=2,2\r")) {
+        uartRTS = rtsPin;
+        uartCTS = ctsPin;
+        uartInterface.setPins(uartRX, uartTX, uartCTS, uartRTS);
+        uartInterface.setHwFlowCtrlMode(UART_HW_FLOWCTRL_CTS_RTS);
+    }
+
+    char buffer[24] = { '\0' };
+
+    for (uint8_t i = 0; i < rateCount; i++) {
+        uint32_t rate = rates[i];
+        uint32_t previous = uartBaudrate;
+
+        if (rate > maxBaudrate)
+            continue;
+        if (rate <= previous)
+            break;      //Already at least this fast
+
+        //The module answers at the old rate, then switches
+        sprintf(buffer, "AT+IPR=%lu\r", (unsigned long)rate);
+        if (!SendCommand(buffer))
+            continue;
+
+        uartInterface.flush();
+        SetHostBaudrate(rate);
+        delay(20);
+
+        if (VerifyUART(8, echo)) {
+#if SIM7080G_DEBUG_LEVEL >= 1
+            uartDebugInterface.printf("\tSIM7080G - Baudrate negotiation: %lu baud\n", (unsigned long)rate);
+#endif
+            return rate;
+        }
+
+        //Rate does not work, switch the module back from the new rate
+        sprintf(buffer, "AT+IPR=%lu\r", (unsigned long)previous);
+        for (uint8_t j = 0; j < 3; j++) {
+            SendCommand(buffer);
+            delay(20);
+        }
+        SetHostBaudrate(previous);
+        delay(20);
+
+        if (!TestUART()) {
+            //The module might still be at the new rate, switch it back from there
+            SetHostBaudrate(rate);
+            if (TestUART() && SendCommand(buffer))
+                uartInterface.flush();
+            SetHostBaudrate(previous);
+            delay(20);
+
+            if (!TestUART()) {
+                //Never talk at a rate whose probe failed, stay at the last verified one
+#if SIM7080G_DEBUG_LEVEL >= 1
+                uartDebugInterface.printf("\tSIM7080G - Baudrate negotiation: No response after %lu baud, staying at %lu!\n", (unsigned long)rate, (unsigned long)previous);
+#endif
+                return 0;
+            }
+        }
+
+        //The failed verification may have left echo on
+        SetEcho(echo);
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+        uartDebugInterface.printf("\tSIM7080G - Baudrate negotiation: %lu baud failed, falling back to %lu\n", (unsigned long)rate, (unsigned long)previous);
+#endif
+    }
+
+    return uartBaudrate;
+}
+
 //
 bool SIM7080G::TestUART() {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
     return SendCommand("AT+CGMI=?\r");
 }
 
 //
 void SIM7080G::SetTAResponseFormat(bool textResponse) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
     SendCommand(textResponse ? (char*)"ATV1\r" : (char*)"ATV0\r");
 }
 
 //
 bool SIM7080G::SetEcho(bool echo) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
     return SendCommand(echo ? "ATE1\r" : "ATE0\r");
 }
 
-//  #
-//  #   Cellular communication
-//  #
-
+#if SIM7080G_ENABLE_CMUX
 //
-uint8_t SIM7080G::GetNetworkReg(void) {
-    size_t bytesRecv = SendCommand("AT+CREG?\r", rxBuffer);
-    char* startPtr = strchr(rxBuffer, ',');
-    if (!startPtr)
-        return 255;
-    uint8_t status = *(startPtr + 1) - '0';
+bool SIM7080G::StartCMUX() {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (cmuxActive)
+        return true;
+
+    //Basic option, UIH frames, default parameters
+    if (!SendCommand("AT+CMUX=0\r"))
+        return false;
+
+    CMUXReset();
+
+    //Control channel first, then DLCI 1 which takes over the driver's commands
+    if (!CMUXConnect(0, 0x3F, 3000) || !CMUXConnect(1, 0x3F, 3000)) {
 #if SIM7080G_DEBUG_LEVEL >= 1
-    uartDebugInterface.printf("\tSIM7080G - Network Registration status: %d\n", status);
+        uartDebugInterface.printf("\tSIM7080G - CMUX: Channel setup failed!\n");
 #endif
-    return status;
-}
-
-//
-uint8_t SIM7080G::GetSignalQuality() {
-    
-    size_t bytesRecv = SendCommand("AT+CSQ\r", rxBuffer);
+        StopCMUX();
+        return false;
+    }
+    cmuxActive = true;
 
-    if(bytesRecv == 0)
-        return 255;
+    //Channels that fail stay closed
+    for (uint8_t dlci = 2; dlci <= SIM7080G_CMUX_CHANNELS; dlci++)
+        CMUXConnect(dlci, 0x3F, 3000);
 
-    char* startPtr = rxBuffer;
-    while ((*startPtr) != ':' && (*startPtr) != '\0')
-        startPtr++;
-    startPtr++;     //Step forward another
+    //Every channel starts with the module's default result format
+    SetTAResponseFormat();
+    SetEcho(false);
 
-    uint8_t offset = 0;
-    for (; startPtr[offset] != ',' && startPtr[offset] != '\0'; offset++);
+#if SIM7080G_DEBUG_LEVEL >= 1
+    uartDebugInterface.printf("\tSIM7080G - CMUX: Started\n");
+#endif
 
-    //Check against mem overflow
-    return bytesRecv <= uartMaxRecvSize && startPtr + 2 <= rxBuffer + uartMaxRecvSize ? CharToNmbr(startPtr, offset) : SIM7080_SIGNAL_QUALITY_UNKNOWN;
+    return true;
 }
 
+//
+void SIM7080G::StopCMUX() {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    //Disconnect the virtual channels
+    for (uint8_t dlci = SIM7080G_CMUX_CHANNELS; dlci > 0; dlci--)
+        if (cmuxChannels[dlci - 1].open)
+            CMUXConnect(dlci, 0x53, 1000);
 
-//void SIM7080G::GetCellOperators(HardwareSerial& debugInterface);
-
+    //Close down the multiplexer
+    const uint8_t cld[] = { 0xC3, 0x01 };
+    CMUXSendFrame(0, 0xEF, cld, sizeof(cld));
+    uartInterface.flush();
+    delay(100);
 
-//size_t SIM7080G::GetCellOperators(char* dst);
+    CMUXReset();
 
+    //Drop the remaining frames
+    while (uartInterface.available())
+        uartInterface.read();
 
-//void SIM7080G::SetCellOperator(char* opName);
-
-
-//uint8_t SIM7080G::GetCellFunction(void);
-
+#if SIM7080G_DEBUG_LEVEL >= 1
+    uartDebugInterface.printf("\tSIM7080G - CMUX: Stopped\n");
+#endif
+}
 
-//void SIM7080G::SetCellFunction(uint8_t functionCode);
+//
+bool SIM7080G::CMUXActive() const {
+    return cmuxActive;
+}
 
+//
+Stream* SIM7080G::GetCMUXChannel(uint8_t dlci) {
+    if (!cmuxActive || dlci < 2 || dlci > SIM7080G_CMUX_CHANNELS || !cmuxChannels[dlci - 1].open)
+        return nullptr;
+    return &cmuxChannels[dlci - 1];
+}
 
-//void SIM7080G::GetTime(char* dst);
+//
+SIM7080G_CMUX_STATS SIM7080G::GetCMUXStats() const {
+    return cmuxStats;
+}
+#endif
 
 //
-bool SIM7080G::EnterPIN(const char* pin, bool force) {
-#if SIM7080G_DEBUG_LEVEL >= 2
-    uartDebugInterface.printf("DEBUG START: EnterPin(%s)\n", pin);
+void SIM7080G::Loop(bool blocking) {
+#if SIM7080G_THREAD_SAFE
+    //Skip this poll while another task runs a transaction, it reads the URCs itself
+    SIM7080G_LOCK laneGuard(this, SIM_LANE_CONTROL, 0);
+    if (!laneGuard.Held())
+        return;
 #endif
-    
-    //SIM PIN is already entered
-    if (GetPINStatus()) {
-#if SIM7080G_DEBUG_LEVEL >= 2
-        uartDebugInterface.printf("\tSIM PIN READY\nDEBUG END: EnterPin(%s)\n", pin);
-#elif defined SIM7080G_DEBUG_LEVEL == 1
-        uartDebugInterface.printf("\tSIM7080G - SIM PIN is already entered!\n");
+
+    ReadURC();
+
+#if SIM7080G_ENABLE_ASYNC
+    //The services below send commands, which would consume the pending response
+    if (CommandPoll() == SIM_ASYNC_PENDING)
+        return;
 #endif
-        return true;
-    }
 
-    if (strlen(pin) == 4)
-    {
-#if SIM7080G_DEBUG_LEVEL >= 2
-        uartDebugInterface.printf("\tPin format OK!\nDEBUG END: EnterPin(%s)\n", pin);
+    //Fetch socket data announced by +CADATAIND
+    for (uint8_t i = 0; i < SIM7080G_MAX_SOCKETS; i++)
+        if (sockets[i].dataPending)
+            SocketFetch(i);
+
+#if SIM7080G_ENABLE_COAP
+    //Drive the CoAP exchange
+    if (coapBusy)
+        CoAPService();
 #endif
-        char tmpBuff[14] = {'A', 'T', '+', 'C', 'P', 'I', 'N', '=', '*', '*', '*', '*', '\r', '\0'};
-        memcpy(tmpBuff + 8, pin, 4);
-        return SendCommand(tmpBuff);
-    }
-#if SIM7080G_DEBUG_LEVEL >= 2
-    uartDebugInterface.printf("\tPin format ERROR!\nDEBUG END: EnterPin(%s)\n", pin);
-#elif SIM7080G_DEBUG_LEVEL == 1
-    uartDebugInterface.printf("\tSIM7080G - SIM PIN format ERROR!");
+
+    //Use idle time to refresh DNS entries ahead of expiry
+    RefreshDNS();
+
+#if SIM7080G_ENABLE_MQTT
+    //Deliver received MQTT messages
+    if (mqttInboxCount)
+        MQTTDeliver();
 #endif
-    return false;
-}
 
-//
-bool SIM7080G::GetPINStatus(void) {
-    SendCommand("AT+CPIN?\r", rxBuffer);
-    return strstr(rxBuffer, "READY");
+    //The services below wait for the module, PollAll() leaves them to the application
+    if (!blocking)
+        return;
+
+    //Registration lost while restricted to the cached network
+    if (netUnlock)
+        UnlockNetwork();
+
+    //Sample the signal and run deferred transmissions
+    if (txPending || signalAlways)
+        TransmitService();
+
+    //Keep the clock within its error bound
+    if (timeAutoSource)
+        TimeService();
 }
 
 //
-bool SIM7080G::ActivateAppNetwork(void) {
-    if (GetAppNetworkStatus()) {
-#if SIM7080G_DEBUG_LEVEL >= 2
-    uartDebugInterface.printf("DEBUG START: ActivateAppNetwork(void)\n\tSIM7080G - APP Network is already active!\nDEBUG END: ActivateAppNetwork(void)\n");
+void SIM7080G::ReadURC() {
+    Stream& io = Transport();
+
+    while (io.available()) {
+        char c = (char)io.read();
+
+        //Dispatch every complete line
+        if (c == '\r' || c == '\n') {
+            if (urcLength) {
+                urcBuffer[urcLength] = '\0';
+#if SIM7080G_ENABLE_ASYNC
+                if (asyncState == SIM_ASYNC_PENDING)
+                    CommandLine(urcBuffer);
 #endif
-        return false;
-    }
+                HandleURC(urcBuffer);
+                urcLength = 0;
+            }
+            continue;
+        }
 
-    SendCommand("AT+CNACT=0,1\r");
+        if (urcLength < SIM7080G_URC_BUFFER - 1)
+            urcBuffer[urcLength++] = c;
+    }
+    urcDrained = millis();
 
-    return GetAppNetworkStatus();  //Not the greatest, will do for now
+    //Give up on missing ping replies
+    if (pingResult && (int32_t)(millis() - pingDeadline) >= 0)
+        PingFinish();
 }
 
+#if SIM7080G_ENABLE_ASYNC
+//  #
+//  #   Non-blocking commands
+//  #
+
 //
-bool SIM7080G::DeactivateAppNetwork(void) {
-    if (!GetAppNetworkStatus()) {
-#if SIM7080G_DEBUG_LEVEL >= 2
-    uartDebugInterface.printf("DEBUG START: DeactivateAppNetwork(void)\n\tSIM7080G - APP Network is already inactive!\nDEBUG END: DeactivateAppNetwork(void)\n");
-#endif
+bool SIM7080G::CommandStart(const char* command, uint32_t timeout, const char* until) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (CommandPoll() != SIM_ASYNC_IDLE || !command)
         return false;
-    }
 
-    SendCommand("AT+CNACT=0,0\r");
+    asyncLength = 0;
+    asyncResponse[0] = '\0';
+    asyncUntil[0] = '\0';
+    if (until)
+        strncat(asyncUntil, until, sizeof(asyncUntil) - 1);
+
+    asyncState = SIM_ASYNC_PENDING;
+    asyncStart = millis();
+    asyncTimeout = timeout;
+    Transport().print(command);
+
+#if SIM7080G_SHADOW
+    shadowStats.roundTrips++;
+    if (bootCounting)
+        shadowStats.bootRoundTrips++;
+#endif
 
-    return GetAppNetworkStatus();  //Same here...
+#if SIM7080G_DEBUG_LEVEL >= 3
+    uartDebugInterface.printf("\tSIM7080G - Non-blocking command: %s\n", command);
+#endif
+    return true;
 }
 
 //
-uint8_t SIM7080G::GetAppNetworkStatus(void) {
-    if(!SendCommand("AT+CNACT?\r", rxBuffer, 250)) {
-        #if SIM7080G_DEBUG_LEVEL >= 1
-        uartDebugInterface.printf("\tSIM70800G - GetAppNetworkStatus(void) No response from device!\n");
-        #endif
-        return SIM7080_INVALID_RETURN_VALUE;
+SIM7080G_ASYNC SIM7080G::CommandPoll() {
+    if (asyncState == SIM_ASYNC_PENDING && millis() - asyncStart >= asyncTimeout) {
+        //An abandoned command gave up on its result code
+        asyncState = asyncDraining ? SIM_ASYNC_IDLE : SIM_ASYNC_TIMEOUT;
+        asyncDraining = false;
     }
-    char* startPtr = strchr(rxBuffer, ',');
-    
-    //Return if startPtr is null
-    if(!startPtr)
-        return SIM7080_INVALID_RETURN_VALUE;
-    
-    uint8_t status = CharToNmbr((startPtr + 1), 1);
-    #if SIM7080G_DEBUG_LEVEL >= 2
-    uartDebugInterface.printf("DEBUG START: GetAppNetworkStatus(void)\n");
-    uartDebugInterface.printf("\tAPP Network 0 Status:%d\n", status);
-    uartDebugInterface.printf("DEBUG END: GetAppNetworkStatus(void)\n");
-    #elif SIM7080G_DEBUG_LEVEL == 1
-    uartDebugInterface.printf("\tSIM7080G - APP Network status: %d\n", status);
-#endif
-
-    return status;
+    return asyncState;
 }
 
 //
-void SIM7080G::GetAppNetworkInfo(SIM7080G_APPN* info) {
-    if(info == NULL)
-        return;
-    SendCommand("AT+CGNACT?\r", rxBuffer);
-    info->statusx = GetAppNetworkStatus();
-    info->pdidx = 0x00;
-    char* startPtr = strchr(rxBuffer, '\"') + 1;
-    size_t charCntr = (strchr(startPtr, '\"') - startPtr - 1);
+const char* SIM7080G::CommandResponse() const {
+    return asyncResponse;
+}
 
-    //Check against nullptr or wrong IP address length calculation
-    if (startPtr == NULL || charCntr < 7 || charCntr > 15) //IP should be at leas 7 or at max 15 characters
+//
+void SIM7080G::CommandRelease() {
+    //The module still owes the result code, keep the slot until it arrives
+    if (asyncState == SIM_ASYNC_PENDING || asyncState == SIM_ASYNC_TIMEOUT) {
+        asyncState = SIM_ASYNC_PENDING;
+        asyncDraining = true;
+        asyncStart = millis();
+        asyncTimeout = SIM7080G_ASYNC_DRAIN;
         return;
+    }
 
-    strncpy(info->ipv4, startPtr, charCntr);
-    info->ipv4[charCntr] = '\0';
+    asyncState = SIM_ASYNC_IDLE;
 }
 
 //
-SIM7080G_APPN SIM7080G::GetAppNetworkInfo(void) {
-    SIM7080G_APPN info;
-    GetAppNetworkInfo(&info);
-    return info;
+void SIM7080G::SetURCHook(SIM7080G_URC_HOOK hook, void* context) {
+    urcHook = hook;
+    urcHookContext = context;
 }
-
+#endif
 
 //  #
-//  #   IP applications
+//  #   Command metrics
 //  #
 
 //
-int SIM7080G::Ping4(const char* address, uint16_t pingCount, uint16_t packetSize, uint32_t timeout) {
-    if (!address || !pingCount || !packetSize || !timeout)
-        return SIM7080_INVALID_PARAMETER;       //Wrong parameters
-
-    if (strlen(address) < 7 || strlen(address) > 15)
-        return SIM7080_INVALID_PARAMETER;       //Bad IP address length
-
-    if (!GetAppNetworkStatus())
-        return SIM7080_INVALID_PARAMETER;       //APP network inactive
-
-    //Check parameter values
-    if(pingCount > 500)
-        pingCount = 500;
-
-    if (packetSize > 1400)
-        packetSize = 1400;
-
-    if (timeout > 60000)
-        timeout = 60000;
-
-    #if SIM7080G_DEBUG_LEVEL >= 1
-    uartDebugInterface.printf("\tSIM7080G - Pinging %s with %u bytes of data...\n", address, packetSize);
-    #endif
-
-    char buffer[32 + strlen(address)] = { '\0' };
-    sprintf(buffer, "AT+SNPING4=\"%s\",%u,%u,%u\r", address, pingCount, packetSize, timeout);
-    SendCommand(buffer);
-
-    uint16_t successful = 0;    //Successful ping count
-    size_t bytesRecv = 0;       //Bytes received from module
-
-    for(uint16_t i = 0; i < pingCount; i++){
-        bytesRecv = Receive((uint8_t*)rxBuffer, 0, timeout + 100);
-        
-        #if SIM7080G_DEBUG_LEVEL >= 1
-        uartDebugInterface.printf("\tSIM7080G -Ping 4: RX buffer: %s\n", rxBuffer);
-        #endif
+uint8_t SIM7080G::GetCommandMetrics(SIM7080G_CMD_METRICS* dst, uint8_t max) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+#if SIM7080G_METRICS
+    MetricsCommit();
+
+    uint8_t count = metricsFamilies < max ? metricsFamilies : max;
+    for (uint8_t i = 0; i < count; i++)
+        dst[i] = metrics[i];
+    return count;
+#else
+    (void)dst;
+    (void)max;
+    return 0;
+#endif
+}
 
-        //Continue loop if no reply sent
-        if (!bytesRecv) {
-            #if SIM7080G_DEBUG_LEVEL >= 1
-            uartDebugInterface.printf("\tSIM7080G -Ping 4: No reply from module!\n");
-            #endif
-            continue;
-        }
+//
+void SIM7080G::ResetCommandMetrics() {
+#if SIM7080G_METRICS
+    for (uint8_t i = 0; i < SIM7080G_METRICS_FAMILIES; i++)
+        metrics[i] = SIM7080G_CMD_METRICS();
+    metricsFamilies = 0;
+    metricsOpen = false;
+    metricsTraceHead = 0;
+    metricsTraceCount = 0;
+#endif
+}
 
-        char* startPtr = strrchr(rxBuffer, ',');
-        
-        //Continue loop if startPtr comes back as nullptr
-        if (!startPtr) {
-            #if SIM7080G_DEBUG_LEVEL >= 1
-            uartDebugInterface.printf("\tSIM7080G -Ping 4: Wrong reply format!\n");
-            #endif
-            continue;
+//
+void SIM7080G::ExportMetrics(Print& out) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+#if SIM7080G_METRICS
+    MetricsCommit();
+
+    out.printf("%-11s %8s %6s %6s %9s %9s %7s %7s %7s %7s %7s\n", "family", "calls", "errors", "tmout", "out", "in", "avg", "p50", "p90", "p99", "max");
+    for (uint8_t i = 0; i < metricsFamilies; i++) {
+        const SIM7080G_CMD_METRICS& m = metrics[i];
+
+        //Percentiles as the upper bound of the bucket they fall in
+        uint32_t bounds[3] = { 0, 0, 0 };
+        const uint8_t percents[3] = { 50, 90, 99 };
+        for (uint8_t p = 0; p < 3; p++) {
+            uint32_t rank = ((uint64_t)m.calls * percents[p] + 99) / 100;
+            uint32_t seen = 0;
+            for (uint8_t b = 0; b < SIM7080G_METRICS_BUCKETS; b++) {
+                seen += m.histogram[b];
+                if (seen >= rank && rank) {
+                    bounds[p] = b ? (1UL << b) - 1 : 0;
+                    break;
+                }
+            }
         }
 
-        uint32_t roundTime = CharToNmbr(startPtr + 1);
-
-        if (roundTime < timeout) {
-            successful++;
-            #if SIM7080G_DEBUG_LEVEL >= 1
-            uartDebugInterface.printf("\tSIM7080G - Got ping reply! RTT: %u\n", roundTime);
-            #endif
-        }
-        #if SIM7080G_DEBUG_LEVEL >= 1
-        else
-            uartDebugInterface.printf("\tSIM7080G - Ping timed out!\n");
-        #endif
+        out.printf("%-11s %8lu %6lu %6lu %9lu %9lu %7lu %7lu %7lu %7lu %7lu\n", m.family, (unsigned long)m.calls, (unsigned long)m.failures, (unsigned long)m.timeouts,
+                   (unsigned long)m.bytesOut, (unsigned long)m.bytesIn, (unsigned long)(m.calls ? m.totalTime / m.calls : 0),
+                   (unsigned long)bounds[0], (unsigned long)bounds[1], (unsigned long)bounds[2], (unsigned long)m.maxTime);
     }
-
-    #if SIM7080G_DEBUG_LEVEL >= 1
-    uartDebugInterface.printf("\tSIM7080G - Ping replies received: %u out of %u\n", successful, pingCount);
-    #endif
-
-    return successful;
+#else
+    (void)out;
+#endif
 }
 
+//
+void SIM7080G::ExportTrace(Print& out) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+#if SIM7080G_METRICS
+    MetricsCommit();
+
+    out.print("{\"traceEvents\":[");
+    for (uint16_t i = 0; i < metricsTraceCount; i++) {
+        const SIM7080G_CMD_SPAN& span = metricsTrace[(metricsTraceHead + i) % SIM7080G_METRICS_TRACE];
+        out.printf("%s\n{\"name\":\"%s\",\"cat\":\"at\",\"ph\":\"X\",\"ts\":%lu,\"dur\":%lu,\"pid\":1,\"tid\":1,\"args\":{\"failed\":%s}}",
+                   i ? "," : "", metrics[span.family].family, (unsigned long)span.start, (unsigned long)span.duration, span.failed ? "true" : "false");
+    }
+    out.print("\n],\"displayTimeUnit\":\"ms\"}\n");
+#else
+    (void)out;
+#endif
+}
 
 //  #
-//  #   HTTP(S) applications
+//  #   Event trace
 //  #
 
 //
-bool SIM7080G::SetHTTPRequest(const SIM7080G_HTTPCONF httpConf, bool build) {
-    char buffer[SIM7080G_HTTP_REQ_BUFFER] = { '\0' };   //Temporary buffer for configuration
-
-    sprintf(buffer, "AT+SHCONF=\"URL\",\"%s\"\r", httpConf.url);
-    if (!SendCommand(buffer))
-        return false;
-    buffer[0] = 0;
-
-    sprintf(buffer, "AT+SHCONF=\"BODYLEN\",%u\r", httpConf.bodylen);
-    if (!SendCommand(buffer))
-        return false;
-    buffer[0] = 0;
-
-    sprintf(buffer, "AT+SHCONF=\"HEADERLEN\",%u\r", httpConf.headerlen);
-    if (!SendCommand(buffer))
-        return false;
-
-    if (build)
-        BuildHTTP();
-    
-    return true;
+size_t SIM7080G::ReadTrace(SIM7080G_TRACE_EVENT* dst, size_t max) {
+    size_t count = 0;
+#if SIM7080G_TRACE
+    uint16_t tail = traceTail.load(std::memory_order_relaxed);
+    for (; count < max && tail != traceHead.load(std::memory_order_acquire); count++) {
+        dst[count] = traceRing[tail];
+        tail = (tail + 1) & (SIM7080G_TRACE_EVENTS - 1);
+        traceTail.store(tail, std::memory_order_release);
+    }
+#else
+    (void)dst;
+    (void)max;
+#endif
+    return count;
 }
 
 //
-SIM7080G_HTTP_RESULT SIM7080G::SendHTTPRequest(const SIM7080G_HTTPCONF httpConf, char* dst) {
-    char buffer[SIM7080G_HTTP_REQ_BUFFER] = { '\0' };
-
-    if (dst == NULL)
-        dst = rxBuffer;
-
-    sprintf(buffer, "AT+SHREQ=\"%s\",%u\r", httpConf.url, httpConf.method);
-    SendCommand(buffer, dst);
-
-    SIM7080G_HTTP_RESULT httpResult;
-
-    char* startPtr = strchr(dst, ',') + 1;
-    httpResult.resultCode = CharToNmbr(startPtr, 3);
-    httpResult.bytesReceived = CharToNmbr(strchr(startPtr, ',') + 1);
-
-    return httpResult;
+size_t SIM7080G::PrintTrace(Print& out, size_t max) {
+    size_t count = 0;
+#if SIM7080G_TRACE
+    SIM7080G_TRACE_EVENT event;
+    for (; (!max || count < max) && ReadTrace(&event, 1); count++) {
+        out.printf("\t[%lu.%06lu] SIM7080G - ", (unsigned long)(event.time / 1000000), (unsigned long)(event.time % 1000000));
+        if (event.id < SIM_TRACE_IDS)
+            out.printf(traceFormats[event.id], (long)event.a, (long)event.b);
+        out.print("\n");
+    }
+#else
+    (void)out;
+    (void)max;
+#endif
+    return count;
 }
 
 //
-bool SIM7080G::BuildHTTP(void) {
-    return SendCommand("AT+SHCONN\r");
+uint32_t SIM7080G::GetTraceDropped() const {
+#if SIM7080G_TRACE
+    return traceDropped.load(std::memory_order_relaxed);
+#else
+    return 0;
+#endif
 }
 
 //
-uint8_t SIM7080G::GetHTTPStatus(void) {
-    SendCommand("AT+SHSTATE?\r", rxBuffer);
-    uint8_t httpStatus = *(strchr(rxBuffer, ' ') + 1) - '0';
-#if SIM7080G_DEBUG_LEVEL >=1
-    uartDebugInterface.printf("\tSIM7080G - Get HTTP status: %u\n", httpStatus);
+void SIM7080G::ReportFootprint(Print& out) {
+    out.printf("SIM7080G RAM footprint (bytes)\n");
+    out.printf("\t%-22s %6u\n", "rx buffer", (unsigned)sizeof(rxBuffer));
+    out.printf("\t%-22s %6u\n", "tx buffer", (unsigned)sizeof(txBuffer));
+    out.printf("\t%-22s %6u\n", "URC buffer", (unsigned)sizeof(urcBuffer));
+    out.printf("\t%-22s %6u\n", "sockets", (unsigned)sizeof(sockets));
+    out.printf("\t%-22s %6u\n", "TLS", (unsigned)(sizeof(tlsConf) + sizeof(tlsStats) + sizeof(tlsCerts)));
+    out.printf("\t%-22s %6u\n", "DNS cache", (unsigned)sizeof(dnsCache));
+#if SIM7080G_ENABLE_MQTT
+    out.printf("\t%-22s %6u\n", "MQTT", (unsigned)(sizeof(mqttConf) + sizeof(mqttQueue) + sizeof(mqttInbox) + sizeof(mqttSubs)));
 #endif
-    return httpStatus;
+#if SIM7080G_ENABLE_COAP
+    out.printf("\t%-22s %6u\n", "CoAP", (unsigned)(sizeof(coapMessage) + sizeof(coapPath)));
+#endif
+#if SIM7080G_ENABLE_CMUX
+    out.printf("\t%-22s %6u\n", "CMUX channels", (unsigned)sizeof(cmuxChannels));
+#endif
+#if SIM7080G_METRICS
+    out.printf("\t%-22s %6u\n", "command metrics", (unsigned)(sizeof(metrics) + sizeof(metricsTrace)));
+#endif
+#if SIM7080G_TRACE
+    out.printf("\t%-22s %6u\n", "event trace", (unsigned)sizeof(traceRing));
+#endif
+#if SIM7080G_SHADOW
+    out.printf("\t%-22s %6u\n", "shadow state", (unsigned)(sizeof(shadowTime) + sizeof(shadowIP) + sizeof(shadowAppn)));
+#endif
+#if SIM7080G_ENABLE_FTP
+    out.printf("\t%-22s %6u\n", "FTP profile", (unsigned)(sizeof(ftpConf) + sizeof(ftpAddress)));
+#endif
+#if SIM7080G_ENABLE_HTTP
+    out.printf("\t%-22s %6u\n", "HTTP profile", (unsigned)(sizeof(httpHost) + sizeof(httpURLHash)));
+#endif
+    out.printf("\t%-22s %6u\n", "RAT sites and log", (unsigned)(sizeof(ratSites) + sizeof(ratLog)));
+    out.printf("\t%-22s %6u\n", "signal samples", (unsigned)(sizeof(signalRing) + sizeof(txJobs)));
+    out.printf("\t%-22s %6u\n", "total (object)", (unsigned)sizeof(SIM7080G));
+    out.printf("\t%-22s %6u\n", "UART driver FIFO", (unsigned)SIM7080G_UART_RX_FIFO);
+    out.printf("\tHTTP %d | FTP %d | GNSS %d | MQTT %d | CoAP %d | CMUX %d | debug level %d\n", SIM7080G_ENABLE_HTTP, SIM7080G_ENABLE_FTP, SIM7080G_ENABLE_GNSS, SIM7080G_ENABLE_MQTT, SIM7080G_ENABLE_COAP, SIM7080G_ENABLE_CMUX, SIM7080G_DEBUG_LEVEL);
 }
 
+//  #
+//  #   Shadow state
+//  #
+
 //
-bool SIM7080G::ClearHTTPHeader(void) {
-    return SendCommand("AT+SHCHEAD\r");
+SIM7080G_SHADOW_STATS SIM7080G::GetShadowStats() const {
+#if SIM7080G_SHADOW
+    return shadowStats;
+#else
+    return SIM7080G_SHADOW_STATS();
+#endif
 }
 
 //
-bool SIM7080G::AddHTTPHeaderContent(const SIM7080G_HTTP_HEADCONT headerContent) {
-    return AddHTTPContent(headerContent.type, headerContent.value, "AT+SHAHEAD");
+void SIM7080G::ResetShadowStats() {
+#if SIM7080G_SHADOW
+    SIM7080G_SHADOW_STATS boot = shadowStats;
+    shadowStats = SIM7080G_SHADOW_STATS();
+    shadowStats.bootRoundTrips = boot.bootRoundTrips;
+    shadowStats.bootTime = boot.bootTime;
+#endif
 }
 
 //
-bool SIM7080G::SetHTTPBody(size_t length, uint16_t timeout) {
-    char buffer[SIM7080G_HTTP_REQ_BUFFER] = { '\0' };
+void SIM7080G::SetShadowTTL(uint32_t ttl) {
+#if SIM7080G_SHADOW
+    shadowTTL = ttl;
+#else
+    (void)ttl;
+#endif
+}
 
-    sprintf(buffer, "AT+SHBOD=%u,%u\r", length, timeout);
+//
+void SIM7080G::InvalidateShadow(bool boot) {
+#if SIM7080G_SHADOW
+    shadowValid = 0;
+    shadowStats.invalidations++;
+#endif
 
-    return SendCommand(buffer);
+    //A restarted module lost the session parameters too
+    if (boot) {
+        imei[0] = '\0';
+        iccid[0] = '\0';
+        firmware[0] = '\0';
+        profileKnown = 0;
+    }
 }
 
 //
-bool SIM7080G::ClearHTTPBody(void) {
-    return SendCommand("AT+SHCPARA\r");
+const char* SIM7080G::GetIMEI() {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    ReadIdentity("AT+CGSN\r", imei, sizeof(imei));
+    return imei;
 }
 
 //
-bool SIM7080G::AddHTTPBodyContent(const SIM7080G_HTTP_BODYCONT bodyContent) {
-    return AddHTTPContent(bodyContent.type, bodyContent.value, "AT+SHPARA");
+const char* SIM7080G::GetICCID() {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    ReadIdentity("AT+CCID\r", iccid, sizeof(iccid));
+    return iccid;
 }
 
+//
+const char* SIM7080G::GetFirmware() {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    ReadIdentity("AT+CGMR\r", firmware, sizeof(firmware));
+    return firmware;
+}
 
 //  #
-//  #   File Transfer Protocol (FTP)
+//  #   Session profiles
 //  #
 
 //
-bool SIM7080G::SetFTPPort(uint16_t port) {
-    char buffer[32] = { '\0' };
-    sprintf(buffer, "AT+FTPPORT=%u\r", port);
-    return SendCommand(buffer);
+SIM7080G_PROFILE_STATS SIM7080G::GetProfileStats(void) const {
+    return profileStats;
 }
 
 //
-bool SIM7080G::SetFTPMode(SIM7080G_FTP_MODE mode) {
-    char buffer[16] = { '\0' };
-    sprintf(buffer, "AT+FTPMODE=%u\r", mode);
-    return SendCommand(buffer);
+void SIM7080G::ResetProfileStats(void) {
+    profileStats = SIM7080G_PROFILE_STATS();
 }
 
 //
-bool SIM7080G::SetFTPDataType(SIM7080G_FTP_DTYPE type) {
-    char buffer[16] = { '\0' };
-    sprintf(buffer, "AT+FTPTYPE=%u\r", type);
-    return SendCommand(buffer);
+bool SIM7080G::ProfileStale(uint8_t field, bool differs) {
+    if (differs || !(profileKnown & (1UL << field))) {
+        profileStats.sent++;
+        return true;
+    }
+
+    profileStats.skipped++;
+    return false;
 }
 
 //
-bool SIM7080G::SetFTPCID(uint8_t pdpidx) {
-    if (pdpidx > 4)
-        return false;
-    
-    char buffer[16] = { '\0' };   //AT+FTPCID=
-    sprintf(buffer, "AT+FTPCID=%u\r", pdpidx);
-    return SendCommand(buffer);
+bool SIM7080G::ProfileKnown(uint8_t field, bool result) {
+    if (result)
+        profileKnown |= 1UL << field;
+    else
+        profileKnown &= ~(1UL << field);
+    return result;
 }
 
 //
-//bool SIM7080G::SetFTPPutType(const char* type) {}
+bool SIM7080G::ProfileText(uint8_t field, char* dst, size_t size, const char* value, bool result) {
+    //A value longer than the copy can not be compared later
+    if (!result || strlen(value) >= size) {
+        ProfileKnown(field, false);
+        return result;
+    }
 
-//
-bool SIM7080G::SetFTPServer(const char* ip) {
-    if(ip == NULL || strlen(ip) < 7 || strlen(ip) > 15)
-        return false;
-    char buffer[64] = { '\0' };
-    sprintf(buffer, "AT+FTPSERV=\"%s\"\r", ip);
-    return SendCommand(buffer);
+    strcpy(dst, value);
+    return ProfileKnown(field, true);
 }
 
-//
-bool SIM7080G::SetFTPUsername(const char* username) {
-    if (username == NULL)
-        return SendCommand("AT+FTPUN=\"\"\r");
-    
-    char buffer [16 + strlen(username)] = { '\0' };
-    sprintf(buffer , "AT+FTPUN=\"%s\"\r", username);
-    return SendCommand(buffer);
-}
+//  #
+//  #   Cellular communication
+//  #
 
 //
-bool SIM7080G::SetFTPPassword(const char* password) {
-    if (password == NULL)
-        return SendCommand("AT+FTPPW=\"\"\r");
+uint8_t SIM7080G::GetNetworkReg(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    size_t bytesRecv = SendCommand("AT+CREG?\r", rxBuffer);
+    char* startPtr = strchr(rxBuffer, ',');
+    if (!startPtr)
+        return 255;
+    uint8_t status = *(startPtr + 1) - '0';
+    SIM7080G_TRACE_EVENT(SIM_TRACE_NETREG, status, 0);
+    return status;
+}
+
+//
+uint8_t SIM7080G::GetSignalQuality() {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
     
-    char buffer [16 + strlen(password)] = { '\0' };
-    sprintf(buffer , "AT+FTPPW=\"%s\"\r", password);
-    return SendCommand(buffer);
+    size_t bytesRecv = SendCommand("AT+CSQ\r", rxBuffer);
+
+    if(bytesRecv == 0)
+        return 255;
+
+    char* startPtr = rxBuffer;
+    while ((*startPtr) != ':' && (*startPtr) != '\0')
+        startPtr++;
+    startPtr++;     //Step forward another
+
+    uint8_t offset = 0;
+    for (; startPtr[offset] != ',' && startPtr[offset] != '\0'; offset++);
+
+    //Check against mem overflow
+    return bytesRecv <= uartMaxRecvSize && startPtr + 2 <= rxBuffer + uartMaxRecvSize ? CharToNmbr(startPtr, offset) : SIM7080_SIGNAL_QUALITY_UNKNOWN;
+}
+
+
+//void SIM7080G::GetCellOperators(HardwareSerial& debugInterface);
+
+//
+size_t SIM7080G::GetCellOperators(char* dst, size_t len) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!dst || !len)
+        return 0;
+
+    //+COPS: (<stat>,"<long>","<short>","<numeric>",<AcT>),...,,(0-4),(0-2)
+    dst[0] = '\0';
+    const char* command = "AT+COPS=?\r";
+    Send((uint8_t*)command, strlen(command));
+    if (!WaitForResult(180000))
+        return 0;
+
+    char* startPtr = strstr(rxBuffer, "+COPS: ");
+    if (!startPtr)
+        return 0;
+    size_t length = strcspn(startPtr, "\r\n");
+    if (length >= len)
+        length = len - 1;
+    memcpy(dst, startPtr, length);
+    dst[length] = '\0';
+    return length;
 }
 
 //
-bool SIM7080G::SetFTPDownFN(const char* filename) {
-    if (filename == NULL)
+bool SIM7080G::SetCellOperator(const char* plmn, SIM7080G_RAT rat, bool fallback) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!plmn)
+        return SendCommand("AT+COPS=0\r", 10000);
+
+    //AcT 7: LTE-M (E-UTRAN), 9: NB-IoT
+    char buffer[40] = { '\0' };
+    if (rat == SIM_RAT_CATM || rat == SIM_RAT_NBIOT)
+        snprintf(buffer, sizeof(buffer), "AT+COPS=%u,2,\"%s\",%u\r", fallback ? 4 : 1, plmn, rat == SIM_RAT_CATM ? 7 : 9);
+    else
+        snprintf(buffer, sizeof(buffer), "AT+COPS=%u,2,\"%s\"\r", fallback ? 4 : 1, plmn);
+    return SendCommand(buffer, 10000);
+}
+
+//
+bool SIM7080G::GetCellOperator(char* dst) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    if (!dst)
         return false;
-    
-    char buffer[32 + strlen(filename)] = { '\0' };
-    sprintf(buffer, "AT+FTPGETNAME=\"%s\"\r", filename);
-    return SendCommand(buffer);
+    dst[0] = '\0';
+
+    //Numeric operator format
+    if (!SendCommand("AT+COPS=3,2\r"))
+        return false;
+
+    //+COPS: <mode>[,<format>,"<oper>"[,<AcT>]]
+    SendCommand("AT+COPS?\r", rxBuffer);
+    char* startPtr = strstr(rxBuffer, "+COPS: ");
+    startPtr = startPtr ? strchr(startPtr, '\"') : nullptr;
+    if (!startPtr)
+        return false;
+
+    size_t length = strcspn(startPtr + 1, "\"");
+    if (length >= sizeof(SIM7080G_CELL_INFO::plmn))
+        return false;
+    memcpy(dst, startPtr + 1, length);
+    dst[length] = '\0';
+    return true;
 }
 
 //
-bool SIM7080G::SetFTPDownFP(const char* filePath) {
-    if (filePath == NULL)
+bool SIM7080G::GetCellInfo(SIM7080G_CELL_INFO& info) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    info = SIM7080G_CELL_INFO();
+
+    SendCommand("AT+CPSI?\r", rxBuffer);
+    char* startPtr = strstr(rxBuffer, "+CPSI: ");
+    if (!startPtr)
         return false;
-    
-    char buffer[32 + strlen(filePath)] = { '\0' };
-    sprintf(buffer, "AT+FTPGETPATH=\"%s\"\r", filePath);
-    return SendCommand(buffer);
+
+    //LTE-M: <mode>,<op mode>,<MCC>-<MNC>,<TAC>,<SCellID>,<PCellID>,EUTRAN-BAND<n>,<earfcn>,<dlbw>,<ulbw>,<RSRQ>,<RSRP>,<RSSI>,<RSSNR>
+    //NB-IoT: same without <dlbw>,<ulbw>
+    char line[128] = { '\0' };
+    size_t length = strcspn(startPtr + 7, "\r\n");
+    if (length >= sizeof(line))
+        length = sizeof(line) - 1;
+    memcpy(line, startPtr + 7, length);
+
+    char* fields[14] = { nullptr };
+    uint8_t count = 0;
+    for (char* field = line; field && count < 14; count++) {
+        fields[count] = field;
+        field = strchr(field, ',');
+        if (field)
+            *field++ = '\0';
+    }
+
+    if (count < 2)
+        return false;
+    info.online = !strcmp(fields[1], "Online");
+
+    if (!strcmp(fields[0], "LTE CAT-M1"))
+        info.rat = SIM_RAT_CATM;
+    else if (!strcmp(fields[0], "LTE NB-IOT"))
+        info.rat = SIM_RAT_NBIOT;
+    else
+        return false;   //NO SERVICE (or GSM)
+
+    uint8_t signal = info.rat == SIM_RAT_CATM ? 10 : 8;
+    if (count < signal + 4)
+        return false;
+
+    //"262-01" -> "26201"
+    char* dash = strchr(fields[2], '-');
+    if (dash && strlen(fields[2]) < sizeof(info.plmn) + 1) {
+        *dash = '\0';
+        snprintf(info.plmn, sizeof(info.plmn), "%s%s", fields[2], dash + 1);
+    }
+
+    info.tac = strtoul(fields[3], nullptr, 16);
+    info.cellId = strtoul(fields[4], nullptr, 10);
+    info.pci = strtoul(fields[5], nullptr, 10);
+    char* band = strstr(fields[6], "BAND");
+    info.band = band ? atoi(band + 4) : 0;
+    info.earfcn = strtoul(fields[7], nullptr, 10);
+    info.rsrq = atoi(fields[signal]);
+    info.rsrp = atoi(fields[signal + 1]);
+    info.rssi = atoi(fields[signal + 2]);
+    info.sinr = atoi(fields[signal + 3]);
+    return true;
 }
 
 //
-bool SIM7080G::SetFTPUpFN(const char* filename) {
-    if (filename == NULL)
+bool SIM7080G::SetBands(SIM7080G_RAT rat, const char* bands) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!bands || (rat != SIM_RAT_CATM && rat != SIM_RAT_NBIOT))
         return false;
-    
-    char buffer[32 + strlen(filename)] = { '\0' };
-    sprintf(buffer, "AT+FTPPUTNAME=\"%s\"\r", filename);
-    return SendCommand(buffer);
+
+    snprintf(txBuffer, sizeof(txBuffer), "AT+CBANDCFG=\"%s\",%s\r", rat == SIM_RAT_CATM ? "CAT-M" : "NB-IOT", bands);
+    return SendCommand(txBuffer);
 }
 
 //
-bool SIM7080G::SetFTPUpFP(const char* filePath) {
-    if (filePath == NULL)
+bool SIM7080G::SetRAT(SIM7080G_RAT rat) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (rat == SIM_RAT_NONE)
         return false;
-    
-    char buffer[32 + strlen(filePath)] = { '\0' };
-    sprintf(buffer, "AT+FTPPUTPATH=\"%s\"\r", filePath);
+
+    char buffer[16] = { '\0' };
+    sprintf(buffer, "AT+CMNB=%u\r", rat);
     return SendCommand(buffer);
 }
 
 //
-SIM7080G_FTP_RESULT SIM7080G::FTPUpload(uint8_t* src, size_t length) {
-    //Test given parameters
-    if(!src || !length)
-        return SIM_FTP_PAR_ERR;
+bool SIM7080G::RegisterNetwork(uint32_t timeout) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    LoadNetworkCache();
+    regStats.attempts++;
+
+    uint32_t start = millis();
+    //Kept through a PSM or eDRX sleep, nothing to measure
+    if (WaitRegistration(0)) {
+        NoteServingCell(0);
+        return true;
+    }
 
-    //If in another FTP session close it
-    if(GetFTPState())
-        CloseFTPSession();
-    
-    //Initiate FTP connection
-    char buffer[128] = { '\0' };
+    bool registered = false;
+    bool cached = false;
 
-    //Initiate the connection
-    SendCommand("AT+FTPPUT=1\r");
+    //Both scans below configure bands and operator themselves
+    netLocked = false;
+    netUnlock = false;
 
-    //Check if server responded
-    if(!Receive((uint8_t*)buffer, 0, 78000))
-        return SIM_FTP_TIMEOUT;
+    //Scan the last serving network only
+    if (netCache.plmn[0] != '\0' && netCache.band) {
+        char band[4] = { '\0' };
+        sprintf(band, "%u", netCache.band);
 
-    //Process PUT response
-    char* startPtr = strchr(buffer, ',') + 1;                                           //Get result code
-    uint8_t responseCode = CharToNmbr(startPtr, strchr(startPtr, ',') - startPtr);      //...
+        SetCellFunction(0);
+        SetRAT(netCache.rat);
+        SetBands(netCache.rat, band);
+        SetCellOperator(netCache.plmn, netCache.rat);
+        SetCellFunction(1);
 
-    #if SIM7080G_DEBUG_LEVEL >= 2
-     uartDebugInterface.printf("\tSIM7080G - FTP Upload: Init put response code %d, RX buffer: %s\n", responseCode, buffer);
-    #endif
+        registered = WaitRegistration(timeout < SIM7080G_REG_CACHED_TIMEOUT ? timeout : SIM7080G_REG_CACHED_TIMEOUT);
+        cached = registered;
+        if (!registered) {
+            regStats.fallbacks++;
+#if SIM7080G_DEBUG_LEVEL >= 1
+            uartDebugInterface.printf("\tSIM7080G - Network %s band %u not found, scanning all bands\n", netCache.plmn, netCache.band);
+#endif
+        }
+    }
 
-    //Return if connection unsuccessful
-    if (responseCode > 1 && responseCode < 100)
-        return (SIM7080G_FTP_RESULT)responseCode;
+    //Every band of both RATs, any operator
+    if (!registered) {
+        uint32_t elapsed = millis() - start;
+        SetCellFunction(0);
+        SetRAT(SIM_RAT_BOTH);
+        SetBands(SIM_RAT_CATM, SIM7080G_CATM_BANDS);
+        SetBands(SIM_RAT_NBIOT, SIM7080G_NBIOT_BANDS);
+        SetCellOperator(NULL);
+        SetCellFunction(1);
+
+        registered = elapsed < timeout && WaitRegistration(timeout - elapsed);
+    }
 
-    //Received max length at once
-    size_t chunkLength = CharToNmbr(strchr(startPtr, ',') + 1);
-    size_t dataLength = length;
-    size_t dataSent = 0;
+    uint32_t elapsed = millis() - start;
+    if (!registered) {
+        regStats.failures++;
+#if SIM7080G_DEBUG_LEVEL >= 1
+        uartDebugInterface.printf("\tSIM7080G - Network registration timed out after %lu ms\n", (unsigned long)elapsed);
+#endif
+        return false;
+    }
 
-    #if SIM7080G_DEBUG_LEVEL == 1
-    uartDebugInterface.printf("\tSIM7080G - FTP Upload: Uploading %u bytes of data...\n", length);
-    #elif SIM7080G_DEBUG_LEVEL >= 2
-    uartDebugInterface.printf("\tSIM7080G - FTP Upload: ChunkLen: %u, Data len: %u\n", chunkLength, dataLength);
-    #endif
+    regStats.lastTime = elapsed;
+    if (cached) {
+        regStats.cachedHits++;
+        regStats.cachedTime += elapsed;
 
-    //Send data in segments if larger than maximum chunk size
-    while(dataLength > chunkLength) {
-        #if SIM7080G_DEBUG_LEVEL >= 2
-        uartDebugInterface.printf("\tSIM7080G - FTP Upload: Uploading chunk!\n");
-        #endif
+        //AT+COPS=0 starts a new PLMN selection and AT+CBANDCFG can detach while attached,
+        //band and operator are unlocked at the next CFUN=0 or when the registration is lost
+        netLocked = true;
+    }
+    else {
+        regStats.fullScans++;
+        regStats.fullTime += elapsed;
+    }
 
-        //Initiate data transaction
-        sprintf(buffer, "AT+FTPPUT=2,%u\r", chunkLength);
-        if (!SendCommand(buffer, rxBuffer, 75000)) {
-            CloseFTPSession();
-            return SIM_FTP_TIMEOUT; //Connection timed out
-        }
+#if SIM7080G_DEBUG_LEVEL >= 1
+    uartDebugInterface.printf("\tSIM7080G - Registered after %lu ms (%s)\n", (unsigned long)elapsed, cached ? "cached network" : "full scan");
+#endif
 
-        //Check 
-        if(CharToNmbr(strchr(rxBuffer, ',') + 1) != (length > chunkLength ? chunkLength : length))  {
-            #if SIM7080G_DEBUG_LEVEL >= 2
-            uartDebugInterface.printf("\tSIM7080G - FTP Upload: Requested and provided byte size mismatched! Provided: %u, requested: %u\n", chunkLength, CharToNmbr(strchr(rxBuffer, ',') + 1));
-            #endif
-            CloseFTPSession();
-            return SIM_FTP_OTH_ERR;
+    NoteServingCell(elapsed);
+    return true;
+}
+
+//
+SIM7080G_NET_CACHE SIM7080G::GetNetworkCache(void) {
+    LoadNetworkCache();
+    return netCache;
+}
+
+//
+void SIM7080G::SetNetworkCache(const SIM7080G_NET_CACHE cache) {
+    LoadNetworkCache();
+    netCache = cache;
+    StoreNetworkCache();
+}
+
+//
+SIM7080G_REG_STATS SIM7080G::GetRegStats(void) const {
+    return regStats;
+}
+
+//
+void SIM7080G::ResetRegStats(void) {
+    regStats = SIM7080G_REG_STATS();
+}
+
+//
+void SIM7080G::SetRATPolicy(const SIM7080G_RAT_POLICY policy) {
+    ratPolicy = policy;
+}
+
+//
+void SIM7080G::AddRATSample(uint32_t rtt, uint32_t goodput) {
+    if (ratSite < 0 || (ratServing != SIM_RAT_CATM && ratServing != SIM_RAT_NBIOT) || (!rtt && !goodput))
+        return;
+
+    SIM7080G_RAT_SCORE& score = ratSites[ratSite].scores[ratServing - 1];
+    if (rtt)
+        score.rtt = SmoothAverage(score.rtt, rtt);
+    if (goodput)
+        score.goodput = SmoothAverage(score.goodput, goodput);
+    if (score.samples < UINT16_MAX)
+        score.samples++;
+    ratDirty = true;
+}
+
+//
+SIM7080G_RAT SIM7080G::EvaluateRAT(bool apply) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (ratSite < 0 || (ratServing != SIM_RAT_CATM && ratServing != SIM_RAT_NBIOT))
+        return ratServing;
+
+    SIM7080G_RAT_SITE& site = ratSites[ratSite];
+    SIM7080G_RAT other = ratServing == SIM_RAT_CATM ? SIM_RAT_NBIOT : SIM_RAT_CATM;
+    SIM7080G_RAT_SCORE& current = site.scores[ratServing - 1];
+    SIM7080G_RAT_SCORE& alternative = site.scores[other - 1];
+    uint32_t cost = RATCost(current, alternative);
+    uint32_t otherCost = RATCost(alternative, current);
+    bool dwell = !ratSwitched || millis() - ratSwitchTime >= ratPolicy.minDwell;
+
+    SIM7080G_RAT target = ratServing;
+    SIM7080G_RAT_REASON reason = SIM_RAT_SITE;
+
+    //Once per registration: the RAT that won at this site before
+    if (!ratSiteApplied) {
+        ratSiteApplied = true;
+        if (site.preferred == other && !alternative.failures)
+            target = other;
+    }
+
+    if (target == ratServing && dwell && current.samples >= ratPolicy.minSamples) {
+        if (!alternative.samples) {
+            if (ratPolicy.explore && !alternative.failures) {
+                target = other;
+                reason = SIM_RAT_EXPLORE;
+            }
         }
+        else if (alternative.samples >= ratPolicy.minSamples && cost && otherCost) {
+            bool faster = (uint64_t)otherCost * 100 < (uint64_t)cost * (100 - ratPolicy.hysteresis);
+            site.preferred = faster ? other : ratServing;
+            if (faster) {
+                target = other;
+                reason = SIM_RAT_UNDERPERFORM;
+            }
+        }
+    }
 
-        //Send data to the server and update trackers
-        Send(src + dataSent, chunkLength);
-        dataSent += chunkLength;
-        dataLength -= chunkLength;
-        
-        //Wait for confirmation
-        if(!Receive((uint8_t*)rxBuffer, 0, 75000)) {
-            CloseFTPSession();
-            return SIM_FTP_TIMEOUT;
+    //Measurements and preferences are stored when evaluated, not per sample
+    if (target == ratServing) {
+        if (ratDirty)
+            StoreNetworkCache();
+        return ratServing;
+    }
+
+    LogRAT(ratServing, target, reason, cost, otherCost);
+    if (!apply)
+        return target;
+
+    //The site is kept, the other RAT usually has another tracking area code
+    SIM7080G_RAT previous = ratServing;
+    if (!SwitchRAT(target)) {
+        if (alternative.failures < UINT16_MAX)
+            alternative.failures++;
+        site.preferred = previous;
+        LogRAT(target, previous, SIM_RAT_REG_FAILED, otherCost, cost);
+
+        if (!SwitchRAT(previous)) {
+            ratSite = -1;
+            ratServing = SIM_RAT_NONE;
+            return SIM_RAT_NONE;
         }
-        
-        startPtr = strchr(rxBuffer, ',') + 1;
-        responseCode = CharToNmbr(startPtr);
+    }
 
-        #if SIM7080G_DEBUG_LEVEL >= 2
-        uartDebugInterface.printf("\tSIM7080G - FTP Upload: Status code: %u\n", rxBuffer[0] - '0');
-        uartDebugInterface.printf("\tSIM7080G - FTP Upload: Put response code %d, bytes sent: %u\n", responseCode, dataSent);
-        #endif
-        #if SIM7080G_DEBUG_LEVEL >= 2
-        uartDebugInterface.printf("\tSIM7080G - FTP Upload: RX buffer: \n%s\n", rxBuffer);
-        #endif
+    ratSwitched = true;
+    ratSwitchTime = millis();
+    StoreNetworkCache();
+    return ratServing;
+}
 
-        //Return if connection unsuccessful
-        if (responseCode > 1 && responseCode < 100)
-            return (SIM7080G_FTP_RESULT)responseCode;
+//
+bool SIM7080G::SampleSignal(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    SIM7080G_SIGNAL_SAMPLE sample;
+    SIM7080G_CELL_INFO info;
+
+    //One command while a cell serves the module
+    if (GetCellInfo(info)) {
+        sample.rat = info.rat;
+        sample.rssi = info.rssi;
+        sample.rsrp = info.rsrp;
+        sample.rsrq = info.rsrq;
+        sample.sinr = info.sinr;
+    }
+    else {
+        //+CESQ: <rxlev>,<ber>,<rscp>,<ecno>,<rsrq>,<rsrp> (255: not known)
+        SendCommand("AT+CESQ\r", rxBuffer);
+        char* startPtr = strstr(rxBuffer, "+CESQ: ");
+        if (startPtr) {
+            long fields[6] = { 0 };
+            char* ptr = startPtr + 7;
+            for (uint8_t i = 0; i < 6 && ptr; i++) {
+                fields[i] = strtol(ptr, nullptr, 10);
+                ptr = strchr(ptr, ',');
+                if (ptr)
+                    ptr++;
+            }
+            if (fields[4] >= 0 && fields[4] <= 34)
+                sample.rsrq = (fields[4] - 39) / 2;     //-19.5 dB + 0.5 dB steps
+            if (fields[5] >= 0 && fields[5] <= 97)
+                sample.rsrp = fields[5] - 140;
+        }
 
-        if(chunkLength != CharToNmbr(strchr(startPtr, ',') + 1)) {
-            chunkLength = CharToNmbr(strchr(startPtr, ',') + 1);
-            #if SIM7080G_DEBUG_LEVEL >= 2
-            uartDebugInterface.printf("\tSIM7080G - FTP Upload: Data chunk length changed: %u\n", chunkLength);
-            #endif
+        //+CSQ: <rssi>,<ber> (99: not known)
+        SendCommand("AT+CSQ\r", rxBuffer);
+        startPtr = strstr(rxBuffer, "+CSQ: ");
+        if (startPtr) {
+            long rssi = strtol(startPtr + 6, nullptr, 10);
+            if (rssi >= 0 && rssi <= 31)
+                sample.rssi = -113 + 2 * rssi;
         }
-    } // while(dataLength > chunkLength)
+    }
 
-    #if SIM7080G_DEBUG_LEVEL >= 2
-    uartDebugInterface.printf("\tSIM7080G - FTP Upload: Uploading last chunk!\n");
-    #endif
+    if (sample.rsrp == SIM7080_SIGNAL_UNKNOWN && sample.rssi == SIM7080_SIGNAL_UNKNOWN)
+        return false;
 
-    sprintf(buffer, "AT+FTPPUT=2,%u\r", dataLength);
-    SendCommand(buffer, rxBuffer, 75000);
+    sample.time = millis();
+    AddSignalSample(sample);
+    return true;
+}
+
+//
+void SIM7080G::SetSignalSampling(uint32_t interval, bool always) {
+    signalInterval = interval;
+    signalAlways = always;
+}
+
+//
+SIM7080G_SIGNAL SIM7080G::GetSignal(void) const {
+    return signalSmooth;
+}
+
+//
+size_t SIM7080G::GetSignalHistory(SIM7080G_SIGNAL_SAMPLE* dst, size_t max) const {
+    size_t count = 0;
+    for (; dst && count < max && count < signalCount; count++)
+        dst[count] = signalRing[(signalHead + count) % SIM7080G_SIGNAL_SAMPLES];
+    return count;
+}
+
+//
+int SIM7080G::ScheduleTransmit(SIM7080G_TX_CALLBACK callback, void* context, uint32_t maxDelay, uint8_t maxCE) {
+    if (!callback)
+        return SIM7080_INVALID_PARAMETER;
+
+    for (uint8_t i = 0; i < SIM7080G_TX_QUEUE; i++) {
+        if (txJobs[i].callback)
+            continue;
+
+        txJobs[i].callback = callback;
+        txJobs[i].context = context;
+        txJobs[i].queued = millis();
+        txJobs[i].maxDelay = maxDelay;
+        txJobs[i].maxCE = maxCE;
+        txPending++;
+        txStats.scheduled++;
+        return i;
+    }
+    return SIM7080_INVALID_PARAMETER;
+}
+
+//
+bool SIM7080G::CancelTransmit(int id) {
+    if (id < 0 || id >= SIM7080G_TX_QUEUE || !txJobs[id].callback)
+        return false;
+
+    txJobs[id] = SIM7080G_TX_JOB();
+    txPending--;
+    txStats.cancelled++;
+    return true;
+}
+
+//
+SIM7080G_TX_STATS SIM7080G::GetTxStats(void) const {
+    return txStats;
+}
+
+//
+void SIM7080G::ResetTxStats(void) {
+    txStats = SIM7080G_TX_STATS();
+}
+
+//
+bool SIM7080G::GetRATSite(SIM7080G_RAT_SITE& site) const {
+    if (ratSite < 0)
+        return false;
+    site = ratSites[ratSite];
+    return true;
+}
+
+//
+size_t SIM7080G::GetRATLog(SIM7080G_RAT_DECISION* dst, size_t max) const {
+    size_t count = 0;
+    for (; dst && count < max && count < ratLogCount; count++)
+        dst[count] = ratLog[(ratLogHead + count) % SIM7080G_RAT_LOG];
+    return count;
+}
+
+
+//
+uint8_t SIM7080G::GetCellFunction(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    SendCommand("AT+CFUN?\r", rxBuffer);
+    char* startPtr = strchr(rxBuffer, ':');
+    if (!startPtr)
+        return SIM7080_INVALID_RETURN_VALUE;
+    return CharToNmbr(startPtr + 2);
+}
+
+//
+bool SIM7080G::SetCellFunction(uint8_t functionCode) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    char buffer[16] = { '\0' };
+    sprintf(buffer, "AT+CFUN=%u\r", functionCode);
+    bool result = SendCommand(buffer, 10000);     //Changing functionality can take several seconds
+
+    //SIM and network state follow the functionality
+    if (result)
+        InvalidateShadow();
+
+    //Detached, the cached network restriction can go without losing a registration
+    if (result && !functionCode && netLocked)
+        UnlockNetwork();
+    return result;
+}
+
+//
+bool SIM7080G::GetTime(char* dst) {
+    uint64_t unixMs = 0;
+    if (!GetUnixTime(unixMs) && (!SyncTime(SIM_TIME_RTC) || !GetUnixTime(unixMs)))
+        return false;
+
+    //Civil date from the days since 1970-01-01
+    uint32_t seconds = unixMs / 1000 % 86400;
+    uint32_t z = unixMs / 86400000 + 719468;
+    uint32_t era = z / 146097;
+    uint32_t doe = z - era * 146097;
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp = (5 * doy + 2) / 153;
+    uint32_t day = doy - (153 * mp + 2) / 5 + 1;
+    uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+    uint32_t year = yoe + era * 400 + (month <= 2);
+
+    sprintf(dst, "%02u/%02u/%02u,%02u:%02u:%02u+00", (unsigned)(year % 100), (unsigned)month, (unsigned)day, (unsigned)(seconds / 3600), (unsigned)(seconds / 60 % 60), (unsigned)(seconds % 60));
+    return true;
+}
+
+//
+bool SIM7080G::SyncTime(SIM7080G_TIME_SOURCE source, const char* server) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+
+    switch (source) {
+    case SIM_TIME_RTC:
+        return ReadRTC(SIM_TIME_RTC);
+
+    case SIM_TIME_NTP: {
+        //Set the module clock to UTC from the server, then read it back
+        char buffer[96] = { '\0' };
+        snprintf(buffer, sizeof(buffer), "AT+CNTP=\"%s\",0,%u,0\r", server ? server : SIM7080G_NTP_SERVER, linkConf.pdidx);
+        if (!SendCommand(buffer, 1000))
+            return false;
+        SendCommand("AT+CNTP\r", rxBuffer, 1000);
+
+        //+CNTP: <code>[,<time>] (1: success), may have come with the result code
+        char* startPtr = strstr(rxBuffer, "+CNTP: ");
+        if (!startPtr && WaitForResponse("+CNTP: ", 65000))
+            startPtr = strstr(rxBuffer, "+CNTP: ");
+        if (!startPtr || startPtr[7] != '1') {
+#if SIM7080G_DEBUG_LEVEL >= 1
+            uartDebugInterface.printf("\tSIM7080G - NTP synchronisation failed\n");
+#endif
+            return false;
+        }
+        return ReadRTC(SIM_TIME_NTP);
+    }
+
+#if SIM7080G_ENABLE_GNSS
+    case SIM_TIME_GNSS: {
+        //GetGNSS() takes the sample
+        uint32_t samples = timeStatus.samples;
+        SIM7080G_GNSS gnss;
+        GetGNSS(&gnss);
+        return timeStatus.samples != samples;
+    }
+#endif
+
+    default:
+        return false;
+    }
+}
+
+//
+bool SIM7080G::SetNetworkTime(bool enable) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    char buffer[16] = { '\0' };
+    sprintf(buffer, "AT+CLTS=%u\r", enable);
+    return SendCommand(buffer);
+}
+
+//
+void SIM7080G::SetTimeSync(uint32_t maxError, SIM7080G_TIME_SOURCE autoSource) {
+    timeMaxError = maxError;
+    timeAutoSource = autoSource;
+    timeAttempt = 0;
+}
+
+//
+bool SIM7080G::GetUnixTime(uint64_t& unixMs) const {
+    if (!timeRef || TimeError() > timeMaxError)
+        return false;
+
+    uint32_t elapsed = millis() - timeRefMillis;
+    unixMs = timeRef + elapsed + (int32_t)(elapsed * (timeStatus.drift / 1e6f));
+    return true;
+}
+
+//
+SIM7080G_TIME_STATUS SIM7080G::GetTimeStatus(void) const {
+    SIM7080G_TIME_STATUS status = timeStatus;
+    status.error = TimeError();
+    return status;
+}
+
+//
+bool SIM7080G::EnterPIN(const char* pin, bool force) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+#if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("DEBUG START: EnterPin(%s)\n", pin);
+#endif
+    
+    //SIM PIN is already entered
+    if (GetPINStatus()) {
+#if SIM7080G_DEBUG_LEVEL >= 2
+        uartDebugInterface.printf("\tSIM PIN READY\nDEBUG END: EnterPin(%s)\n", pin);
+#elif SIM7080G_DEBUG_LEVEL == 1
+        uartDebugInterface.printf("\tSIM7080G - SIM PIN is already entered!\n");
+#endif
+        return true;
+    }
+
+    if (strlen(pin) == 4)
+    {
+#if SIM7080G_DEBUG_LEVEL >= 2
+        uartDebugInterface.printf("\tPin format OK!\nDEBUG END: EnterPin(%s)\n", pin);
+#endif
+        char tmpBuff[14] = {'A', 'T', '+', 'C', 'P', 'I', 'N', '=', '*', '*', '*', '*', '\r', '\0'};
+        memcpy(tmpBuff + 8, pin, 4);
+        bool result = SendCommand(tmpBuff);
+#if SIM7080G_SHADOW
+        if (result) {
+            shadowPIN = true;
+            ShadowSet(SIM_SHADOW_PIN);
+        }
+#endif
+        return result;
+    }
+#if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tPin format ERROR!\nDEBUG END: EnterPin(%s)\n", pin);
+#elif SIM7080G_DEBUG_LEVEL == 1
+    uartDebugInterface.printf("\tSIM7080G - SIM PIN format ERROR!");
+#endif
+    return false;
+}
+
+//
+bool SIM7080G::GetPINStatus(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+#if SIM7080G_SHADOW
+    if (ShadowFresh(SIM_SHADOW_PIN))
+        return shadowPIN;
+#endif
+    SendCommand("AT+CPIN?\r", rxBuffer);
+    return strstr(rxBuffer, "READY");
+}
+
+//
+bool SIM7080G::SetPDPContext(uint8_t pdidx, const SIM7080G_PDPCONF conf) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (pdidx >= SIM7080G_PDP_CONTEXTS)
+        return false;
+
+    char buffer[192] = { '\0' };
+    sprintf(buffer, "AT+CNCFG=%u,%u,\"%s\",\"%s\",\"%s\",%u\r", pdidx, conf.ipType, conf.apn, conf.username, conf.password, conf.auth);
+    return SendCommand(buffer);
+}
+
+//
+bool SIM7080G::ActivateAppNetwork(uint8_t pdidx, uint32_t timeout) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (pdidx >= SIM7080G_PDP_CONTEXTS)
+        return false;
+
+    if (GetAppNetworkStatus(pdidx) == 1) {
+#if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("DEBUG START: ActivateAppNetwork(void)\n\tSIM7080G - APP Network is already active!\nDEBUG END: ActivateAppNetwork(void)\n");
+#endif
+        return true;
+    }
+
+    char buffer[24] = { '\0' };
+    char token[24] = { '\0' };
+    sprintf(buffer, "AT+CNACT=%u,1\r", pdidx);
+    sprintf(token, "+APP PDP: %u,ACTIVE", pdidx);
+
+    //The URC can arrive together with the result code, so check both
+    if (!SendCommand(buffer) && !strstr(rxBuffer, token))
+        return false;
+
+    //The context is only usable after the module reports it active
+    bool active = WaitForResponse(token, timeout);
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+    if (!active)
+        uartDebugInterface.printf("\tSIM7080G - APP Network activation timed out!\n");
+#endif
+
+    return active;
+}
+
+//
+bool SIM7080G::DeactivateAppNetwork(uint8_t pdidx, uint32_t timeout) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (pdidx >= SIM7080G_PDP_CONTEXTS)
+        return false;
+
+    if (GetAppNetworkStatus(pdidx) == 0) {
+#if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("DEBUG START: DeactivateAppNetwork(void)\n\tSIM7080G - APP Network is already inactive!\nDEBUG END: DeactivateAppNetwork(void)\n");
+#endif
+        return true;
+    }
+
+    char buffer[24] = { '\0' };
+    char token[24] = { '\0' };
+    sprintf(buffer, "AT+CNACT=%u,0\r", pdidx);
+    sprintf(token, "+APP PDP: %u,DEACTIVE", pdidx);
+
+    if (!SendCommand(buffer) && !strstr(rxBuffer, token))
+        return false;
+
+    return WaitForResponse(token, timeout);
+}
+
+//
+uint8_t SIM7080G::GetAppNetworkStatus(uint8_t pdidx) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+#if SIM7080G_SHADOW
+    if (pdidx < SIM7080G_PDP_CONTEXTS && ShadowFresh(SIM_SHADOW_APPN + pdidx))
+        return shadowAppn[pdidx];
+#endif
+    if(!SendCommand("AT+CNACT?\r", rxBuffer, 250)) {
+        SIM7080G_TRACE_EVENT(SIM_TRACE_APPN_STATUS, pdidx, SIM7080_INVALID_RETURN_VALUE);
+        return SIM7080_INVALID_RETURN_VALUE;
+    }
+    char* startPtr = FindAppNetwork(pdidx);
+    
+    //Return if startPtr is null
+    if(!startPtr)
+        return SIM7080_INVALID_RETURN_VALUE;
+    
+    uint8_t status = CharToNmbr(startPtr, 1);
+    #if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("DEBUG START: GetAppNetworkStatus(void)\n");
+    uartDebugInterface.printf("\tAPP Network %u Status:%d\n", pdidx, status);
+    uartDebugInterface.printf("DEBUG END: GetAppNetworkStatus(void)\n");
+    #endif
+    SIM7080G_TRACE_EVENT(SIM_TRACE_APPN_STATUS, pdidx, status);
+
+    return status;
+}
+
+//
+uint8_t SIM7080G::GetActiveAppNetworks(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+#if SIM7080G_SHADOW
+    bool fresh = true;
+    for (uint8_t i = 0; i < SIM7080G_PDP_CONTEXTS; i++)
+        fresh &= ShadowFresh(SIM_SHADOW_APPN + i, false);
+
+    if (fresh) {
+        shadowStats.hits++;
+        uint8_t active = 0;
+        for (uint8_t i = 0; i < SIM7080G_PDP_CONTEXTS; i++)
+            if (shadowAppn[i] == 1)
+                active |= 1 << i;
+        return active;
+    }
+    shadowStats.misses++;
+#endif
+    if(!SendCommand("AT+CNACT?\r", rxBuffer, 250))
+        return 0;
+
+    uint8_t active = 0;
+    for (uint8_t i = 0; i < SIM7080G_PDP_CONTEXTS; i++) {
+        char* startPtr = FindAppNetwork(i);
+        if (startPtr && *startPtr == '1')
+            active |= 1 << i;
+    }
+    return active;
+}
+
+//
+void SIM7080G::GetAppNetworkInfo(SIM7080G_APPN* info, uint8_t pdidx) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    if(info == NULL || pdidx >= SIM7080G_PDP_CONTEXTS)
+        return;
+
+#if SIM7080G_SHADOW
+    //An active context is only answered once its address is known
+    if (ShadowFresh(SIM_SHADOW_APPN + pdidx, false) && (shadowAppn[pdidx] != 1 || shadowIP[pdidx][0])) {
+        shadowStats.hits++;
+        info->pdidx = pdidx;
+        info->statusx = shadowAppn[pdidx];
+        strcpy(info->ipv4, shadowIP[pdidx]);
+        return;
+    }
+    shadowStats.misses++;
+#endif
+
+    SendCommand("AT+CNACT?\r", rxBuffer, 250);
+    info->pdidx = pdidx;
+
+    //+CNACT: <pdidx>,<statusx>,<address>
+    char* startPtr = FindAppNetwork(pdidx);
+    if (!startPtr)
+        return;
+    info->statusx = CharToNmbr(startPtr, 1);
+
+    startPtr = strchr(startPtr, '\"');
+    if (!startPtr)
+        return;
+    startPtr++;
+    char* endPtr = strchr(startPtr, '\"');
+    size_t charCntr = endPtr ? endPtr - startPtr : 0;
+
+    //Check against nullptr or wrong IP address length calculation
+    if (charCntr < 7 || charCntr > 15) //IP should be at leas 7 or at max 15 characters
+        return;
+
+    strncpy(info->ipv4, startPtr, charCntr);
+    info->ipv4[charCntr] = '\0';
+}
+
+//
+SIM7080G_APPN SIM7080G::GetAppNetworkInfo(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    SIM7080G_APPN info;
+    GetAppNetworkInfo(&info);
+    return info;
+}
+
+//
+void SIM7080G::SetLinkSupervisor(const SIM7080G_LINK_CONF conf) {
+    linkConf = conf;
+}
+
+//
+SIM7080G_LINK_STATE SIM7080G::SuperviseLink(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    uint32_t now = millis();
+
+    //Availability accounting
+    if (linkLastTick) {
+        if (linkState == SIM_LINK_UP)
+            linkStats.upTime += now - linkLastTick;
+        else
+            linkStats.downTime += now - linkLastTick;
+    }
+    linkLastTick = now;
+
+    //Pick up +APP PDP URCs
+    ReadURC();
+
+    SIM7080G_LINK_STATE prevState = linkState;
+
+    switch (linkState) {
+    case SIM_LINK_UP:
+        //Context dropped by the network
+        if (linkLost) {
+            linkStats.stalls++;
+            EscalateLink();
+            break;
+        }
+
+        //Data flowed recently, nothing to verify
+        if (now - linkLastTraffic < linkConf.probeInterval)
+            break;
+
+        if (ProbeLink()) {
+            linkProbeFails = 0;
+            break;
+        }
+
+        //Context looks active but data does not flow
+        if (++linkProbeFails >= linkConf.stallThreshold) {
+            linkStats.stalls++;
+            EscalateLink();
+        }
+        break;
+
+    case SIM_LINK_DOWN:
+        linkLost = false;
+        if (ActivateAppNetwork(linkConf.pdidx, linkConf.activationTimeout))
+            linkState = SIM_LINK_VERIFY;
+        else
+            EscalateLink();
+        break;
+
+    case SIM_LINK_VERIFY:
+        if (ProbeLink())
+            LinkRecovered(millis());
+        else
+            EscalateLink();
+        break;
+
+    case SIM_LINK_REACTIVATE:
+        linkStats.reactivations++;
+        DeactivateAppNetwork(linkConf.pdidx);
+        linkState = SIM_LINK_DOWN;
+        break;
+
+    case SIM_LINK_CFUN_CYCLE:
+        linkStats.cfunCycles++;
+        SetCellFunction(0);
+        SetCellFunction(1);
+
+        //Activating before the module registered again would fail and escalate at once
+        if (WaitRegistration(linkConf.registrationTimeout))
+            linkState = SIM_LINK_DOWN;
+        else
+            EscalateLink();
+        break;
+
+    case SIM_LINK_REBOOT:
+        linkStats.reboots++;
+        Reboot();
+        if (WaitReady(20000))
+            ApplyInitProfile();
+        linkAttempts = 0;           //Start the escalation over after a reboot
+        linkState = SIM_LINK_DOWN;
+        break;
+    }
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+    if (prevState != linkState)
+        uartDebugInterface.printf("\tSIM7080G - Link supervisor: state %d -> %d\n", prevState, linkState);
+#else
+    (void)prevState;
+#endif
+
+    return linkState;
+}
+
+//
+SIM7080G_LINK_STATE SIM7080G::GetLinkState(void) const {
+    return linkState;
+}
+
+//
+SIM7080G_LINK_STATS SIM7080G::GetLinkStats(void) const {
+    SIM7080G_LINK_STATS stats = linkStats;
+    uint64_t total = (uint64_t)stats.upTime + stats.downTime;
+    stats.availability = total ? (uint16_t)((uint64_t)stats.upTime * 1000 / total) : 0;
+    return stats;
+}
+
+//
+void SIM7080G::ResetLinkStats(void) {
+    linkStats = SIM7080G_LINK_STATS();
+}
+
+//
+void SIM7080G::NotifyLinkTraffic(void) {
+    linkLastTraffic = millis();
+
+#if SIM7080G_SHADOW
+    //First data exchange since boot
+    if (bootCounting) {
+        bootCounting = false;
+        shadowStats.bootTime = linkLastTraffic - bootStart;
+    }
+#endif
+
+    //First data after a wake-up
+    if (psmWakePending) {
+        uint32_t latency = linkLastTraffic - psmWakeStart;
+        psmWakePending = false;
+        psmStats.wakes++;
+        psmStats.lastWakeLatency = latency;
+        psmStats.totalWakeLatency += latency;
+        if (latency > psmStats.maxWakeLatency)
+            psmStats.maxWakeLatency = latency;
+    }
+}
+
+//
+bool SIM7080G::SetPSM(bool enable, uint32_t tau, uint32_t activeTime) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!enable)
+        return SendCommand("AT+CPSMS=0\r");
+
+    //PSM state and granted timers are reported in URCs, without them InPSM() would not follow the module
+    if (!SendCommand("AT+CPSMSTATUS=1\r") || !SendCommand("AT+CEREG=4\r"))
+        return false;
+
+    char tauBits[9], activeBits[9];
+    EncodePSMTimer(tau, true, tauBits);
+    EncodePSMTimer(activeTime, false, activeBits);
+
+    char buffer[40] = { '\0' };
+    sprintf(buffer, "AT+CPSMS=1,,,\"%s\",\"%s\"\r", tauBits, activeBits);
+    bool result = SendCommand(buffer);
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+    uartDebugInterface.printf("\tSIM7080G - PSM request: TAU %s (%lu s), active time %s (%lu s): %s\n", tauBits, (unsigned long)DecodePSMTimer(tauBits, true), activeBits, (unsigned long)DecodePSMTimer(activeBits, false), result ? "OK" : "FAILED");
+#endif
+
+    return result;
+}
+
+//
+bool SIM7080G::SetEDRX(bool enable, SIM7080G_EDRX_ACT act, uint32_t cycle) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    //Cycle length in multiples of 5.12 s per value
+    const uint16_t cycles[] = { 1, 2, 4, 8, 12, 16, 20, 24, 28, 32, 64, 128, 256, 512, 1024, 2048 };
+    //Values NB-IoT accepts
+    const uint16_t nbiot = 0xFE2C;
+
+    edrxAct = act;
+
+    char buffer[32] = { '\0' };
+    if (!enable) {
+        sprintf(buffer, "AT+CEDRXS=0,%u\r", act);
+        return SendCommand(buffer);
+    }
+
+    uint8_t value = 15;
+    for (uint8_t i = 0; i < 16; i++) {
+        if (act == SIM_EDRX_NBIOT && !(nbiot & (1 << i)))
+            continue;
+        if ((uint32_t)cycles[i] * 5120 >= cycle) {
+            value = i;
+            break;
+        }
+    }
+
+    //Mode 2: granted values are reported with +CEDRXP
+    sprintf(buffer, "AT+CEDRXS=2,%u,\"%u%u%u%u\"\r", act, (value >> 3) & 1, (value >> 2) & 1, (value >> 1) & 1, value & 1);
+    bool result = SendCommand(buffer);
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+    uartDebugInterface.printf("\tSIM7080G - eDRX request: %lu ms: %s\n", (unsigned long)cycles[value] * 5120, result ? "OK" : "FAILED");
+#endif
+
+    return result;
+}
+
+//
+SIM7080G_PSM_GRANT SIM7080G::GetPowerSavingGrant(bool refresh) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    if (refresh) {
+        //+CEREG: <n>,<stat>[,<tac>,<ci>,<AcT>[,<cause_type>,<reject_cause>[,<Active-Time>,<Periodic-TAU>]]]
+        SendCommand("AT+CEREG?\r", rxBuffer);
+        char* startPtr = strstr(rxBuffer, "+CEREG: ");
+        if (startPtr)
+            ParseCEREG(startPtr);
+
+        //+CEDRXRDP: <AcT-type>[,<Requested_eDRX_value>,<NW-provided_eDRX_value>,<Paging_time_window>]
+        SendCommand("AT+CEDRXRDP\r", rxBuffer);
+        startPtr = strstr(rxBuffer, "+CEDRXRDP: ");
+        if (startPtr)
+            ParseEDRX(startPtr);
+    }
+
+#if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - PSM: %s (TAU %lu s, active %lu s) | eDRX: %s (cycle %lu ms, PTW %lu ms)\n", psmGrant.psm ? "granted" : "off", (unsigned long)psmGrant.tau, (unsigned long)psmGrant.activeTime, psmGrant.edrx ? "granted" : "off", (unsigned long)psmGrant.edrxCycle, (unsigned long)psmGrant.ptw);
+#endif
+
+    return psmGrant;
+}
+
+//
+bool SIM7080G::InPSM() const {
+    return psmActive;
+}
+
+//
+bool SIM7080G::WakeFromPSM(uint32_t timeout) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    //A long PWRKEY pulse would switch an awake module off
+    if (TestUART())
+        return true;
+
+    //Also pulse without +CPSMSTATUS, the URC may have been missed
+    psmWakeStart = millis();
+    psmWakePending = true;
+    PowerCycle(SIM7080G_PSM_WAKE_PULSE);
+
+    for (uint32_t start = millis(); millis() - start < timeout;) {
+        if (TestUART())
+            return true;
+        delay(100);
+    }
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+    uartDebugInterface.printf("\tSIM7080G - PSM: Module did not wake up!\n");
+#endif
+    return false;
+}
+
+//
+SIM7080G_PSM_STATS SIM7080G::GetPSMStats() const {
+    SIM7080G_PSM_STATS stats = psmStats;
+    if (psmActive)
+        stats.psmTime += millis() - psmEnterTime;
+    return stats;
+}
+
+//
+void SIM7080G::ResetPSMStats() {
+    psmStats = SIM7080G_PSM_STATS();
+    psmEnterTime = millis();
+}
+
+
+//  #
+//  #   IP applications
+//  #
+
+//
+int SIM7080G::Ping4(const char* address, uint16_t pingCount, uint16_t packetSize, uint32_t timeout, SIM7080G_PING_RESULT* result) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    SIM7080G_PING_RESULT localResult;
+    if (!result)
+        result = &localResult;
+
+    if (!Ping4Start(result, address, pingCount, packetSize, timeout))
+        return SIM7080_INVALID_PARAMETER;
+
+    //Only the replies are collected, the services of Loop() must not run inside the probe
+    while (!result->done) {
+        ReadURC();
+        delay(1);
+    }
+
+    SIM7080G_TRACE_EVENT(SIM_TRACE_PING, result->received, result->count);
+
+    return result->received;
+}
+
+//
+bool SIM7080G::Ping4Start(SIM7080G_PING_RESULT* result, const char* address, uint16_t pingCount, uint16_t packetSize, uint32_t timeout) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!result || !address || !pingCount || !packetSize || !timeout || pingResult)
+        return false;       //Wrong parameters or probe already running
+
+    char ip[16] = { '\0' };
+    if (!ResolveHost(address, ip))
+        return false;       //Bad address
+
+    if (!GetActiveAppNetworks())
+        return false;       //APP network inactive
+
+    //Check parameter values
+    if(pingCount > 500)
+        pingCount = 500;
+
+    if (packetSize > 1400)
+        packetSize = 1400;
+
+    if (timeout > 60000)
+        timeout = 60000;
+
+    #if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - Pinging %s with %u bytes of data...\n", ip, packetSize);
+    #endif
+
+    *result = SIM7080G_PING_RESULT();
+    strcpy(result->address, ip);
+    result->count = pingCount;
+
+    pingResult = result;
+    pingTimeout = timeout;
+    pingDeadline = millis() + (uint32_t)pingCount * (timeout + 100) + 1000;
+
+    char buffer[64] = { '\0' };
+    sprintf(buffer, "AT+SNPING4=\"%s\",%u,%u,%u\r", ip, pingCount, packetSize, timeout);
+    if (!SendCommand(buffer) && !strstr(rxBuffer, "+SNPING4:")) {
+        pingResult = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+//
+bool SIM7080G::Ping4Busy(void) const {
+    return pingResult != nullptr;
+}
+
+//
+bool SIM7080G::CharacteriseLink(const char* address, SIM7080G_LINK_PROFILE* profile, int socket) {
+    SIM7080G_LANE_GUARD(SIM_LANE_BULK);
+    const uint16_t sizes[] = { 32, 256, 512, 1024, 1400 };
+    const uint8_t sizeCount = sizeof(sizes) / sizeof(sizes[0]);
+    uint32_t rtts[sizeCount] = { 0 };
+    SIM7080G_PING_RESULT result;
+
+    SIM7080G_LINK_PROFILE measured;
+    uint16_t largestOk = 0;
+    uint16_t smallestLost = 0;
+
+    //RTT against payload size
+    uint8_t okCount = 0;
+    for (uint8_t i = 0; i < sizeCount; i++) {
+        YieldLane();
+        if (Ping4(address, 3, sizes[i], 5000, &result) <= 0) {
+            smallestLost = sizes[i];
+            break;
+        }
+        rtts[i] = result.min;
+        largestOk = sizes[i];
+        okCount++;
+    }
+
+    if (!okCount)
+        return false;
+
+    //Narrow down the largest payload that still gets through
+    for (uint8_t step = 0; smallestLost && step < 4 && smallestLost - largestOk > 16; step++) {
+        uint16_t size = (largestOk + smallestLost) / 2;
+        YieldLane();
+        if (Ping4(address, 2, size, 5000, &result) > 0)
+            largestOk = size;
+        else
+            smallestLost = size;
+    }
+
+    measured.mtu = largestOk + 28;     //IPv4 + ICMP headers
+    measured.minRtt = rtts[0];
+
+    //Least squares slope of RTT over payload size
+    if (okCount > 1) {
+        double meanSize = 0, meanRtt = 0, cov = 0, var = 0;
+        for (uint8_t i = 0; i < okCount; i++) {
+            meanSize += sizes[i];
+            meanRtt += rtts[i];
+        }
+        meanSize /= okCount;
+        meanRtt /= okCount;
+        for (uint8_t i = 0; i < okCount; i++) {
+            cov += (sizes[i] - meanSize) * (rtts[i] - meanRtt);
+            var += (sizes[i] - meanSize) * (sizes[i] - meanSize);
+        }
+        double slope = var > 0 && cov > 0 ? cov / var : 0;     //ms per byte
+        measured.rttPerKB = slope * 1024;
+
+        //The echo carries the payload both ways
+        if (slope > 0)
+            measured.goodput = 2000.0 / slope;
+    }
+
+    //Upload bursts on the sink socket
+    if (socket >= 0 && SocketConnected(socket)) {
+        //Payload content does not matter, send straight from rxBuffer instead of a stack array
+        size_t burst = uartMaxRecvSize < SIM7080G_SOCKET_MAX_SEND ? uartMaxRecvSize : SIM7080G_SOCKET_MAX_SEND;
+
+        uint32_t bytes = 0;
+        uint32_t start = millis();
+        for (uint8_t i = 0; i < 4; i++)
+            bytes += SocketSend(socket, (const uint8_t*)rxBuffer, burst);
+        uint32_t elapsed = millis() - start;
+
+        if (bytes && elapsed)
+            measured.goodput = (uint64_t)bytes * 1000 / elapsed;
+    }
+
+    //Only measured values rate the RAT
+    AddRATSample(measured.minRtt, measured.goodput);
+
+    if (!measured.goodput)
+        measured.goodput = 1000;        //No slope (flat RTT), assume a slow link
+
+    measured.bdp = (uint64_t)measured.goodput * measured.minRtt / 1000;
+
+    //Chunks of at least one MTU, growing with the BDP to keep the pipe full
+    uint32_t payloadMtu = measured.mtu > 40 ? measured.mtu - 40 : measured.mtu;    //IP + TCP headers
+    uint32_t chunk = measured.bdp > payloadMtu ? measured.bdp : payloadMtu;
+
+    measured.socketChunk = chunk > SIM7080G_SOCKET_MAX_SEND ? SIM7080G_SOCKET_MAX_SEND : chunk;
+    measured.ftpChunk = chunk < 256 ? 256 : (chunk > 1460 ? 1460 : chunk / 256 * 256);
+    measured.measured = millis();
+    measured.valid = true;
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+    uartDebugInterface.printf("\tSIM7080G - Link: MTU %u, min RTT %u ms, goodput %u B/s, BDP %u B\n", measured.mtu, measured.minRtt, measured.goodput, measured.bdp);
+#endif
+
+    linkProfile = measured;
+    if (profile)
+        *profile = measured;
+
+    return true;
+}
+
+//
+SIM7080G_LINK_PROFILE SIM7080G::GetLinkProfile(void) const {
+    return linkProfile;
+}
+
+//
+void SIM7080G::SetLinkProfile(const SIM7080G_LINK_PROFILE profile) {
+    linkProfile = profile;
+}
+
+//
+uint8_t SIM7080G::PingBucket(uint32_t rtt) {
+    if (rtt < 4)
+        return rtt;
+    if (rtt > 0xFFFF)
+        rtt = 0xFFFF;
+
+    uint8_t octave = 0;
+    for (uint32_t v = rtt; v > 1; v >>= 1)
+        octave++;
+
+    return 4 * (octave - 1) + ((rtt >> (octave - 2)) & 0x03);
+}
+
+//
+uint32_t SIM7080G::PingBucketFloor(uint8_t bucket) {
+    if (bucket < 4)
+        return bucket;
+
+    uint8_t octave = bucket / 4 + 1;
+    return (uint32_t)(4 + bucket % 4) << (octave - 2);
+}
+
+
+//  #
+//  #   TCP/UDP sockets
+//  #
+
+//
+int SIM7080G::SocketOpen(SIM7080G_SOCKET_TYPE type, const char* host, uint16_t port, uint8_t pdidx, bool tls) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!host || pdidx >= SIM7080G_PDP_CONTEXTS || strlen(host) > 64)
+        return SIM7080_INVALID_PARAMETER;
+
+    //Connect to the cached address, keep the name for TLS (SNI and certificate check)
+    char ip[16] = { '\0' };
+    if (!tls && ResolveHost(host, ip))
+        host = ip;
+
+    if (tls && (type != SIM_SOCKET_TCP || !tlsConfigured))
+        return SIM7080_INVALID_PARAMETER;
+
+    //Find a free connection ID
+    uint8_t id = 0;
+    for (; id < SIM7080G_MAX_SOCKETS && sockets[id].open; id++);
+    if (id == SIM7080G_MAX_SOCKETS)
+        return SIM7080_INVALID_PARAMETER;
+
+    char buffer[128] = { '\0' };
+
+    //Release an ID closed by the remote side
+    if (sockets[id].closePending) {
+        sprintf(buffer, "AT+CACLOSE=%u\r", id);
+        SendCommand(buffer, 2000);
+        sockets[id].closePending = false;
+    }
+
+    //Bind the connection to the SSL context, plain connections only reset an ID that used SSL before
+    if (tls || sockets[id].ssl) {
+        sprintf(buffer, "AT+CASSLCFG=%u,\"SSL\",%u\r", id, tls ? 1 : 0);
+        if (!SendCommand(buffer))
+            return SIM7080_INVALID_PARAMETER;
+        sockets[id].ssl = tls;
+    }
+
+    if (tls) {
+        sprintf(buffer, "AT+CASSLCFG=%u,\"CRINDEX\",%u\r", id, tlsConf.ctxIndex);
+        if (!SendCommand(buffer))
+            return SIM7080_INVALID_PARAMETER;
+
+        if (tlsConf.caCert[0] != '\0') {
+            sprintf(buffer, "AT+CASSLCFG=%u,\"CACERT\",\"%s\"\r", id, tlsConf.caCert);
+            if (!SendCommand(buffer))
+                return SIM7080_INVALID_PARAMETER;
+        }
+
+        if (tlsConf.clientCert[0] != '\0') {
+            sprintf(buffer, "AT+CASSLCFG=%u,\"CERT\",\"%s\"\r", id, tlsConf.clientCert);
+            if (!SendCommand(buffer))
+                return SIM7080_INVALID_PARAMETER;
+        }
+    }
+
+    //recv_mode 0: data is announced by +CADATAIND and read with AT+CARECV
+    sprintf(buffer, "AT+CAOPEN=%u,%u,\"%s\",\"%s\",%u,0\r", id, pdidx, type == SIM_SOCKET_UDP ? "UDP" : "TCP", host, port);
+    uint32_t start = millis();
+    SendCommand(buffer, rxBuffer, 5000);
+
+    //Result arrives after the connection attempt (and the handshake with TLS)
+    bool connected = WaitForResponse("+CAOPEN:", 60000);
+    char* startPtr = connected ? strchr(strstr(rxBuffer, "+CAOPEN:"), ',') : NULL;
+    connected = startPtr && CharToNmbr(startPtr + 1) == 0;
+
+    if (tls)
+        RecordHandshake(millis() - start, connected);
+
+    if (!connected) {
+#if SIM7080G_DEBUG_LEVEL >= 1
+        uartDebugInterface.printf("\tSIM7080G - Socket %u: Connection to %s:%u failed!\n", id, host, port);
+#endif
+        return SIM7080_INVALID_PARAMETER;
+    }
+
+    sockets[id] = SIM7080G_SOCKET();
+    sockets[id].open = true;
+    sockets[id].pdidx = pdidx;
+    sockets[id].datagram = type == SIM_SOCKET_UDP;
+    sockets[id].ssl = tls;
+
+    return id;
+}
+
+//
+bool SIM7080G::SocketClose(uint8_t id) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (id >= SIM7080G_MAX_SOCKETS)
+        return false;
+
+    char buffer[20] = { '\0' };
+    sprintf(buffer, "AT+CACLOSE=%u\r", id);
+    bool result = SendCommand(buffer, 2000);
+
+    sockets[id].open = false;
+    sockets[id].dataPending = false;
+    sockets[id].closePending = false;
+    sockets[id].rxCount = 0;
+
+    return result;
+}
+
+//
+size_t SIM7080G::SocketSend(uint8_t id, const uint8_t* src, size_t len) {
+    SIM7080G_LANE_GUARD(SIM_LANE_BULK);
+    if (id >= SIM7080G_MAX_SOCKETS || !sockets[id].open || !src)
+        return 0;
+
+    char buffer[32] = { '\0' };
+    size_t dataSent = 0;
+
+    while (dataSent < len) {
+        size_t maxChunk = linkProfile.valid && linkProfile.socketChunk ? linkProfile.socketChunk : SIM7080G_SOCKET_MAX_SEND;
+        size_t chunkLength = len - dataSent > maxChunk ? maxChunk : len - dataSent;
+
+        sprintf(buffer, "AT+CASEND=%u,%u\r", id, chunkLength);
+        if (!SendData(buffer, src + dataSent, chunkLength, 10000))
+            break;
+
+        dataSent += chunkLength;
+
+        //Let status commands of other tasks through between chunks
+        YieldLane();
+    }
+
+#if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - Socket %u: Sent %u of %u bytes\n", id, dataSent, len);
+#endif
+
+    if (dataSent)
+        NotifyLinkTraffic();
+
+    return dataSent;
+}
+
+//
+size_t SIM7080G::SocketRead(uint8_t id, uint8_t* dst, size_t len) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (id >= SIM7080G_MAX_SOCKETS || !dst)
+        return 0;
+
+    SIM7080G_SOCKET& socket = sockets[id];
+    size_t bytesRead = 0;
+
+    for (; bytesRead < len && socket.rxCount; bytesRead++) {
+        dst[bytesRead] = socket.rxBuffer[socket.rxHead];
+        socket.rxHead = (socket.rxHead + 1) % SIM7080G_SOCKET_RX_BUFFER;
+        socket.rxCount--;
+    }
+
+    //The rest of a datagram is dropped, the next read starts at the next datagram
+    if (socket.datagram)
+        socket.rxCount = 0;
+
+    return bytesRead;
+}
+
+//
+size_t SIM7080G::SocketAvailable(uint8_t id) const {
+    return id < SIM7080G_MAX_SOCKETS ? sockets[id].rxCount : 0;
+}
+
+//
+bool SIM7080G::SocketConnected(uint8_t id) const {
+    return id < SIM7080G_MAX_SOCKETS && sockets[id].open;
+}
+
+
+//  #
+//  #   DNS
+//  #
+
+//
+bool SIM7080G::ResolveHost(const char* host, char* ip) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!host || !ip || strlen(host) >= sizeof(SIM7080G_DNS_ENTRY::host))
+        return false;
+
+    //Nothing to resolve
+    if (IsIPv4(host)) {
+        strcpy(ip, host);
+        return true;
+    }
+
+    uint32_t now = millis();
+    SIM7080G_DNS_ENTRY* entry = NULL;
+    SIM7080G_DNS_ENTRY* victim = &dnsCache[0];
+
+    for (uint8_t i = 0; i < SIM7080G_DNS_CACHE; i++) {
+        if (!strcmp(dnsCache[i].host, host)) {
+            entry = &dnsCache[i];
+            break;
+        }
+
+        //Replace a free or the least recently used entry
+        if (victim->host[0] != '\0' && (dnsCache[i].host[0] == '\0' || dnsCache[i].lastUsed < victim->lastUsed))
+            victim = &dnsCache[i];
+    }
+
+    //Fresh entry
+    if (entry && now - entry->resolved < entry->ttl) {
+        entry->lastUsed = now;
+        entry->used = true;
+        if (entry->ip[0] == '\0') {
+            dnsStats.negativeHits++;
+            return false;
+        }
+        dnsStats.hits++;
+        strcpy(ip, entry->ip);
+        return true;
+    }
+
+    if (!entry) {
+        entry = victim;
+        *entry = SIM7080G_DNS_ENTRY();
+        strcpy(entry->host, host);
+    }
+
+    dnsStats.misses++;
+    entry->lastUsed = now;
+    entry->used = false;
+    if (!LookupHost(entry))
+        return false;
+
+    strcpy(ip, entry->ip);
+    return true;
+}
+
+//
+void SIM7080G::SetDNSTTL(uint32_t ttl, uint32_t negativeTtl) {
+    dnsTTL = ttl;
+    dnsNegativeTTL = negativeTtl;
+}
+
+//
+void SIM7080G::FlushDNSCache(void) {
+    for (uint8_t i = 0; i < SIM7080G_DNS_CACHE; i++)
+        dnsCache[i] = SIM7080G_DNS_ENTRY();
+    dnsRefresh = -1;
+}
+
+//
+SIM7080G_DNS_STATS SIM7080G::GetDNSStats(void) const {
+    return dnsStats;
+}
+
+
+//  #
+//  #   SSL/TLS
+//  #
+
+//
+bool SIM7080G::UploadCertificate(const char* name, const uint8_t* data, size_t length) {
+    SIM7080G_LANE_GUARD(SIM_LANE_BULK);
+    if (!name || !data || !length || strlen(name) >= sizeof(SIM7080G_TLS_CERT::name) - 4)
+        return false;
+
+    uint32_t hash = Fnv1a(data, length);
+
+    //Find the certificate's slot, or a free one
+    SIM7080G_TLS_CERT* cert = NULL;
+    for (uint8_t i = 0; i < SIM7080G_TLS_CERTS && !cert; i++)
+        if (!strcmp(tlsCerts[i].name, name))
+            cert = &tlsCerts[i];
+    for (uint8_t i = 0; i < SIM7080G_TLS_CERTS && !cert; i++)
+        if (tlsCerts[i].name[0] == '\0')
+            cert = &tlsCerts[i];
+    if (!cert)
+        return false;
+
+    //Already uploaded with this content since boot
+    if (cert->name[0] != '\0' && cert->hash == hash) {
+        tlsStats.certSkips++;
+        return true;
+    }
+
+    //Compare with the hash stored on the module
+    char hashName[36] = { '\0' };
+    char storedHash[12] = { '\0' };
+    char hashText[12] = { '\0' };
+    sprintf(hashName, "%s.fnv", name);
+    sprintf(hashText, "%08lx", (unsigned long)hash);
+
+    if (ReadModuleFile(hashName, storedHash, 8) == 8 && !strncmp(storedHash, hashText, 8)) {
+        strcpy(cert->name, name);
+        cert->hash = hash;
+        cert->pending = false;
+        tlsStats.certSkips++;
+#if SIM7080G_DEBUG_LEVEL >= 2
+        uartDebugInterface.printf("\tSIM7080G - Certificate %s unchanged, upload skipped\n", name);
+#endif
+        return true;
+    }
+
+    if (!WriteModuleFile(name, data, length))
+        return false;
+
+    //Conversion (and storing the hash) happens in SetTLS()
+    strcpy(cert->name, name);
+    cert->hash = hash;
+    cert->pending = true;
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+    uartDebugInterface.printf("\tSIM7080G - Certificate %s uploaded (%u bytes)\n", name, length);
+#endif
+
+    return true;
+}
+
+//
+bool SIM7080G::SetTLS(const SIM7080G_TLSCONF conf) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (conf.ctxIndex > 5)
+        return false;
+
+    char buffer[128] = { '\0' };
+
+    sprintf(buffer, "AT+CSSLCFG=\"SSLVERSION\",%u,%u\r", conf.ctxIndex, conf.version);
+    if (!SendCommand(buffer))
+        return false;
+
+    sprintf(buffer, "AT+CSSLCFG=\"IGNORERTCTIME\",%u,%u\r", conf.ctxIndex, conf.ignoreRtcTime ? 1 : 0);
+    if (!SendCommand(buffer))
+        return false;
+
+    if (conf.sni[0] != '\0') {
+        sprintf(buffer, "AT+CSSLCFG=\"SNI\",%u,\"%s\"\r", conf.ctxIndex, conf.sni);
+        if (!SendCommand(buffer))
+            return false;
+    }
+
+    //Convert only certificates written since the last conversion
+    if (conf.caCert[0] != '\0' && !ConvertCertificate(2, conf.caCert))
+        return false;
+
+    if (conf.clientCert[0] != '\0' && !ConvertCertificate(1, conf.clientCert, conf.clientKey))
+        return false;
+
+    tlsConf = conf;
+    tlsConfigured = true;
+
+    //Bind the HTTP session to the new context on the next request
+    profileKnown &= ~(1UL << SIM_PROFILE_HTTP_SSL);
+    return true;
+}
+
+//
+SIM7080G_TLS_STATS SIM7080G::GetTLSStats(void) const {
+    return tlsStats;
+}
+
+//
+void SIM7080G::ResetTLSStats(void) {
+    tlsStats = SIM7080G_TLS_STATS();
+}
+
+
+#if SIM7080G_ENABLE_MQTT
+//  #
+//  #   MQTT
+//  #
+
+//
+bool SIM7080G::MQTTConnect(const SIM7080G_MQTTCONF conf) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (conf.host[0] == '\0')
+        return false;
+
+    if (mqttConnected)
+        MQTTDisconnect();
+
+    char buffer[128] = { '\0' };
+
+    sprintf(buffer, "AT+SMCONF=\"URL\",\"%s\",%u\r", conf.host, conf.port);
+    if (!SendCommand(buffer))
+        return false;
+
+    sprintf(buffer, "AT+SMCONF=\"KEEPTIME\",%u\r", conf.keepAlive);
+    if (!SendCommand(buffer))
+        return false;
+
+    sprintf(buffer, "AT+SMCONF=\"CLEANSS\",%u\r", conf.cleanSession ? 1 : 0);
+    if (!SendCommand(buffer))
+        return false;
+
+    sprintf(buffer, "AT+SMCONF=\"CLIENTID\",\"%s\"\r", conf.clientId);
+    if (!SendCommand(buffer))
+        return false;
+
+    if (conf.username[0] != '\0') {
+        sprintf(buffer, "AT+SMCONF=\"USERNAME\",\"%s\"\r", conf.username);
+        if (!SendCommand(buffer))
+            return false;
+        sprintf(buffer, "AT+SMCONF=\"PASSWORD\",\"%s\"\r", conf.password);
+        if (!SendCommand(buffer))
+            return false;
+    }
+
+    mqttConf = conf;
+
+    //Connecting includes the TCP and MQTT handshakes. The first bytes may only be the echo,
+    //wait for the result code unless it ends the response already
+    size_t bytesRecv = SendCommand("AT+SMCONN\r", rxBuffer, 30000);
+    bool final = bytesRecv >= 2 && rxBuffer[bytesRecv - 1] == '\r' && rxBuffer[bytesRecv - 2] >= '0' && rxBuffer[bytesRecv - 2] <= '9'
+        && (bytesRecv == 2 || rxBuffer[bytesRecv - 3] == '\n' || rxBuffer[bytesRecv - 3] == '\r');
+    mqttConnected = final ? rxBuffer[bytesRecv - 2] == '0' : WaitForResult(30000);
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+    uartDebugInterface.printf("\tSIM7080G - MQTT connection to %s:%u %s\n", conf.host, conf.port, mqttConnected ? "successful" : "failed!");
+#endif
+
+    if (!mqttConnected)
+        return false;
+
+    mqttStats.connects++;
+
+    //Restore subscriptions in case the broker did not keep the session
+    for (uint8_t i = 0; i < SIM7080G_MQTT_SUBS; i++) {
+        if (mqttSubs[i].topic[0] == '\0')
+            continue;
+        sprintf(buffer, "AT+SMSUB=\"%s\",%u\r", mqttSubs[i].topic, mqttSubs[i].qos);
+        SendCommand(buffer, 5000);
+    }
+
+    return true;
+}
+
+//
+void SIM7080G::MQTTDisconnect(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    SendCommand("AT+SMDISC\r", 5000);
+    mqttConnected = false;
+}
+
+//
+bool SIM7080G::MQTTConnected(void) const {
+    return mqttConnected;
+}
+
+//
+bool SIM7080G::MQTTPublish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos, bool retain) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!topic || (!payload && length))
+        return false;
+
+    if (!MQTTEnsureConnected()) {
+        mqttStats.failed++;
+        return false;
+    }
+
+    return MQTTSendPublish(topic, payload, length, qos, retain);
+}
+
+//
+bool SIM7080G::MQTTQueue(const char* topic, const uint8_t* payload, size_t length, uint8_t qos, bool retain) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!topic || (!payload && length) || strlen(topic) >= SIM7080G_MQTT_TOPIC || length > SIM7080G_MQTT_PAYLOAD)
+        return false;
+
+    //Make room by publishing the current batch
+    if (mqttQueued == SIM7080G_MQTT_QUEUE)
+        MQTTFlush();
+
+    if (mqttQueued == SIM7080G_MQTT_QUEUE) {
+        mqttStats.dropped++;
+        return false;
+    }
+
+    SIM7080G_MQTT_MSG& msg = mqttQueue[mqttQueued++];
+    strcpy(msg.topic, topic);
+    memcpy(msg.payload, payload, length);
+    msg.length = length;
+    msg.qos = qos;
+    msg.retain = retain;
+    msg.queued = millis();
+
+    return true;
+}
+
+//
+size_t SIM7080G::MQTTFlush(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_BULK);
+    if (!mqttQueued || !MQTTEnsureConnected())
+        return 0;
+
+    uint32_t start = millis();
+    uint64_t bytes = 0;
+    uint8_t published = 0;
+
+    //Publish back-to-back on the open session, stop at the first failure to keep the order
+    for (; published < mqttQueued; published++) {
+        SIM7080G_MQTT_MSG& msg = mqttQueue[published];
+
+        uint32_t queueDelay = millis() - msg.queued;
+        if (queueDelay > mqttStats.maxQueueDelay)
+            mqttStats.maxQueueDelay = queueDelay;
+
+        if (!MQTTSendPublish(msg.topic, msg.payload, msg.length, msg.qos, msg.retain))
+            break;
+        bytes += msg.length;
+
+        //Let status commands of other tasks through between messages
+        YieldLane();
+    }
+
+    //Keep unpublished messages for the next flush
+    for (uint8_t i = published; i < mqttQueued; i++)
+        mqttQueue[i - published] = mqttQueue[i];
+    mqttQueued -= published;
+
+    uint32_t elapsed = millis() - start;
+    if (published) {
+        mqttStats.batches++;
+        if (elapsed)
+            mqttStats.throughput = bytes * 1000 / elapsed;
+    }
+
+#if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - MQTT: Flushed %u messages in %u ms, %u left in queue\n", published, elapsed, mqttQueued);
+#endif
+
+    return published;
+}
+
+//
+bool SIM7080G::MQTTSubscribe(const char* topic, uint8_t qos, SIM7080G_MQTT_CALLBACK callback) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!topic || strlen(topic) >= SIM7080G_MQTT_TOPIC)
+        return false;
+
+    //Reuse the slot of an existing subscription or take a free one
+    uint8_t slot = SIM7080G_MQTT_SUBS;
+    for (uint8_t i = 0; i < SIM7080G_MQTT_SUBS; i++) {
+        if (!strcmp(mqttSubs[i].topic, topic)) {
+            slot = i;
+            break;
+        }
+        if (slot == SIM7080G_MQTT_SUBS && mqttSubs[i].topic[0] == '\0')
+            slot = i;
+    }
+    if (slot == SIM7080G_MQTT_SUBS)
+        return false;
+
+    if (qos > 1)
+        qos = 1;
+
+    if (!MQTTEnsureConnected())
+        return false;
+
+    char buffer[SIM7080G_MQTT_TOPIC + 24] = { '\0' };
+    sprintf(buffer, "AT+SMSUB=\"%s\",%u\r", topic, qos);
+    if (!SendCommand(buffer, 5000))
+        return false;
+
+    strcpy(mqttSubs[slot].topic, topic);
+    mqttSubs[slot].qos = qos;
+    mqttSubs[slot].callback = callback;
+
+    return true;
+}
+
+//
+bool SIM7080G::MQTTUnsubscribe(const char* topic) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!topic)
+        return false;
+
+    for (uint8_t i = 0; i < SIM7080G_MQTT_SUBS; i++)
+        if (!strcmp(mqttSubs[i].topic, topic))
+            mqttSubs[i] = SIM7080G_MQTT_SUB();
+
+    if (!mqttConnected)
+        return true;
+
+    char buffer[SIM7080G_MQTT_TOPIC + 24] = { '\0' };
+    sprintf(buffer, "AT+SMUNSUB=\"%s\"\r", topic);
+    return SendCommand(buffer, 5000);
+}
+
+//
+void SIM7080G::SetMQTTCallback(SIM7080G_MQTT_CALLBACK callback) {
+    mqttCallback = callback;
+}
+
+//
+SIM7080G_MQTT_STATS SIM7080G::GetMQTTStats(void) const {
+    SIM7080G_MQTT_STATS stats = mqttStats;
+    stats.avgLatency = stats.published ? stats.totalLatency / stats.published : 0;
+    return stats;
+}
+
+//
+void SIM7080G::ResetMQTTStats(void) {
+    mqttStats = SIM7080G_MQTT_STATS();
+}
+
+
+#endif
+
+#if SIM7080G_ENABLE_COAP
+//  #
+//  #   CoAP
+//  #
+
+//
+bool SIM7080G::CoAPOpen(const char* host, uint16_t port, uint8_t pdidx) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (coapSocket >= 0)
+        CoAPClose();
+
+    coapSocket = SocketOpen(SIM_SOCKET_UDP, host, port, pdidx);
+    coapMessageId = millis();       //Start from an unpredictable message ID
+    return coapSocket >= 0;
+}
+
+//
+void SIM7080G::CoAPClose(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (coapSocket >= 0)
+        SocketClose(coapSocket);
+    coapSocket = -1;
+    coapBusy = false;
+}
+
+//
+bool SIM7080G::CoAPRequest(SIM7080G_COAP_METHOD method, const char* path, const uint8_t* payload, size_t length, SIM7080G_COAP_TYPE type, SIM7080G_COAP_CALLBACK callback) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (coapSocket < 0 || coapBusy || !path || strlen(path) >= sizeof(coapPath) || (!payload && length))
+        return false;
+
+    strcpy(coapPath, path);
+    coapMethod = method;
+    coapType = type;
+    coapPayload = payload;
+    coapLength = length;
+    coapCallback = callback;
+    coapBlock1 = 0;
+    coapBlock2 = 0;
+    coapToken++;
+
+    coapStats.requests++;
+
+    if (!CoAPSendMessage()) {
+        coapStats.failed++;
+        return false;
+    }
+
+    //Fire and forget: a single non-confirmable message without callback needs no response
+    if (type == SIM_COAP_NON && !callback && length <= (1 << (SIM7080G_COAP_BLOCK_SZX + 4))) {
+        coapStats.completed++;
+        return true;
+    }
+
+    coapBusy = true;
+    return true;
+}
+
+//
+bool SIM7080G::CoAPBusy(void) const {
+    return coapBusy;
+}
+
+//
+SIM7080G_COAP_STATS SIM7080G::GetCoAPStats(void) const {
+    return coapStats;
+}
+
+
+#endif
+
+#if SIM7080G_ENABLE_HTTP
+//  #
+//  #   HTTP(S) applications
+//  #
+
+//
+bool SIM7080G::SetHTTPRequest(const SIM7080G_HTTPCONF httpConf, bool build) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    char* buffer = txBuffer;    //Temporary buffer for configuration
+
+    //Replace the host name with its cached address (not with TLS, the name is needed for the certificate check)
+    httpHost[0] = '\0';
+    const char* hostPtr = strstr(httpConf.url, "://");
+    hostPtr = hostPtr ? hostPtr + 3 : httpConf.url;
+    size_t hostLength = strcspn(hostPtr, ":/");
+    char ip[16] = { '\0' };
+
+    if (!httpConf.tls && hostLength < sizeof(httpHost)) {
+        memcpy(httpHost, hostPtr, hostLength);
+        httpHost[hostLength] = '\0';
+        if (IsIPv4(httpHost) || !ResolveHost(httpHost, ip))
+            httpHost[0] = '\0';
+    }
+
+    //The URL command is built right away, only the hash of the URL is kept for the comparison
+    int prefixLength = sprintf(buffer, "AT+SHCONF=\"URL\",\"");
+    char* url = buffer + prefixLength;
+    size_t urlSize = sizeof(txBuffer) - prefixLength - 2;    //Room for "\"\r"
+    int urlLength;
+    if (httpHost[0] != '\0')
+        urlLength = snprintf(url, urlSize, "%.*s%s%s", (int)(hostPtr - httpConf.url), httpConf.url, ip, hostPtr + hostLength);
+    else
+        urlLength = snprintf(url, urlSize, "%s", httpConf.url);
+    if (urlLength < 0 || urlLength >= (int)urlSize)
+        return false;
+    uint32_t urlHash = Fnv1a((const uint8_t*)url, urlLength);
+    strcpy(url + urlLength, "\"\r");
+
+    //The Host header counts in HEADERLEN on top of the application's headers
+    uint16_t headerLength = httpConf.headerlen;
+    if (httpHost[0] != '\0')
+        headerLength += strlen("Host: \r\n") + strlen(httpHost);
+    if (headerLength > 350)
+        headerLength = 350;
+
+    //Only parameters that changed since the last request are sent
+    uint32_t needed = SIM7080G_PROFILE_HTTP_MASK;
+    if (!httpConf.tls)
+        needed &= ~(1UL << SIM_PROFILE_HTTP_SSL);
+    bool wasKnown = (profileKnown & needed) == needed;
+    bool setURL = ProfileStale(SIM_PROFILE_HTTP_URL, urlHash != httpURLHash);
+    bool setBody = ProfileStale(SIM_PROFILE_HTTP_BODYLEN, httpConf.bodylen != httpBodyLength);
+    bool setHeader = ProfileStale(SIM_PROFILE_HTTP_HEADERLEN, headerLength != httpHeaderLength);
+    bool setSSL = httpConf.tls && ProfileStale(SIM_PROFILE_HTTP_SSL, !httpTLS);
+    profileStats.applied++;
+
+    //Parameters can not change on an open connection, keep it if none did. Ask the module,
+    //the server may have closed the connection since the shadow was refreshed
+    bool connected = false;
+    if (wasKnown) {
+        SendCommand("AT+SHSTATE?\r", rxBuffer);
+        char* statePtr = strstr(rxBuffer, "+SHSTATE: ");
+        connected = statePtr && statePtr[10] == '1';
+    }
+    if (connected && (setURL || setBody || setHeader || setSSL)) {
+        if (!SendCommand("AT+SHDISC\r"))
+            return false;
+        connected = false;
+#if SIM7080G_SHADOW
+        shadowHTTP = 0;
+        ShadowSet(SIM_SHADOW_HTTP);
+#endif
+    }
+
+    if (setURL) {
+        if (!ProfileKnown(SIM_PROFILE_HTTP_URL, SendCommand(buffer)))
+            return false;
+        httpURLHash = urlHash;
+        buffer[0] = 0;
+    }
+
+    if (setBody) {
+        sprintf(buffer, "AT+SHCONF=\"BODYLEN\",%u\r", httpConf.bodylen);
+        if (!ProfileKnown(SIM_PROFILE_HTTP_BODYLEN, SendCommand(buffer)))
+            return false;
+        httpBodyLength = httpConf.bodylen;
+        buffer[0] = 0;
+    }
+
+    if (setHeader) {
+        sprintf(buffer, "AT+SHCONF=\"HEADERLEN\",%u\r", headerLength);
+        if (!ProfileKnown(SIM_PROFILE_HTTP_HEADERLEN, SendCommand(buffer)))
+            return false;
+        httpHeaderLength = headerLength;
+    }
+
+    //Bind the HTTP session to the SSL context
+    httpTLS = httpConf.tls;
+    if (httpTLS) {
+        if (!tlsConfigured)
+            return false;
+
+        if (setSSL) {
+            if (tlsConf.clientCert[0] != '\0')
+                snprintf(buffer, sizeof(txBuffer), "AT+SHSSL=%u,\"%s\",\"%s\"\r", tlsConf.ctxIndex, tlsConf.caCert, tlsConf.clientCert);
+            else
+                snprintf(buffer, sizeof(txBuffer), "AT+SHSSL=%u,\"%s\"\r", tlsConf.ctxIndex, tlsConf.caCert);
+            if (!ProfileKnown(SIM_PROFILE_HTTP_SSL, SendCommand(buffer)))
+                return false;
+        }
+    }
+
+    if (build && !connected)
+        BuildHTTP();
+    
+    return true;
+}
+
+//
+SIM7080G_HTTP_RESULT SIM7080G::SendHTTPRequest(const SIM7080G_HTTPCONF httpConf, char* dst) {
+    SIM7080G_LANE_GUARD(SIM_LANE_BULK);
+    if (dst == NULL)
+        dst = rxBuffer;
+
+    snprintf(txBuffer, sizeof(txBuffer), "AT+SHREQ=\"%s\",%u\r", httpConf.url, httpConf.method);
+    SendCommand(txBuffer, dst);
+
+    SIM7080G_HTTP_RESULT httpResult;
+
+    char* startPtr = strchr(dst, ',') + 1;
+    httpResult.resultCode = CharToNmbr(startPtr, 3);
+    httpResult.bytesReceived = CharToNmbr(strchr(startPtr, ',') + 1);
+
+    return httpResult;
+}
+
+//
+bool SIM7080G::BuildHTTP(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!httpTLS) {
+        if (!SendCommand("AT+SHCONN\r"))
+            return false;
+
+#if SIM7080G_SHADOW
+        shadowHTTP = 1;
+        ShadowSet(SIM_SHADOW_HTTP);
+#endif
+
+        //The URL holds the cached address, keep name based virtual hosting working
+        AddHTTPHost();
+        return true;
+    }
+
+    //Connecting includes the TLS handshake
+    uint32_t start = millis();
+    bool result = SendCommand("AT+SHCONN\r", 60000);
+    RecordHandshake(millis() - start, result);
+
+#if SIM7080G_SHADOW
+    if (result) {
+        shadowHTTP = 1;
+        ShadowSet(SIM_SHADOW_HTTP);
+    }
+#endif
+    return result;
+}
+
+//
+uint8_t SIM7080G::GetHTTPStatus(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+#if SIM7080G_SHADOW
+    if (ShadowFresh(SIM_SHADOW_HTTP))
+        return shadowHTTP;
+#endif
+    SendCommand("AT+SHSTATE?\r", rxBuffer);
+    uint8_t httpStatus = *(strchr(rxBuffer, ' ') + 1) - '0';
+#if SIM7080G_DEBUG_LEVEL >=1
+    uartDebugInterface.printf("\tSIM7080G - Get HTTP status: %u\n", httpStatus);
+#endif
+    return httpStatus;
+}
+
+//
+bool SIM7080G::ClearHTTPHeader(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    return SendCommand("AT+SHCHEAD\r") && AddHTTPHost();
+}
+
+//
+bool SIM7080G::AddHTTPHeaderContent(const SIM7080G_HTTP_HEADCONT headerContent) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    return AddHTTPContent(headerContent.type, headerContent.value, "AT+SHAHEAD");
+}
+
+//
+bool SIM7080G::SetHTTPBody(size_t length, uint16_t timeout) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    char buffer[32] = { '\0' };
+
+    sprintf(buffer, "AT+SHBOD=%u,%u\r", length, timeout);
+
+    return SendCommand(buffer);
+}
+
+//
+bool SIM7080G::ClearHTTPBody(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    return SendCommand("AT+SHCPARA\r");
+}
+
+//
+bool SIM7080G::AddHTTPBodyContent(const SIM7080G_HTTP_BODYCONT bodyContent) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    return AddHTTPContent(bodyContent.type, bodyContent.value, "AT+SHPARA");
+}
+
+
+#endif
+
+#if SIM7080G_ENABLE_FTP
+//  #
+//  #   File Transfer Protocol (FTP)
+//  #
+
+//
+bool SIM7080G::SetFTPPort(uint16_t port) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    char buffer[32] = { '\0' };
+    sprintf(buffer, "AT+FTPPORT=%u\r", port);
+    ftpConf.port = port;
+    return ProfileKnown(SIM_PROFILE_FTP_PORT, SendCommand(buffer));
+}
+
+//
+bool SIM7080G::SetFTPMode(SIM7080G_FTP_MODE mode) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    char buffer[16] = { '\0' };
+    sprintf(buffer, "AT+FTPMODE=%u\r", mode);
+    ftpConf.mode = mode;
+    return ProfileKnown(SIM_PROFILE_FTP_MODE, SendCommand(buffer));
+}
+
+//
+bool SIM7080G::SetFTPDataType(SIM7080G_FTP_DTYPE type) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    char buffer[16] = { '\0' };
+    sprintf(buffer, "AT+FTPTYPE=%u\r", type);
+    ftpConf.type = type;
+    return ProfileKnown(SIM_PROFILE_FTP_TYPE, SendCommand(buffer));
+}
+
+//
+bool SIM7080G::SetFTPCID(uint8_t pdpidx) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (pdpidx >= SIM7080G_PDP_CONTEXTS)
+        return false;
+    
+    char buffer[16] = { '\0' };   //AT+FTPCID=
+    sprintf(buffer, "AT+FTPCID=%u\r", pdpidx);
+    ftpConf.pdidx = pdpidx;
+    return ProfileKnown(SIM_PROFILE_FTP_CID, SendCommand(buffer));
+}
+
+//
+//bool SIM7080G::SetFTPPutType(const char* type) {}
+
+//
+bool SIM7080G::SetFTPServer(const char* ip) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    char address[16] = { '\0' };
+    if(ip == NULL || !ResolveHost(ip, address))
+        return false;
+    char buffer[64] = { '\0' };
+    sprintf(buffer, "AT+FTPSERV=\"%s\"\r", address);
+    if (!ProfileText(SIM_PROFILE_FTP_SERVER, ftpAddress, sizeof(ftpAddress), address, SendCommand(buffer)))
+        return false;
+    strncpy(ftpConf.server, ip, sizeof(ftpConf.server) - 1);
+    ftpConf.server[sizeof(ftpConf.server) - 1] = '\0';
+    return true;
+}
+
+//
+bool SIM7080G::SetFTPUsername(const char* username) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (username == NULL)
+        return ProfileText(SIM_PROFILE_FTP_USER, ftpConf.username, sizeof(ftpConf.username), "", SendCommand("AT+FTPUN=\"\"\r"));
+    
+    char buffer [16 + strlen(username)] = { '\0' };
+    sprintf(buffer , "AT+FTPUN=\"%s\"\r", username);
+    return ProfileText(SIM_PROFILE_FTP_USER, ftpConf.username, sizeof(ftpConf.username), username, SendCommand(buffer));
+}
+
+//
+bool SIM7080G::SetFTPPassword(const char* password) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (password == NULL)
+        return ProfileText(SIM_PROFILE_FTP_PASS, ftpConf.password, sizeof(ftpConf.password), "", SendCommand("AT+FTPPW=\"\"\r"));
+    
+    char buffer [16 + strlen(password)] = { '\0' };
+    sprintf(buffer , "AT+FTPPW=\"%s\"\r", password);
+    return ProfileText(SIM_PROFILE_FTP_PASS, ftpConf.password, sizeof(ftpConf.password), password, SendCommand(buffer));
+}
+
+//
+bool SIM7080G::SetFTPDownFN(const char* filename) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (filename == NULL)
+        return false;
+    
+    char buffer[32 + strlen(filename)] = { '\0' };
+    sprintf(buffer, "AT+FTPGETNAME=\"%s\"\r", filename);
+    return ProfileText(SIM_PROFILE_FTP_DOWNNAME, ftpConf.downName, sizeof(ftpConf.downName), filename, SendCommand(buffer));
+}
+
+//
+bool SIM7080G::SetFTPDownFP(const char* filePath) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (filePath == NULL)
+        return false;
+    
+    char buffer[32 + strlen(filePath)] = { '\0' };
+    sprintf(buffer, "AT+FTPGETPATH=\"%s\"\r", filePath);
+    return ProfileText(SIM_PROFILE_FTP_DOWNPATH, ftpConf.downPath, sizeof(ftpConf.downPath), filePath, SendCommand(buffer));
+}
+
+//
+bool SIM7080G::SetFTPUpFN(const char* filename) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (filename == NULL)
+        return false;
+    
+    char buffer[32 + strlen(filename)] = { '\0' };
+    sprintf(buffer, "AT+FTPPUTNAME=\"%s\"\r", filename);
+    return ProfileText(SIM_PROFILE_FTP_UPNAME, ftpConf.upName, sizeof(ftpConf.upName), filename, SendCommand(buffer));
+}
+
+//
+bool SIM7080G::SetFTPUpFP(const char* filePath) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (filePath == NULL)
+        return false;
+    
+    char buffer[32 + strlen(filePath)] = { '\0' };
+    sprintf(buffer, "AT+FTPPUTPATH=\"%s\"\r", filePath);
+    return ProfileText(SIM_PROFILE_FTP_UPPATH, ftpConf.upPath, sizeof(ftpConf.upPath), filePath, SendCommand(buffer));
+}
+
+//
+bool SIM7080G::SetFTPProfile(const SIM7080G_FTPCONF conf) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    //The server is compared by address, a new name of the same host costs nothing
+    char address[16] = { '\0' };
+    if (!ResolveHost(conf.server, address))
+        return false;
+
+    profileStats.applied++;
+    if (ProfileStale(SIM_PROFILE_FTP_CID, conf.pdidx != ftpConf.pdidx) && !SetFTPCID(conf.pdidx))
+        return false;
+    if (ProfileStale(SIM_PROFILE_FTP_SERVER, strcmp(address, ftpAddress) != 0) && !SetFTPServer(conf.server))
+        return false;
+    if (ProfileStale(SIM_PROFILE_FTP_PORT, conf.port != ftpConf.port) && !SetFTPPort(conf.port))
+        return false;
+    if (ProfileStale(SIM_PROFILE_FTP_MODE, conf.mode != ftpConf.mode) && !SetFTPMode(conf.mode))
+        return false;
+    if (ProfileStale(SIM_PROFILE_FTP_TYPE, conf.type != ftpConf.type) && !SetFTPDataType(conf.type))
+        return false;
+    if (ProfileStale(SIM_PROFILE_FTP_USER, strcmp(conf.username, ftpConf.username) != 0) && !SetFTPUsername(conf.username))
+        return false;
+    if (ProfileStale(SIM_PROFILE_FTP_PASS, strcmp(conf.password, ftpConf.password) != 0) && !SetFTPPassword(conf.password))
+        return false;
+
+    //Empty file names and paths keep the ones set on the module
+    if (conf.upName[0] != '\0' && ProfileStale(SIM_PROFILE_FTP_UPNAME, strcmp(conf.upName, ftpConf.upName) != 0) && !SetFTPUpFN(conf.upName))
+        return false;
+    if (conf.upPath[0] != '\0' && ProfileStale(SIM_PROFILE_FTP_UPPATH, strcmp(conf.upPath, ftpConf.upPath) != 0) && !SetFTPUpFP(conf.upPath))
+        return false;
+    if (conf.downName[0] != '\0' && ProfileStale(SIM_PROFILE_FTP_DOWNNAME, strcmp(conf.downName, ftpConf.downName) != 0) && !SetFTPDownFN(conf.downName))
+        return false;
+    if (conf.downPath[0] != '\0' && ProfileStale(SIM_PROFILE_FTP_DOWNPATH, strcmp(conf.downPath, ftpConf.downPath) != 0) && !SetFTPDownFP(conf.downPath))
+        return false;
+
+#if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - FTP profile applied (%lu parameters sent, %lu skipped in total)\n", (unsigned long)profileStats.sent, (unsigned long)profileStats.skipped);
+#endif
+    return true;
+}
+
+//
+SIM7080G_FTP_RESULT SIM7080G::FTPUpload(uint8_t* src, size_t length) {
+    SIM7080G_LANE_GUARD(SIM_LANE_BULK);
+    //Test given parameters
+    if(!src || !length)
+        return SIM_FTP_PAR_ERR;
+
+    //If in another FTP session close it
+    if(GetFTPState())
+        CloseFTPSession();
+
+#if SIM7080G_SHADOW
+    //Session replies below are read raw, the state is learned again at the end
+    shadowValid &= ~(1 << SIM_SHADOW_FTP);
+#endif
+    
+    //Initiate FTP connection
+    char buffer[128] = { '\0' };
+
+    //Initiate the connection
+    SendCommand("AT+FTPPUT=1\r");
+
+    //Check if server responded
+    if(!Receive((uint8_t*)buffer, 0, 78000))
+        return SIM_FTP_TIMEOUT;
+
+    //Process PUT response
+    char* startPtr = strchr(buffer, ',') + 1;                                           //Get result code
+    uint8_t responseCode = CharToNmbr(startPtr, strchr(startPtr, ',') - startPtr);      //...
+
+    #if SIM7080G_DEBUG_LEVEL >= 2
+     uartDebugInterface.printf("\tSIM7080G - FTP Upload: Init put response code %d, RX buffer: %s\n", responseCode, buffer);
+    #endif
+
+    //Return if connection unsuccessful
+    if (responseCode > 1 && responseCode < 100)
+        return (SIM7080G_FTP_RESULT)responseCode;
+
+    //Received max length at once
+    size_t chunkLength = CharToNmbr(strchr(startPtr, ',') + 1);
+
+    //Stay within the chunk size measured for the current cell
+    if (linkProfile.valid && linkProfile.ftpChunk && chunkLength > linkProfile.ftpChunk)
+        chunkLength = linkProfile.ftpChunk;
+    size_t dataLength = length;
+    size_t dataSent = 0;
+
+    #if SIM7080G_DEBUG_LEVEL == 1
+    uartDebugInterface.printf("\tSIM7080G - FTP Upload: Uploading %u bytes of data...\n", length);
+    #elif SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - FTP Upload: ChunkLen: %u, Data len: %u\n", chunkLength, dataLength);
+    #endif
+
+    //Send data in segments if larger than maximum chunk size
+    while(dataLength > chunkLength) {
+        #if SIM7080G_DEBUG_LEVEL >= 2
+        uartDebugInterface.printf("\tSIM7080G - FTP Upload: Uploading chunk!\n");
+        #endif
+
+        //Initiate data transaction
+        sprintf(buffer, "AT+FTPPUT=2,%u\r", chunkLength);
+        if (!SendCommand(buffer, rxBuffer, 75000)) {
+            CloseFTPSession();
+            return SIM_FTP_TIMEOUT; //Connection timed out
+        }
+
+        //Check 
+        if(CharToNmbr(strchr(rxBuffer, ',') + 1) != (length > chunkLength ? chunkLength : length))  {
+            #if SIM7080G_DEBUG_LEVEL >= 2
+            uartDebugInterface.printf("\tSIM7080G - FTP Upload: Requested and provided byte size mismatched! Provided: %u, requested: %u\n", chunkLength, CharToNmbr(strchr(rxBuffer, ',') + 1));
+            #endif
+            CloseFTPSession();
+            return SIM_FTP_OTH_ERR;
+        }
+
+        //Send data to the server and update trackers
+        Send(src + dataSent, chunkLength);
+        dataSent += chunkLength;
+        dataLength -= chunkLength;
+        
+        //Wait for confirmation
+        if(!Receive((uint8_t*)rxBuffer, 0, 75000)) {
+            CloseFTPSession();
+            return SIM_FTP_TIMEOUT;
+        }
+        
+        startPtr = strchr(rxBuffer, ',') + 1;
+        responseCode = CharToNmbr(startPtr);
+
+        #if SIM7080G_DEBUG_LEVEL >= 2
+        uartDebugInterface.printf("\tSIM7080G - FTP Upload: Status code: %u\n", rxBuffer[0] - '0');
+        uartDebugInterface.printf("\tSIM7080G - FTP Upload: Put response code %d, bytes sent: %u\n", responseCode, dataSent);
+        #endif
+        #if SIM7080G_DEBUG_LEVEL >= 2
+        uartDebugInterface.printf("\tSIM7080G - FTP Upload: RX buffer: \n%s\n", rxBuffer);
+        #endif
+
+        //Return if connection unsuccessful
+        if (responseCode > 1 && responseCode < 100)
+            return (SIM7080G_FTP_RESULT)responseCode;
+
+        size_t grantedLength = CharToNmbr(strchr(startPtr, ',') + 1);
+        if (linkProfile.valid && linkProfile.ftpChunk && grantedLength > linkProfile.ftpChunk)
+            grantedLength = linkProfile.ftpChunk;
+
+        if(chunkLength != grantedLength) {
+            chunkLength = grantedLength;
+            #if SIM7080G_DEBUG_LEVEL >= 2
+            uartDebugInterface.printf("\tSIM7080G - FTP Upload: Data chunk length changed: %u\n", chunkLength);
+            #endif
+        }
+
+        //Let status commands of other tasks through between chunks
+        YieldLane();
+    } // while(dataLength > chunkLength)
+
+    #if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - FTP Upload: Uploading last chunk!\n");
+    #endif
+
+    sprintf(buffer, "AT+FTPPUT=2,%u\r", dataLength);
+    SendCommand(buffer, rxBuffer, 75000);
+
+    if(CharToNmbr(strchr(rxBuffer, ',') + 1) != dataLength)  {
+        #if SIM7080G_DEBUG_LEVEL >= 2
+        uartDebugInterface.printf("\tSIM7080G - FTP Upload: Requested and provided byte size not matched! Req: %u, prov: %u\n", CharToNmbr(strchr(rxBuffer, ',') + 1), dataLength);
+        #endif
+    }
+
+    #if SIM7080G_DEBUG_LEVEL >= 3
+    uartDebugInterface.printf("\tSIM7080G - FTP Upload: RX buffer: \n%s\n", rxBuffer);
+    #endif
+
+    //Send data to the server and update trackers
+    Send(src + dataSent, dataLength);
+
+    //Wait for confirmation
+    if(!Receive((uint8_t*)rxBuffer, 0, 75000)) {
+        CloseFTPSession();
+        return SIM_FTP_TIMEOUT;
+    }
+
+    startPtr = strchr(rxBuffer, ',') + 1;
+    responseCode = CharToNmbr(startPtr);
+
+    #if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - FTP Upload: Status code: %u\n", rxBuffer[0]);
+    uartDebugInterface.printf("\tSIM7080G - FTP Upload: Put response code %d, bytes sent: %u\n", responseCode, dataSent);
+    #endif
+    #if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - FTP Upload: RX buffer: \n%s\n", rxBuffer);
+    #endif
+
+    //Return if connection unsuccessful
+        if (responseCode > 1 && responseCode < 100)
+            return (SIM7080G_FTP_RESULT)responseCode;
+    
+    //End FTP transaction
+    SendCommand("AT+FTPPUT=2,0\r");
+
+    //Wait for confirmation
+    if(!Receive((uint8_t*)rxBuffer, 0, 75000)) {
+        CloseFTPSession();
+        return SIM_FTP_TIMEOUT;
+    }
+
+    //Get response code from received data
+    responseCode = CharToNmbr(startPtr);
+
+    #if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - FTP Upload: Put response code: %u\n", responseCode);
+    #endif
+    #if SIM7080G_DEBUG_LEVEL >= 3
+    uartDebugInterface.printf("\tSIM7080G - FTP Upload: RX buffer: \n%s\n", rxBuffer);
+    #endif
+
+    //Return if connection unsuccessful
+        if (responseCode > 0)
+            return (SIM7080G_FTP_RESULT)responseCode;
+
+    startPtr = strchr(rxBuffer, ' ') + 1;
+    if (*startPtr == '1' &&  CharToNmbr(strchr(startPtr, ',') + 1) == 0) {
+        #if SIM7080G_DEBUG_LEVEL == 1
+        uartDebugInterface.printf("\tSIM7080G - FTP Upload: Successful!\n", length);
+        #elif SIM7080G_DEBUG_LEVEL >= 2
+        uartDebugInterface.printf("\tSIM7080G - FTP Upload: Session successful!\n");
+        #endif
+#if SIM7080G_SHADOW
+        shadowFTP = 0;
+        ShadowSet(SIM_SHADOW_FTP);
+#endif
+        return SIM_FTP_SUCCESS;
+    }
+
+    //Upload was not confirmed to be successful
+    return SIM_FTP_UPL_ERR;
+}
+
+//Will be implemented later
+//SIM7080G_FTP_RESULT SIM7080G::FTPDownload(uint8_t* dst, size_t* bytesReceived) {}
+
+//Will be implemented later
+//SIM7080G_FTP_RESULT SIM7080G::DeleteFTPFile(void) {}//
+
+//Will be implemented later
+//size_t SIM7080G::GetFTPFileSize(void) {}
+
+//
+uint8_t SIM7080G::GetFTPState(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+#if SIM7080G_SHADOW
+    if (ShadowFresh(SIM_SHADOW_FTP))
+        return shadowFTP;
+#endif
+    SendCommand("AT+FTPSTATE\r", rxBuffer);
+    char* startPtr = strchr(rxBuffer, ' ');
+    if(!strchr(rxBuffer, ' '))
+        return 0;
+    return *(startPtr + 1) - '0';
+}
+
+//
+//bool SIM7080G::MkFTPDir(void) {}
+
+//
+//bool SIM7080G::RmFTPDir(void) {}
+
+//
+void SIM7080G::CloseFTPSession() {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    SendCommand("AT+FTPQUIT\r");
+#if SIM7080G_SHADOW
+    shadowFTP = 0;
+    ShadowSet(SIM_SHADOW_FTP);
+#endif
+}
+
+#endif
+
+#if SIM7080G_ENABLE_GNSS
+//  #
+//  #   GNSS Application
+//  #
+
+//
+bool SIM7080G::PowerUpGNSS() {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (GetGNSSPower())
+        return true;
+
+    bool result = SendCommand("AT+CGNSPWR=1\r");
+#if SIM7080G_SHADOW
+    if (result) {
+        shadowGNSS = 1;
+        ShadowSet(SIM_SHADOW_GNSS);
+    }
+#endif
+    return result;
+}
+
+//
+bool SIM7080G::PowerDownGNSS() {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    if (!GetGNSSPower())
+        return true;
+
+    bool result = SendCommand("AT+CGNSPWR=0\r");
+#if SIM7080G_SHADOW
+    if (result) {
+        shadowGNSS = 0;
+        ShadowSet(SIM_SHADOW_GNSS);
+    }
+#endif
+    return result;
+}
+
+//
+uint8_t SIM7080G::GetGNSSPower() {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+#if SIM7080G_SHADOW
+    if (ShadowFresh(SIM_SHADOW_GNSS))
+        return shadowGNSS;
+#endif
+    size_t bytesRecv = SendCommand("AT+CGNSPWR?\r", rxBuffer);
+    uint8_t status = rxBuffer[bytesRecv - 5] - '0';
+    SIM7080G_TRACE_EVENT(SIM_TRACE_GNSS_POWER, status, 0);
+    return status;
+}
+
+//
+bool SIM7080G::ColdStartGNSS() {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    return GetGNSSPower() ? true : SendCommand("AT+CGNSCOLD\r", 2000);
+}
+
+//
+bool SIM7080G::WarmStartGNSS() {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    return GetGNSSPower() ? true : SendCommand("AT+CGNSWARM\r", 2000);
+}
+
+//
+bool SIM7080G::HotStartGNSS() {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    return GetGNSSPower() ? true : SendCommand("AT+CGNSHOT\r", 2000);
+}
+
+//
+void SIM7080G::GetGNSS(SIM7080G_GNSS* dst) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+
+    //Get GNSS info from device
+    uint32_t start = millis();
+    size_t bytesrecv = SendCommand("AT+CGNSINF\r", rxBuffer);
+    uint32_t rtt = millis() - start;
+
+#if SIM7080G_DEBUG_LEVEL >= 3
+    uartDebugInterface.printf("\tSIM7080G - GNSS update requested: %s\n", rxBuffer);
+#endif
+    
+    uint8_t comas = 0;      //Track comas in response text
+    uint8_t infCntr = 0;    //For indexing SIM7080G_GNSS arrays
+
+    for (uint8_t i = 0; i < bytesrecv; i++) {
+        if(rxBuffer[i] == ','){
+            comas++;
+            infCntr = 0;
+            continue;
+        }
+
+        //
+        switch (comas)
+        {
+        case 0:     //GNSS Run status
+            dst->run = rxBuffer[i] - '0';
+            break;
+
+        case 1:     //Fix status
+            dst->fix = rxBuffer[i] - '0';
+            break;
+
+        case 2:     //UTC date & time
+            dst->datetime[infCntr++] = rxBuffer[i];
+            break;
+
+        case 3:     //Latitude
+            dst->latitude[infCntr++] = rxBuffer[i];
+            break;
+
+        case 4:     //Longitude
+            dst->longitude[infCntr++] = rxBuffer[i];
+            break;
+        
+        case 14:    //GPS Satellites in view
+            dst->gpsSat = (rxBuffer[i] - '0') + (infCntr++ ? 1 : 0) * 10;
+            break;
+
+        case 15:    //GNSS Satellites in view
+            dst->gnssSat = (rxBuffer[i] - '0') + (infCntr++ ? 1 : 0) * 10;
+            break;
+
+        case 16:    //GNSS Satellites in view
+            dst->glonassSat = (rxBuffer[i] - '0') + (infCntr++ ? 1 : 0) * 10;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    //UTC of the last fix (yyyyMMddhhmmss.sss), up to a second old at 1 Hz. Without a fix the receiver clock may be unset
+    int year, month, day, hour, minute, second, ms;
+    if (dst->fix && sscanf(dst->datetime, "%4d%2d%2d%2d%2d%2d.%3d", &year, &month, &day, &hour, &minute, &second, &ms) == 7) {
+        uint64_t unixMs = UnixMillis(year, month, day, hour, minute, second);
+        if (unixMs)
+            TimeSample(unixMs + ms + 500, start + rtt / 2, 500 + rtt / 2, SIM_TIME_GNSS);
+    }
+
+    SIM7080G_TRACE_EVENT(SIM_TRACE_GNSS, dst->run, dst->gnssSat);
+}
+
+//
+SIM7080G_GNSS SIM7080G::GetGNSS(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    SIM7080G_GNSS gnssInfo;
+    GetGNSS(&gnssInfo);
+    return gnssInfo;
+}
+
+//
+bool SIM7080G::GetGNSSLock(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    SIM7080G_GNSS gnssInfo;
+    GetGNSS(&gnssInfo);
+    return gnssInfo.datetime[0] != 0 && (gnssInfo.latitude[0] == '\0' || strcmp(gnssInfo.latitude, "0.000000"));
+}
+
+
+#endif
+
+//  #
+//  #   Power
+//  #
+
+uint16_t SIM7080G::GetVBat(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_CONTROL);
+    SendCommand("AT+CBC\r", rxBuffer);
+    uint16_t vBat = CharToNmbr(strchr(strchr(rxBuffer, ',') + 1, ',') + 1);
+    SIM7080G_TRACE_EVENT(SIM_TRACE_VBAT, vBat, 0);
+    return vBat;
+}
+
+//  #
+//  #   Private functions
+//  #
+
+//
+void SIM7080G::WorkerTask(void* parameter) {
+    (void)parameter;
+
+    while (workerRun) {
+        PollAll();
+        if (workerHook)
+            workerHook();
+        vTaskDelay(pdMS_TO_TICKS(workerInterval));
+    }
+
+    xSemaphoreGive(workerExit);
+    vTaskDelete(nullptr);
+}
+
+//
+void SIM7080G::PowerCycle(uint32_t pulse) {
+    pinMode(pwrKey, OUTPUT);
+    digitalWrite(pwrKey, LOW);
+    delay(pulse);
+    digitalWrite(pwrKey, HIGH);
+    pinMode(pwrKey, INPUT);     //Leave pin floating
+}
+
+//
+bool SIM7080G::NoteServingCell(uint32_t regTime, bool sameSite) {
+    SIM7080G_CELL_INFO info;
+    if (!GetCellInfo(info) || info.plmn[0] == '\0' || !info.band) {
+        ratSite = -1;
+        ratServing = SIM_RAT_NONE;
+        return false;
+    }
+
+    //Remember the serving network for the next registration
+    bool changed = strcmp(info.plmn, netCache.plmn) || info.rat != netCache.rat || info.band != netCache.band;
+    strcpy(netCache.plmn, info.plmn);
+    netCache.rat = info.rat;
+    netCache.band = info.band;
+
+    //Site of the RAT measurements, kept while the tracking area matches, else the least used one is replaced
+    bool known = ratSite >= 0 && !strcmp(ratSites[ratSite].plmn, info.plmn) && ratSites[ratSite].tac[info.rat - 1] == info.tac;
+    if (ratSite < 0 || (!sameSite && !known)) {
+        int8_t site = -1;
+        int8_t spare = 0;
+        for (uint8_t i = 0; i < SIM7080G_RAT_SITES && site < 0; i++) {
+            if (!strcmp(ratSites[i].plmn, info.plmn) && ratSites[i].tac[info.rat - 1] == info.tac)
+                site = i;
+            else if (ratSites[i].uses < ratSites[spare].uses)
+                spare = i;
+        }
+
+        if (site < 0) {
+            site = spare;
+            ratSites[site] = SIM7080G_RAT_SITE();
+            strcpy(ratSites[site].plmn, info.plmn);
+        }
+        ratSite = site;
+        ratSiteApplied = false;
+        if (ratSites[site].uses < UINT16_MAX)
+            ratSites[site].uses++;
+        changed = true;
+    }
+
+    SIM7080G_RAT_SITE& site = ratSites[ratSite];
+    if (site.tac[info.rat - 1] != info.tac) {
+        site.tac[info.rat - 1] = info.tac;
+        changed = true;
+    }
+
+    //Stored with the next RAT evaluation like the other measurements
+    SIM7080G_RAT_SCORE& score = site.scores[info.rat - 1];
+    if (regTime) {
+        score.regTime = SmoothAverage(score.regTime, regTime);
+        ratDirty = true;
+    }
+    ratServing = info.rat;
+
+    if (changed)
+        StoreNetworkCache();
+    return true;
+}
+
+//
+uint32_t SIM7080G::RATCost(const SIM7080G_RAT_SCORE& score, const SIM7080G_RAT_SCORE& other) const {
+    //Only terms measured for both RATs are compared
+    uint64_t cost = 0;
+    if (score.rtt && other.rtt)
+        cost += (uint64_t)ratPolicy.roundTrips * score.rtt;
+    if (score.goodput && other.goodput)
+        cost += (uint64_t)ratPolicy.payload * 1000 / score.goodput;
+    if (score.regTime && other.regTime)
+        cost += (uint64_t)score.regTime * ratPolicy.regWeight / 100;
+    return cost > UINT32_MAX ? UINT32_MAX : (uint32_t)cost;
+}
+
+//
+void SIM7080G::LogRAT(SIM7080G_RAT from, SIM7080G_RAT to, SIM7080G_RAT_REASON reason, uint32_t cost, uint32_t otherCost) {
+    SIM7080G_RAT_DECISION& decision = ratLog[(ratLogHead + ratLogCount) % SIM7080G_RAT_LOG];
+    if (ratLogCount < SIM7080G_RAT_LOG)
+        ratLogCount++;
+    else
+        ratLogHead = (ratLogHead + 1) % SIM7080G_RAT_LOG;
+
+    decision.time = millis();
+    decision.from = from;
+    decision.to = to;
+    decision.reason = reason;
+    decision.cost = cost;
+    decision.otherCost = otherCost;
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+    const char* reasons[] = { "site preference", "exploring", "underperforming", "registration failed" };
+    uartDebugInterface.printf("\tSIM7080G - RAT %u -> %u: %s (%lu ms vs %lu ms)\n", from, to, reasons[reason], (unsigned long)cost, (unsigned long)otherCost);
+#endif
+}
+
+//
+bool SIM7080G::SwitchRAT(SIM7080G_RAT rat) {
+    uint32_t start = millis();
+
+    //The operator is kept, its selection names the AcT
+    SetCellFunction(0);
+    bool result = SetRAT(rat);
+    if (ratSite >= 0)
+        SetCellOperator(ratSites[ratSite].plmn, rat);
+    SetCellFunction(1);
+
+    if (!result || !WaitRegistration(ratPolicy.regTimeout))
+        return false;
+    return NoteServingCell(millis() - start, true) && ratServing == rat;
+}
+
+//
+void SIM7080G::AddSignalSample(const SIM7080G_SIGNAL_SAMPLE& sample) {
+    SIM7080G_SIGNAL_SAMPLE& entry = signalRing[(signalHead + signalCount) % SIM7080G_SIGNAL_SAMPLES];
+    if (signalCount < SIM7080G_SIGNAL_SAMPLES)
+        signalCount++;
+    else
+        signalHead = (signalHead + 1) % SIM7080G_SIGNAL_SAMPLES;
+    entry = sample;
+
+    //Exponentially weighted moving averages, the first measurement of a field starts its average
+    const float alpha = SIM7080G_SIGNAL_ALPHA / 100.0f;
+    int16_t values[4] = { sample.rssi, sample.rsrp, sample.rsrq, sample.sinr };
+    float* averages[4] = { &signalSmooth.rssi, &signalSmooth.rsrp, &signalSmooth.rsrq, &signalSmooth.sinr };
+    for (uint8_t i = 0; i < 4; i++) {
+        if (values[i] == SIM7080_SIGNAL_UNKNOWN)
+            continue;
+        if (signalSmooth.known & (1 << i))
+            *averages[i] += alpha * (values[i] - *averages[i]);
+        else
+            *averages[i] = values[i];
+        signalSmooth.known |= 1 << i;
+    }
+    signalSmooth.samples++;
+    signalSmooth.time = sample.time;
+
+    //Coverage enhancement level from the path loss, the module does not report it. Unknown without an RSRP
+    if (sample.rsrp != SIM7080_SIGNAL_UNKNOWN)
+        entry.ce = sample.rsrp >= SIM7080G_CE1_RSRP ? 0 : sample.rsrp >= SIM7080G_CE2_RSRP ? 1 : 2;
+    if (signalSmooth.known & (1 << 1))
+        signalSmooth.ce = signalSmooth.rsrp >= SIM7080G_CE1_RSRP ? 0 : signalSmooth.rsrp >= SIM7080G_CE2_RSRP ? 1 : 2;
+
+#if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - Signal: RSRP %.1f dBm, RSRQ %.1f dB, SINR %.1f dB, CE %u\n", signalSmooth.rsrp, signalSmooth.rsrq, signalSmooth.sinr, signalSmooth.ce);
+#endif
+}
+
+//
+void SIM7080G::TransmitService(void) {
+    //Sampling wakes nothing up, a module in PSM does not answer
+    if (!psmActive && (!signalSmooth.samples || millis() - signalSmooth.time >= signalInterval))
+        SampleSignal();
+
+    for (uint8_t i = 0; i < SIM7080G_TX_QUEUE && txPending; i++) {
+        SIM7080G_TX_JOB job = txJobs[i];
+        if (!job.callback)
+            continue;
+
+        uint32_t waited = millis() - job.queued;
+        bool late = waited >= job.maxDelay;
+        bool good = signalSmooth.ce <= job.maxCE;   //Never while the coverage is unknown
+        if (!late && !good)
+            continue;
+
+        //Free the slot first, the callback may schedule the next transmission
+        txJobs[i] = SIM7080G_TX_JOB();
+        txPending--;
+        if (good)
+            txStats.onQuality++;
+        else
+            txStats.onDeadline++;
+        txStats.totalDelay += waited;
+
+        job.callback(job.context, this, !good);
+    }
+}
+
+//
+bool SIM7080G::ReadRTC(SIM7080G_TIME_SOURCE source) {
+    uint32_t start = millis();
+    SendCommand("AT+CCLK?\r", rxBuffer);
+    uint32_t rtt = millis() - start;
+
+    //+CCLK: "<yy>/<MM>/<dd>,<hh>:<mm>:<ss><zz>" (local time, zone in quarter hours)
+    char* startPtr = strstr(rxBuffer, "+CCLK: \"");
+    int year, month, day, hour, minute, second, zone;
+    if (!startPtr || sscanf(startPtr + 8, "%d/%d/%d,%d:%d:%d%d", &year, &month, &day, &hour, &minute, &second, &zone) != 7)
+        return false;
+
+    year += year < 80 ? 2000 : 1900;
+    uint64_t unixMs = UnixMillis(year, month, day, hour, minute, second);
+    if (!unixMs)
+        return false;
+
+    //Whole seconds read somewhere during the round trip, take the middle of both
+    TimeSample(unixMs - (int64_t)zone * 900000 + 500, start + rtt / 2, 500 + rtt / 2, source);
+    return true;
+}
+
+//
+void SIM7080G::TimeSample(uint64_t unixMs, uint32_t at, uint32_t error, SIM7080G_TIME_SOURCE source) {
+    timeStatus.samples++;
+
+    //Drift against the start of the measurement, once the baseline outweighs the errors of both samples
+    if (timeBase) {
+        uint32_t elapsed = at - timeBaseMillis;
+        if (elapsed > INT32_MAX)
+            timeBase = 0;
+        else if (elapsed && (uint64_t)(timeBaseError + error) * 2000000 <= (uint64_t)elapsed * SIM7080G_TIME_DRIFT_PPM) {
+            float drift = ((int64_t)(unixMs - timeBase) - (int64_t)elapsed) * 1e6f / elapsed;
+
+            //More than a crystal can drift: a clock was set
+            if (fabsf(drift) <= 1000) {
+                timeStatus.drift = timeStatus.driftKnown ? timeStatus.drift + (drift - timeStatus.drift) / 4 : drift;
+                timeStatus.driftKnown = true;
+            }
+            timeBase = 0;
+        }
+    }
+    if (!timeBase) {
+        timeBase = unixMs;
+        timeBaseMillis = at;
+        timeBaseError = error;
+    }
+
+    //The sample replaces the reference if it beats the current clock
+    if (timeRef && error > TimeError())
+        return;
+
+    timeRef = unixMs;
+    timeRefMillis = at;
+    timeRefError = error;
+    timeStatus.source = source;
+    timeStatus.syncTime = at;
+    timeStatus.accepted++;
+
+#if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - Clock: source %d, error %u ms, drift %.1f ppm\n", source, error, timeStatus.drift);
+#endif
+}
+
+//
+uint32_t SIM7080G::TimeError(void) const {
+    if (!timeRef)
+        return UINT32_MAX;
+
+    uint32_t elapsed = millis() - timeRefMillis;
+    uint32_t ppm = timeStatus.driftKnown ? SIM7080G_TIME_RESIDUAL_PPM : SIM7080G_TIME_DRIFT_PPM;
+    uint64_t error = timeRefError + (uint64_t)elapsed * ppm / 1000000;
+    return error < UINT32_MAX ? error : UINT32_MAX - 1;
+}
+
+//
+void SIM7080G::TimeService(void) {
+    //Synchronise at 3/4 of the bound so that timestamps stay within it, a module in PSM does not answer
+    if (psmActive || TimeError() < timeMaxError / 4 * 3)
+        return;
+
+    uint32_t now = millis();
+    if (timeAttempt && now - timeAttempt < SIM7080G_TIME_RETRY)
+        return;
+    timeAttempt = now;
+    SyncTime(timeAutoSource);
+}
+
+//
+void SIM7080G::UnlockNetwork(void) {
+    SIM7080G_LANE_GUARD(SIM_LANE_NORMAL);
+    netUnlock = false;
+
+    //Every band of both RATs and automatic operator selection, the RAT is kept as chosen
+    bool result = SetBands(SIM_RAT_CATM, SIM7080G_CATM_BANDS);
+    result = SetBands(SIM_RAT_NBIOT, SIM7080G_NBIOT_BANDS) && result;
+    result = SetCellOperator(NULL) && result;
+    netLocked = !result;
+}
+
+#if SIM7080G_NET_STORE
+/**
+ *  @brief SIM7080G network cache and RAT sites as stored in Preferences, one record per SIM
+*/
+struct SIM7080G_NET_RECORD {
+    uint8_t version = 2;                    //Layout of the record
+    char iccid[24] = { '\0' };              //SIM the record was learned with
+    SIM7080G_NET_CACHE net;
+    SIM7080G_RAT_SITE sites[SIM7080G_RAT_SITES];
+};
+
+/**
+ *  @brief Preferences key of the record of a SIM ("net" and the hash of the ICCID)
+ * 
+ *  @param dst          Key buffer (NVS keys have at most 15 characters)
+ *  @param iccid        ICCID of the SIM
+*/
+void NetworkCacheKey(char (&dst)[16], const char* iccid) {
+    snprintf(dst, sizeof(dst), "net%08lx", (unsigned long)Fnv1a((const uint8_t*)iccid, strlen(iccid)));
+}
+#endif
+
+//
+void SIM7080G::LoadNetworkCache(void) {
+#if SIM7080G_NET_STORE
+    //The cache belongs to the SIM, several modems must not share it
+    const char* id = GetICCID();
+    if (!id[0] || !strcmp(id, netCacheId))
+        return;
+    strcpy(netCacheId, id);
+    netCache = SIM7080G_NET_CACHE();
+    for (uint8_t i = 0; i < SIM7080G_RAT_SITES; i++)
+        ratSites[i] = SIM7080G_RAT_SITE();
+    ratSite = -1;
+
+    //Records of another layout, SIM7080G_RAT_SITES or SIM are ignored
+    SIM7080G_NET_RECORD stored;
+    char key[16];
+    NetworkCacheKey(key, netCacheId);
+    Preferences preferences;
+    if (!preferences.begin("sim7080g", true))
+        return;
+    if (preferences.getBytes(key, &stored, sizeof(stored)) == sizeof(stored) && stored.version == SIM7080G_NET_RECORD().version
+        && !strncmp(stored.iccid, netCacheId, sizeof(stored.iccid)) && stored.net.version == SIM7080G_NET_CACHE().version) {
+        stored.net.plmn[sizeof(stored.net.plmn) - 1] = '\0';
+        netCache = stored.net;
+        for (uint8_t i = 0; i < SIM7080G_RAT_SITES; i++) {
+            ratSites[i] = stored.sites[i];
+            ratSites[i].plmn[sizeof(ratSites[i].plmn) - 1] = '\0';
+        }
+    }
+    preferences.end();
+#endif
+}
+
+//
+void SIM7080G::StoreNetworkCache(void) {
+#if SIM7080G_NET_STORE
+    //Nothing to key the record with before the SIM was read
+    LoadNetworkCache();
+    if (!netCacheId[0])
+        return;
+
+    SIM7080G_NET_RECORD record;
+    strcpy(record.iccid, netCacheId);
+    record.net = netCache;
+    memcpy(record.sites, ratSites, sizeof(ratSites));
+    char key[16];
+    NetworkCacheKey(key, netCacheId);
+    Preferences preferences;
+    if (!preferences.begin("sim7080g", false))
+        return;
+    preferences.putBytes(key, &record, sizeof(record));
+    preferences.end();
+#endif
+    ratDirty = false;
+}
+
+//
+bool SIM7080G::ProbeAT(bool& stored) {
+    Stream& io = Transport();
+    size_t bytesRecv = 0;
+    rxBuffer[0] = '\0';
+
+    io.print("AT\r");
+#if SIM7080G_SHADOW
+    shadowStats.roundTrips++;
+    if (bootCounting)
+        shadowStats.bootRoundTrips++;
+#endif
+
+    //Return on the first result code instead of a fixed receive delay
+    for (uint32_t start = millis(); millis() - start < SIM7080G_BOOT_PROBE;) {
+        if (!io.available()) {
+            delay(1);
+            continue;
+        }
+
+        while (io.available() && bytesRecv < uartMaxRecvSize - 1)
+            rxBuffer[bytesRecv++] = (char)io.read();
+        rxBuffer[bytesRecv] = '\0';
+
+        bool numeric = bytesRecv >= 2 && rxBuffer[bytesRecv - 2] == '0' && rxBuffer[bytesRecv - 1] == '\r';
+        if (numeric || strstr(rxBuffer, "OK\r\n")) {
+            stored = numeric && !strstr(rxBuffer, "AT\r");
+            ScanURC(rxBuffer);
+            return true;
+        }
+
+        if (bytesRecv >= uartMaxRecvSize - 1)
+            break;
+    }
+
+    return false;
+}
+
+//
+bool SIM7080G::VerifyUART(uint8_t rounds, bool echo) {
+    const char* command = "AT+CGMI=?\r";
+    size_t len = strlen(command);
+    bool result = true;
+
+    //Echo the command back to compare every character sent
+    if (!SetEcho(true))
+        return false;
+
+    for (uint8_t i = 0; i < rounds && result; i++) {
+        size_t bytesRecv = SendCommand(command, rxBuffer);
+        result = bytesRecv >= len + 2 && !strncmp(rxBuffer, command, len) && rxBuffer[bytesRecv - 2] == '0';
+    }
+
+    SetEcho(echo);
+    return result;
+}
+
+//
+void SIM7080G::SetHostBaudrate(uint32_t baudrate) {
+    uartInterface.updateBaudRate(baudrate);
+    uartBaudrate = baudrate;
+    FlushUART();
+
+    //Drop bytes received at the old rate
+    while (uartInterface.available())
+        uartInterface.read();
+}
+
+#if SIM7080G_METRICS
+//
+void SIM7080G::MetricsBegin(const char* command) {
+    MetricsCommit();
+
+    //Family: command without "AT" prefix and parameters
+    char family[sizeof(metrics[0].family)] = { '\0' };
+    const char* ptr = command;
+    if ((ptr[0] == 'A' || ptr[0] == 'a') && (ptr[1] == 'T' || ptr[1] == 't'))
+        ptr += 2;
+    size_t length = 0;
+    for (; ptr[length] && ptr[length] != '=' && ptr[length] != '?' && ptr[length] != '\r' && length < sizeof(family) - 1; length++)
+        family[length] = ptr[length];
+    family[length] = '\0';
+
+    uint8_t index = 0;
+    for (; index < metricsFamilies; index++)
+        if (!strcmp(metrics[index].family, family))
+            break;
+
+    if (index == metricsFamilies) {
+        if (metricsFamilies < SIM7080G_METRICS_FAMILIES - 1)
+            strcpy(metrics[metricsFamilies++].family, family);
+        else {
+            //Table full, the last entry collects the rest
+            index = SIM7080G_METRICS_FAMILIES - 1;
+            if (metricsFamilies < SIM7080G_METRICS_FAMILIES) {
+                strcpy(metrics[index].family, "*");
+                metricsFamilies++;
+            }
+        }
+    }
+
+    metrics[index].calls++;
+    metrics[index].bytesOut += strlen(command);
+
+    metricsSpan.family = index;
+    metricsSpan.failed = false;
+    metricsSpan.start = micros();
+    metricsEnd = metricsSpan.start;
+    metricsOpen = true;
+}
+
+//
+void SIM7080G::MetricsEnd(size_t bytesIn, bool timeout) {
+    if (!metricsOpen)
+        return;
+
+    metricsEnd = micros();
+    metrics[metricsSpan.family].bytesIn += bytesIn;
+    if (timeout) {
+        metrics[metricsSpan.family].timeouts++;
+        metricsSpan.failed = true;
+    }
+}
+
+//
+void SIM7080G::MetricsFail() {
+    if (!metricsOpen || metricsSpan.failed)
+        return;
+
+    metrics[metricsSpan.family].failures++;
+    metricsSpan.failed = true;
+}
+
+//
+void SIM7080G::MetricsCommit() {
+    if (!metricsOpen)
+        return;
+    metricsOpen = false;
+
+    //Data phases and result waits extend the exchange until the next command
+    metricsSpan.duration = metricsEnd - metricsSpan.start;
+    uint32_t ms = metricsSpan.duration / 1000;
+
+    SIM7080G_CMD_METRICS& m = metrics[metricsSpan.family];
+    m.totalTime += ms;
+    if (ms > m.maxTime)
+        m.maxTime = ms;
+    uint8_t bucket = MetricsBucket(ms);
+    if (m.histogram[bucket] < UINT16_MAX)
+        m.histogram[bucket]++;
+
+    //Trace ring, the oldest entry is overwritten
+    if (metricsTraceCount < SIM7080G_METRICS_TRACE)
+        metricsTrace[(metricsTraceHead + metricsTraceCount++) % SIM7080G_METRICS_TRACE] = metricsSpan;
+    else {
+        metricsTrace[metricsTraceHead] = metricsSpan;
+        metricsTraceHead = (metricsTraceHead + 1) % SIM7080G_METRICS_TRACE;
+    }
+}
+
+//
+uint8_t SIM7080G::MetricsBucket(uint32_t ms) {
+    uint8_t bucket = 0;
+    for (; ms && bucket < SIM7080G_METRICS_BUCKETS - 1; ms >>= 1)
+        bucket++;
+    return bucket;
+}
+#endif
+
+#if SIM7080G_TRACE
+//
+void SIM7080G::Trace(SIM7080G_TRACE_ID id, int32_t a, int32_t b) {
+    uint16_t head = traceHead.load(std::memory_order_relaxed);
+    uint16_t next = (head + 1) & (SIM7080G_TRACE_EVENTS - 1);
+
+    if (next == traceTail.load(std::memory_order_acquire)) {
+        traceDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    SIM7080G_TRACE_EVENT& event = traceRing[head];
+    event.time = micros();
+    event.id = id;
+    event.a = a;
+    event.b = b;
+    traceHead.store(next, std::memory_order_release);
+}
+#endif
+
+//
+void SIM7080G::YieldLane() {
+#if SIM7080G_THREAD_SAFE
+    if (!laneMutex || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING)
+        return;
+
+    xSemaphoreTake(laneMutex, portMAX_DELAY);
+    if (!laneDepth || laneOwner != xTaskGetCurrentTaskHandle()) {
+        xSemaphoreGive(laneMutex);
+        return;
+    }
+
+    bool higher = false;
+    for (uint8_t i = 0; i < laneOwnerLane; i++)
+        higher |= laneWaiting[i] > 0;
+    if (!higher) {
+        xSemaphoreGive(laneMutex);
+        return;
+    }
+
+    //Release every nesting level, queue up again and restore them
+    SIM7080G_LANE lane = laneOwnerLane;
+    uint16_t depth = laneDepth;
+    laneStats[lane].yields++;
+    laneDepth = 0;
+    laneOwner = nullptr;
+    xSemaphoreGive(laneMutex);
+
+    //Resuming the transaction is no new acquisition, the yield is counted above
+    AcquireLane(lane, UINT32_MAX, false);
+
+    xSemaphoreTake(laneMutex, portMAX_DELAY);
+    laneDepth = depth;
+    xSemaphoreGive(laneMutex);
+#endif
+}
+
+//
+Stream& SIM7080G::Transport() {
+#if SIM7080G_ENABLE_CMUX
+    if (cmuxActive)
+        return cmuxChannels[0];
+#endif
+    return uartInterface;
+}
+
+#if SIM7080G_ENABLE_CMUX
+//
+void SIM7080G::CMUXPoll() {
+#if SIM7080G_THREAD_SAFE
+    xSemaphoreTakeRecursive(cmuxMutex, portMAX_DELAY);
+#endif
+
+    while (uartInterface.available())
+        CMUXParse((uint8_t)uartInterface.read());
+
+#if SIM7080G_THREAD_SAFE
+    xSemaphoreGiveRecursive(cmuxMutex);
+#endif
+}
+
+//
+void SIM7080G::CMUXParse(uint8_t c) {
+    switch (cmuxState) {
+        //Opening flag
+        case 0:
+            if (c == 0xF9)
+                cmuxState = 1;
+            break;
+
+        //Address (repeated flags are skipped)
+        case 1:
+            if (c == 0xF9)
+                break;
+            cmuxHeader[0] = c;
+            cmuxHeaderLength = 1;
+            cmuxState = 2;
+            break;
+
+        //Control
+        case 2:
+            cmuxHeader[cmuxHeaderLength++] = c;
+            cmuxState = 3;
+            break;
+
+        //Length, 1 or 2 bytes
+        case 3:
+        case 4:
+            cmuxHeader[cmuxHeaderLength++] = c;
+            if (cmuxState == 3)
+                cmuxLength = c >> 1;
+            else
+                cmuxLength |= (uint16_t)c << 7;
+            cmuxIndex = 0;
+            if (cmuxState == 3 && !(c & 0x01))
+                cmuxState = 4;
+            else
+                cmuxState = cmuxLength ? 5 : 6;
+            break;
+
+        //Information field, channel data goes straight to the channel
+        case 5: {
+            uint8_t dlci = cmuxHeader[0] >> 2;
+            if (dlci == 0) {
+                if (cmuxIndex < sizeof(cmuxControlData))
+                    cmuxControlData[cmuxIndex] = c;
+            }
+            else if (dlci <= SIM7080G_CMUX_CHANNELS && (cmuxHeader[1] & ~0x10) == 0xEF) {
+                //A full channel drops its data, waiting for it would stall the other channels
+                SIM7080G_CMUX_CHANNEL& channel = cmuxChannels[dlci - 1];
+                if (channel.rxCount < SIM7080G_CMUX_BUFFER) {
+                    channel.rxBuffer[(channel.rxHead + channel.rxCount) % SIM7080G_CMUX_BUFFER] = c;
+                    channel.rxCount++;
+                    cmuxStats.bytesIn++;
+                }
+                else
+                    cmuxStats.overruns++;
+            }
+            if (++cmuxIndex >= cmuxLength)
+                cmuxState = 6;
+            break;
+        }
+
+        //Frame check sequence (UIH: address, control and length only)
+        case 6:
+            if (CMUXFcs(cmuxHeader, cmuxHeaderLength) != c)
+                cmuxStats.fcsErrors++;
+            cmuxState = 7;
+            break;
+
+        //Closing flag, might be the opening flag of the next frame as well
+        case 7:
+            if (c == 0xF9) {
+                CMUXFrame();
+                cmuxState = 1;
+            }
+            else
+                cmuxState = 0;
+            break;
+    }
+}
+
+//
+void SIM7080G::CMUXFrame() {
+    uint8_t dlci = cmuxHeader[0] >> 2;
+    uint8_t control = cmuxHeader[1] & ~0x10;
+
+    cmuxStats.framesIn++;
+    if (dlci > SIM7080G_CMUX_CHANNELS)
+        return;
+
+    switch (control) {
+        //UA, DM: answer to SABM / DISC
+        case 0x63:
+        case 0x0F:
+            cmuxReply[dlci] = control;
+            break;
+
+        //DISC: module closes a channel
+        case 0x43:
+            CMUXSendFrame(dlci, 0x73, nullptr, 0, true);
+            if (dlci)
+                cmuxChannels[dlci - 1].open = false;
+            else
+                CMUXReset();
+            break;
+
+        //UIH
+        case 0xEF:
+            if (dlci == 0)
+                CMUXControl();
+            else {
+                //Stop the channel before its buffer overflows
+                SIM7080G_CMUX_CHANNEL& channel = cmuxChannels[dlci - 1];
+                if (!channel.localFC && channel.rxCount > SIM7080G_CMUX_BUFFER / 2)
+                    CMUXFlowControl(dlci, true);
+            }
+            break;
+    }
+}
+
+//
+void SIM7080G::CMUXControl() {
+    if (cmuxLength < 2)
+        return;
+
+    uint8_t type = cmuxControlData[0];
+    bool command = type & 0x02;
+
+    switch (type & ~0x02) {
+        //MSC: per channel flow control
+        case 0xE1:
+            if (command && cmuxLength >= 4) {
+                uint8_t dlci = cmuxControlData[2] >> 2;
+                if (dlci > 0 && dlci <= SIM7080G_CMUX_CHANNELS) {
+                    bool stop = cmuxControlData[3] & 0x02;
+                    if (stop && !cmuxChannels[dlci - 1].remoteFC)
+                        cmuxStats.remoteFlowStops++;
+                    cmuxChannels[dlci - 1].remoteFC = stop;
+                }
+            }
+            break;
+
+        //FCon / FCoff: aggregate flow control
+        case 0xA1:
+        case 0x61:
+            if (command)
+                for (uint8_t i = 0; i < SIM7080G_CMUX_CHANNELS; i++)
+                    cmuxChannels[i].remoteFC = (type & ~0x02) == 0x61;
+            break;
+
+        //CLD: module leaves multiplexer mode
+        case 0xC1:
+            if (command)
+                CMUXReset();
+            return;
+
+        //Test: echo
+        case 0x21:
+            break;
+
+        //Responses to our own commands, unsupported commands
+        default:
+            return;
+    }
+
+    //Acknowledge with the same message, C/R cleared
+    if (command && cmuxLength <= sizeof(cmuxControlData)) {
+        cmuxControlData[0] = type & ~0x02;
+        CMUXSendFrame(0, 0xEF, cmuxControlData, cmuxLength);
+    }
+}
+
+//
+void SIM7080G::CMUXSendFrame(uint8_t dlci, uint8_t control, const uint8_t* data, size_t len, bool response) {
+    //Initiator: C/R set on commands and data, cleared on responses (TS 27.010 5.2.1.2)
+    uint8_t header[4] = { 0xF9, (uint8_t)((dlci << 2) | (response ? 0x01 : 0x03)), control, (uint8_t)((len << 1) | 0x01) };
+    uint8_t trailer[2] = { CMUXFcs(header + 1, 3), 0xF9 };
+
+    //Frames of different channels must not interleave on the UART
+#if SIM7080G_THREAD_SAFE
+    xSemaphoreTakeRecursive(cmuxMutex, portMAX_DELAY);
+#endif
+    uartInterface.write(header, sizeof(header));
+    if (len)
+        uartInterface.write(data, len);
+    uartInterface.write(trailer, sizeof(trailer));
+    cmuxStats.framesOut++;
+#if SIM7080G_THREAD_SAFE
+    xSemaphoreGiveRecursive(cmuxMutex);
+#endif
+}
+
+//
+size_t SIM7080G::CMUXWrite(uint8_t dlci, const uint8_t* data, size_t len) {
+    SIM7080G_CMUX_CHANNEL& channel = cmuxChannels[dlci - 1];
+    size_t sent = 0;
+
+    while (channel.open && sent < len) {
+        //Wait for the module to accept data on this channel again
+        for (uint32_t start = millis(); channel.remoteFC && millis() - start < SIM7080G_CMUX_FC_TIMEOUT;) {
+            CMUXPoll();
+            delay(1);
+        }
+        if (channel.remoteFC)
+            break;
+
+        size_t chunk = len - sent < SIM7080G_CMUX_N1 ? len - sent : SIM7080G_CMUX_N1;
+        CMUXSendFrame(dlci, 0xEF, data + sent, chunk);
+        sent += chunk;
+    }
+
+    cmuxStats.bytesOut += sent;
+    return sent;
+}
+
+//
+bool SIM7080G::CMUXConnect(uint8_t dlci, uint8_t control, uint32_t timeout) {
+    cmuxReply[dlci] = 0;
+    CMUXSendFrame(dlci, control);
+
+    for (uint32_t start = millis(); !cmuxReply[dlci] && millis() - start < timeout;) {
+        CMUXPoll();
+        delay(1);
+    }
+
+    bool result = cmuxReply[dlci] == 0x63;
+    if (dlci)
+        cmuxChannels[dlci - 1].open = result && control == 0x3F;
+
+    return result;
+}
+
+//
+void SIM7080G::CMUXFlowControl(uint8_t dlci, bool stop) {
+    //MSC command: DLCI, V.24 signals (DV, RTR, RTC, FC)
+    const uint8_t msc[] = { 0xE3, 0x05, (uint8_t)((dlci << 2) | 0x03), (uint8_t)(stop ? 0x8F : 0x8D) };
+    CMUXSendFrame(0, 0xEF, msc, sizeof(msc));
+
+    cmuxChannels[dlci - 1].localFC = stop;
+    if (stop)
+        cmuxStats.flowStops++;
+}
+
+//
+void SIM7080G::CMUXReset() {
+    cmuxActive = false;
+    cmuxState = 0;
+    for (uint8_t i = 0; i < SIM7080G_CMUX_CHANNELS; i++) {
+        cmuxChannels[i].open = false;
+        cmuxChannels[i].localFC = false;
+        cmuxChannels[i].remoteFC = false;
+        cmuxChannels[i].rxHead = 0;
+        cmuxChannels[i].rxCount = 0;
+    }
+    memset(cmuxReply, 0, sizeof(cmuxReply));
+}
+
+//
+uint8_t SIM7080G::CMUXFcs(const uint8_t* data, size_t len) {
+    //CRC-8, reversed polynomial x^8 + x^2 + x + 1
+    uint8_t fcs = 0xFF;
+    while (len--) {
+        fcs ^= *data++;
+        for (uint8_t i = 0; i < 8; i++)
+            fcs = (fcs & 0x01) ? (fcs >> 1) ^ 0xE0 : fcs >> 1;
+    }
+    return 0xFF - fcs;
+}
+#endif
+
+//
+void SIM7080G::EraseRXBuff(uint32_t value) {
+    size_t rounds = this->uartMaxRecvSize / 4;
+    //Erase buffer with 32 bit numbers for efficiency
+    for(size_t i = 0; i < rounds; i+=4)
+        rxBuffer[i] = value;
+}
+
+#if SIM7080G_ENABLE_HTTP
+//
+bool SIM7080G::AddHTTPContent(const char* type, const char* value, const char* command) {
+    if (type == NULL || value == NULL || command == NULL)
+        return false;
+    
+    snprintf(txBuffer, sizeof(txBuffer), "%s=\"%s\",\"%s\"\r", command, type, value);
+    
+    return SendCommand(txBuffer);
+}
+
+//
+bool SIM7080G::AddHTTPHost(void) {
+    if (httpHost[0] == '\0')
+        return true;
+    return AddHTTPContent("Host", httpHost, "AT+SHAHEAD");
+}
+#endif
+
+//
+bool SIM7080G::WaitForResponse(const char* token, uint32_t timeout) {
+    //Token might have arrived together with the command response
+    if (strstr(rxBuffer, token))
+        return true;
+
+    Stream& io = Transport();
+    size_t bytesRecv = 0;
+    rxBuffer[0] = '\0';
+
+    for (uint32_t start = millis(); millis() - start < timeout;) {
+        if (!io.available()) {
+            delay(1);
+            continue;
+        }
+
+        //Start over if the buffer fills up without the token
+        if (bytesRecv >= uartMaxRecvSize - 1)
+            bytesRecv = 0;
+
+        while (io.available() && bytesRecv < uartMaxRecvSize - 1)
+            rxBuffer[bytesRecv++] = (char)io.read();
+        rxBuffer[bytesRecv] = '\0';
+
+        if (strstr(rxBuffer, token)) {
+            ScanURC(rxBuffer);
+#if SIM7080G_METRICS
+            MetricsEnd(bytesRecv, false);
+#endif
+            return true;
+        }
+    }
+
+    ScanURC(rxBuffer);
+#if SIM7080G_METRICS
+    MetricsEnd(bytesRecv, true);
+#endif
+    return false;
+}
+
+//
+bool SIM7080G::WaitForResult(uint32_t timeout) {
+    Stream& io = Transport();
+    size_t bytesRecv = 0;
+    rxBuffer[0] = '\0';
+
+    for (uint32_t start = millis(); millis() - start < timeout;) {
+        if (!io.available()) {
+            delay(1);
+            continue;
+        }
+
+        if (bytesRecv >= uartMaxRecvSize - 1)
+            bytesRecv = 0;
+
+        while (io.available() && bytesRecv < uartMaxRecvSize - 1)
+            rxBuffer[bytesRecv++] = (char)io.read();
+        rxBuffer[bytesRecv] = '\0';
+
+        //Look for a line containing only a numeric result code (ATV0)
+        for (size_t i = 0; i + 1 < bytesRecv; i++) {
+            if ((i == 0 || rxBuffer[i - 1] == '\n' || rxBuffer[i - 1] == '\r') && rxBuffer[i] >= '0' && rxBuffer[i] <= '9' && rxBuffer[i + 1] == '\r') {
+                ScanURC(rxBuffer);
+#if SIM7080G_METRICS
+                MetricsEnd(bytesRecv, false);
+                if (rxBuffer[i] != '0')
+                    MetricsFail();
+#endif
+                return rxBuffer[i] == '0';
+            }
+        }
+    }
+
+    ScanURC(rxBuffer);
+#if SIM7080G_METRICS
+    MetricsEnd(bytesRecv, true);
+#endif
+    return false;
+}
+
+//
+bool SIM7080G::SendData(const char* command, const uint8_t* src, size_t len, uint32_t timeout, const char* prompt) {
+    //Wait for the data prompt
+    SendCommand(command, rxBuffer, 2000);
+    if (!strstr(rxBuffer, prompt) && !WaitForResponse(prompt, 2000))
+        return false;
+
+    Send((uint8_t*)src, len);
+
+    return WaitForResult(timeout);
+}
+
+//
+size_t SIM7080G::ReadModuleFile(const char* name, char* dst, size_t len) {
+    if (!SendCommand("AT+CFSINIT\r"))
+        return 0;
+
+    //Directory 3: /customer/
+    char buffer[80] = { '\0' };
+    sprintf(buffer, "AT+CFSRFILE=3,\"%s\",0,%u,0\r", name, len);
+    SendCommand(buffer, rxBuffer, 2000);
+
+    //+CFSRFILE: <len> followed by the data on the next line
+    size_t bytesRead = 0;
+    char* startPtr = strstr(rxBuffer, "+CFSRFILE: ");
+    if (startPtr) {
+        bytesRead = CharToNmbr(startPtr + 11);
+        startPtr = strchr(startPtr, '\n');
+        if (bytesRead > len)
+            bytesRead = len;
+        if (startPtr)
+            memcpy(dst, startPtr + 1, bytesRead);
+        else
+            bytesRead = 0;
+    }
+
+    SendCommand("AT+CFSTERM\r");
+    return bytesRead;
+}
+
+//
+bool SIM7080G::WriteModuleFile(const char* name, const uint8_t* data, size_t len) {
+    if (!SendCommand("AT+CFSINIT\r"))
+        return false;
+
+    //Directory 3: /customer/, mode 0: overwrite, 10 s input time
+    char buffer[80] = { '\0' };
+    sprintf(buffer, "AT+CFSWFILE=3,\"%s\",0,%u,10000\r", name, len);
+    bool result = SendData(buffer, data, len, 12000, "DOWNLOAD");
+
+    SendCommand("AT+CFSTERM\r");
+    return result;
+}
+
+//
+bool SIM7080G::ConvertCertificate(uint8_t type, const char* name, const char* key) {
+    SIM7080G_TLS_CERT* cert = NULL;
+    for (uint8_t i = 0; i < SIM7080G_TLS_CERTS; i++)
+        if (!strcmp(tlsCerts[i].name, name))
+            cert = &tlsCerts[i];
+
+    SIM7080G_TLS_CERT* keyCert = NULL;
+    for (uint8_t i = 0; key && key[0] != '\0' && i < SIM7080G_TLS_CERTS; i++)
+        if (!strcmp(tlsCerts[i].name, key))
+            keyCert = &tlsCerts[i];
+
+    //Neither written since boot, the module keeps converted certificates
+    if (!(cert && cert->pending) && !(keyCert && keyCert->pending))
+        return true;
+
+    char buffer[96] = { '\0' };
+    if (key && key[0] != '\0')
+        sprintf(buffer, "AT+CSSLCFG=\"CONVERT\",%u,\"%s\",\"%s\"\r", type, name, key);
+    else
+        sprintf(buffer, "AT+CSSLCFG=\"CONVERT\",%u,\"%s\"\r", type, name);
+    if (!SendCommand(buffer, 5000))
+        return false;
+
+    //Store the hashes only after a successful conversion, the key is converted together with the certificate
+    char hashName[36] = { '\0' };
+    char hashText[12] = { '\0' };
+    SIM7080G_TLS_CERT* converted[2] = { cert, keyCert };
+    for (uint8_t i = 0; i < 2; i++) {
+        if (!converted[i] || !converted[i]->pending)
+            continue;
+        sprintf(hashName, "%s.fnv", converted[i]->name);
+        sprintf(hashText, "%08lx", (unsigned long)converted[i]->hash);
+        WriteModuleFile(hashName, (const uint8_t*)hashText, 8);
+        converted[i]->pending = false;
+    }
+
+    tlsStats.certUploads++;
+    return true;
+}
+
+//
+void SIM7080G::RecordHandshake(uint32_t duration, bool success) {
+    if (!success) {
+        tlsStats.failures++;
+        return;
+    }
+
+    tlsStats.handshakes++;
+    tlsStats.lastHandshakeTime = duration;
+
+    //Timing only, the module reports neither the handshake type nor session resumption
+    if (tlsStats.fullHandshakeTime && duration * 100 < tlsStats.fullHandshakeTime * SIM7080G_TLS_FAST_RATIO) {
+        tlsStats.fastHandshakes++;
+        return;
+    }
+
+    tlsStats.fullHandshakes++;
+    tlsStats.fullHandshakeTime = tlsStats.fullHandshakeTime ? (tlsStats.fullHandshakeTime * 3 + duration) / 4 : duration;
+}
+
+#if SIM7080G_ENABLE_MQTT
+//
+bool SIM7080G::MQTTEnsureConnected(void) {
+    if (mqttConnected)
+        return true;
+
+    //Session dropped, reconnect with the stored configuration
+    if (mqttConf.host[0] == '\0')
+        return false;
+
+    return MQTTConnect(mqttConf);
+}
+
+//
+bool SIM7080G::MQTTSendPublish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos, bool retain) {
+    char buffer[SIM7080G_MQTT_TOPIC + 32] = { '\0' };
+    sprintf(buffer, "AT+SMPUB=\"%s\",%u,%u,%u\r", topic, length, qos > 1 ? 1 : qos, retain ? 1 : 0);
+
+    uint32_t start = millis();
+    bool result = SendData(buffer, payload, length, 30000);
+    uint32_t latency = millis() - start;
+
+    if (!result) {
+        mqttStats.failed++;
+        mqttConnected = false;      //Reconnect before the next publish
+        return false;
+    }
+
+    mqttStats.published++;
+    mqttStats.bytesPublished += length;
+    mqttStats.lastLatency = latency;
+    mqttStats.totalLatency += latency;
+    if (latency > mqttStats.maxLatency)
+        mqttStats.maxLatency = latency;
+
+    NotifyLinkTraffic();
+    return true;
+}
+
+//
+void SIM7080G::MQTTDeliver(void) {
+    for (uint8_t i = 0; i < mqttInboxCount; i++) {
+        SIM7080G_MQTT_MSG& msg = mqttInbox[i];
+        SIM7080G_MQTT_CALLBACK callback = mqttCallback;
+
+        for (uint8_t j = 0; j < SIM7080G_MQTT_SUBS; j++) {
+            if (mqttSubs[j].callback && mqttSubs[j].topic[0] != '\0' && MQTTTopicMatch(mqttSubs[j].topic, msg.topic)) {
+                callback = mqttSubs[j].callback;
+                break;
+            }
+        }
+
+        if (callback)
+            callback(msg.topic, msg.payload, msg.length);
+    }
+    mqttInboxCount = 0;
+}
+
+//
+bool SIM7080G::MQTTTopicMatch(const char* filter, const char* topic) {
+    while (*filter && *topic) {
+        if (*filter == '#')
+            return true;
+
+        if (*filter == '+') {
+            //Single level wildcard, skip one topic level
+            while (*topic && *topic != '/')
+                topic++;
+            filter++;
+            continue;
+        }
+
+        if (*filter != *topic)
+            return false;
+        filter++;
+        topic++;
+    }
+
+    return (*filter == '\0' || !strcmp(filter, "#") || !strcmp(filter, "/#")) && *topic == '\0';
+}
+
+#endif
+#if SIM7080G_ENABLE_COAP
+//
+bool SIM7080G::CoAPSendMessage(void) {
+    const size_t blockSize = 1 << (SIM7080G_COAP_BLOCK_SZX + 4);
+    uint8_t* msg = coapMessage;
+    size_t len = 0;
+
+    //Header: version 1, type, token length 4, code, message ID
+    coapMessageId++;
+    msg[len++] = 0x40 | (coapType << 4) | 4;
+    msg[len++] = coapMethod;
+    msg[len++] = coapMessageId >> 8;
+    msg[len++] = coapMessageId & 0xFF;
+    msg[len++] = coapToken >> 24;
+    msg[len++] = coapToken >> 16;
+    msg[len++] = coapToken >> 8;
+    msg[len++] = coapToken;
+
+    //Options in ascending order: Uri-Path (11), Block2 (23), Block1 (27)
+    uint16_t lastOption = 0;
+    for (const char* segment = coapPath; *segment;) {
+        while (*segment == '/')
+            segment++;
+        size_t segmentLength = strcspn(segment, "/");
+        if (!segmentLength)
+            break;
+        if (len + segmentLength + 5 > SIM7080G_COAP_BUFFER)
+            return false;
+        len += CoAPPutOption(msg + len, 11 - lastOption, (const uint8_t*)segment, segmentLength);
+        lastOption = 11;
+        segment += segmentLength;
+    }
+
+    uint8_t blockValue[3];
+
+    //Ask for the next block of a block-wise response
+    if (coapBlock2) {
+        uint32_t value = coapBlock2 << 4 | SIM7080G_COAP_BLOCK_SZX;
+        size_t valueLength = value > 0xFFFF ? 3 : value > 0xFF ? 2 : 1;
+        for (size_t i = 0; i < valueLength; i++)
+            blockValue[i] = value >> (8 * (valueLength - 1 - i));
+        if (len + 2 + valueLength > SIM7080G_COAP_BUFFER)
+            return false;
+        len += CoAPPutOption(msg + len, 23 - lastOption, blockValue, valueLength);
+        lastOption = 23;
+    }
+
+    //Payload slice of this block
+    size_t offset = coapBlock1 * blockSize;
+    size_t sliceLength = coapBlock2 ? 0 : coapLength - offset;
+
+    if (!coapBlock2 && coapLength > blockSize) {
+        bool more = offset + blockSize < coapLength;
+        if (more)
+            sliceLength = blockSize;
+        uint32_t value = coapBlock1 << 4 | (more ? 0x08 : 0) | SIM7080G_COAP_BLOCK_SZX;
+        size_t valueLength = value > 0xFFFF ? 3 : value > 0xFF ? 2 : value ? 1 : 0;
+        for (size_t i = 0; i < valueLength; i++)
+            blockValue[i] = value >> (8 * (valueLength - 1 - i));
+        if (len + 2 + valueLength > SIM7080G_COAP_BUFFER)
+            return false;
+        len += CoAPPutOption(msg + len, 27 - lastOption, blockValue, valueLength);
+    }
+
+    if (sliceLength) {
+        if (len + 1 + sliceLength > SIM7080G_COAP_BUFFER)
+            return false;
+        msg[len++] = 0xFF;
+        memcpy(msg + len, coapPayload + offset, sliceLength);
+        len += sliceLength;
+    }
+
+    coapMessageLength = len;
+    coapRetries = 0;
+    coapAcked = false;
+    coapTimeout = SIM7080G_COAP_ACK_TIMEOUT + millis() % (SIM7080G_COAP_ACK_TIMEOUT / 2);   //ACK_RANDOM_FACTOR 1.5
+
+    coapStats.messages++;
+    coapStats.bytesSent += len;
+    coapSentTime = millis();
+
+    return SocketSend(coapSocket, coapMessage, coapMessageLength) == coapMessageLength;
+}
+
+//
+void SIM7080G::CoAPService(void) {
+    uint8_t msg[SIM7080G_COAP_BUFFER];
+    size_t len = SocketRead(coapSocket, msg, sizeof(msg));
+
+    if (!len) {
+        uint32_t elapsed = millis() - coapSentTime;
+
+        //Waiting for a separate or non-confirmable response
+        if (coapAcked || coapType == SIM_COAP_NON) {
+            if (elapsed >= SIM7080G_COAP_RESPONSE_TIMEOUT) {
+                CoAPFinish(0, nullptr, 0, false);
+            }
+            return;
+        }
+
+        if (elapsed < coapTimeout)
+            return;
+
+        //Retransmit with exponential back-off
+        if (coapRetries >= SIM7080G_COAP_MAX_RETRANSMIT) {
+            CoAPFinish(0, nullptr, 0, false);
+            return;
+        }
+        coapRetries++;
+        coapTimeout *= 2;
+        coapStats.retransmissions++;
+        coapStats.messages++;
+        coapStats.bytesSent += coapMessageLength;
+        coapSentTime = millis();
+        SocketSend(coapSocket, coapMessage, coapMessageLength);
+        return;
+    }
+
+    coapStats.bytesReceived += len;
+
+    //Header
+    if (len < 4 || (msg[0] >> 6) != 1)
+        return;
+    uint8_t type = (msg[0] >> 4) & 0x03;
+    uint8_t tokenLength = msg[0] & 0x0F;
+    uint8_t code = msg[1];
+    uint16_t messageId = msg[2] << 8 | msg[3];
+    size_t pos = 4;
+
+    //Reset: the server rejected the message
+    if (type == 3) {
+        if (messageId == coapMessageId)
+            CoAPFinish(0, nullptr, 0, false);
+        return;
+    }
+
+    //Empty confirmable message (CoAP ping): answer with a reset
+    if (type == 0 && code == 0) {
+        uint8_t rst[4] = { 0x70, 0x00, msg[2], msg[3] };
+        SocketSend(coapSocket, rst, sizeof(rst));
+        return;
+    }
+
+    //Acknowledge separate confirmable responses
+    if (type == 0) {
+        uint8_t ack[4] = { 0x60, 0x00, msg[2], msg[3] };
+        SocketSend(coapSocket, ack, sizeof(ack));
+    }
+
+    //Empty ACK: the response follows separately
+    if (code == 0) {
+        if (type == 2 && messageId == coapMessageId) {
+            coapAcked = true;
+            coapSentTime = millis();
+        }
+        return;
+    }
+
+    //Match the token
+    if (tokenLength != 4 || pos + 4 > len)
+        return;
+    uint32_t token = (uint32_t)msg[pos] << 24 | (uint32_t)msg[pos + 1] << 16 | msg[pos + 2] << 8 | msg[pos + 3];
+    if (token != coapToken)
+        return;
+    pos += 4;
+
+    //Options
+    uint16_t option = 0;
+    int32_t block1 = -1;
+    int32_t block2 = -1;
+    while (pos < len && msg[pos] != 0xFF) {
+        uint16_t delta = msg[pos] >> 4;
+        uint16_t optionLength = msg[pos] & 0x0F;
+        pos++;
+
+        //Extended delta and length, a truncated datagram is dropped
+        if (delta == 13) {
+            if (pos + 1 > len)
+                return;
+            delta = msg[pos++] + 13;
+        }
+        else if (delta == 14) {
+            if (pos + 2 > len)
+                return;
+            delta = (msg[pos] << 8 | msg[pos + 1]) + 269;
+            pos += 2;
+        }
+        if (optionLength == 13) {
+            if (pos + 1 > len)
+                return;
+            optionLength = msg[pos++] + 13;
+        }
+        else if (optionLength == 14) {
+            if (pos + 2 > len)
+                return;
+            optionLength = (msg[pos] << 8 | msg[pos + 1]) + 269;
+            pos += 2;
+        }
+        if (pos + optionLength > len)
+            return;
+
+        option += delta;
+        if (option == 23 || option == 27) {
+            uint32_t value = 0;
+            for (uint16_t i = 0; i < optionLength; i++)
+                value = value << 8 | msg[pos + i];
+            if (option == 23)
+                block2 = value;
+            else
+                block1 = value;
+        }
+        pos += optionLength;
+    }
+
+    const uint8_t* payload = pos < len ? msg + pos + 1 : nullptr;
+    size_t payloadLength = pos < len ? len - pos - 1 : 0;
+
+    //2.31 Continue: send the next request block
+    if (code == 0x5F && block1 >= 0) {
+        coapBlock1 = (block1 >> 4) + 1;
+        if (!CoAPSendMessage())
+            CoAPFinish(0, nullptr, 0, false);
+        return;
+    }
+
+    //Block-wise response: pass the block on and ask for the next one
+    if (block2 >= 0 && (block2 & 0x08)) {
+        uint32_t blockSize = 1 << ((block2 & 0x07) + 4);
+        uint32_t num = block2 >> 4;
+        if (coapCallback) {
+            SIM7080G_COAP_RESPONSE response;
+            response.code = code;
+            response.payload = payload;
+            response.length = payloadLength;
+            response.offset = num * blockSize;
+            response.more = true;
+            coapCallback(&response);
+        }
+        coapBlock2 = num + 1;
+        if (!CoAPSendMessage())
+            CoAPFinish(0, nullptr, 0, false);
+        return;
+    }
+
+    CoAPFinish(code, payload, payloadLength, false);
+}
+
+//
+void SIM7080G::CoAPFinish(uint8_t code, const uint8_t* payload, size_t length, bool more) {
+    coapBusy = false;
+
+    if (code)
+        coapStats.completed++;
+    else
+        coapStats.failed++;
+
+    if (coapCallback) {
+        SIM7080G_COAP_RESPONSE response;
+        response.code = code;
+        response.payload = payload;
+        response.length = length;
+        response.offset = coapBlock2 * (1 << (SIM7080G_COAP_BLOCK_SZX + 4));
+        response.more = more;
+        coapCallback(&response);
+    }
+}
+
+//
+size_t SIM7080G::CoAPPutOption(uint8_t* dst, uint16_t delta, const uint8_t* value, size_t length) {
+    size_t pos = 1;
+    uint8_t deltaNibble = delta;
+    uint8_t lengthNibble = length;
+
+    //Extended option delta and length: one byte from 13, two bytes from 269
+    if (delta >= 269) {
+        deltaNibble = 14;
+        dst[pos++] = (delta - 269) >> 8;
+        dst[pos++] = (delta - 269) & 0xFF;
+    }
+    else if (delta >= 13) {
+        deltaNibble = 13;
+        dst[pos++] = delta - 13;
+    }
+    if (length >= 269) {
+        lengthNibble = 14;
+        dst[pos++] = (length - 269) >> 8;
+        dst[pos++] = (length - 269) & 0xFF;
+    }
+    else if (length >= 13) {
+        lengthNibble = 13;
+        dst[pos++] = length - 13;
+    }
+    dst[0] = deltaNibble << 4 | lengthNibble;
+
+    memcpy(dst + pos, value, length);
+    return pos + length;
+}
+#endif
+
+//
+void SIM7080G::SocketFetch(uint8_t id) {
+    SIM7080G_SOCKET& socket = sockets[id];
+    socket.dataPending = false;
+
+    //A datagram is only fetched into an empty ring, so that its length is the ring's byte count
+    size_t space = SIM7080G_SOCKET_RX_BUFFER - socket.rxCount;
+    if (!space || (socket.datagram && socket.rxCount)) {
+        socket.dataPending = true;  //Try again once the application has read some data
+        return;
+    }
+    if (space > SIM7080G_SOCKET_MAX_SEND)
+        space = SIM7080G_SOCKET_MAX_SEND;
+
+    char buffer[32] = { '\0' };
+    sprintf(buffer, "AT+CARECV=%u,%u\r", id, space);
+    SendCommand(buffer, nullptr);
+
+    //+CARECV: <recvlen>,<data> is read raw, the data may hold line breaks, result codes or lines starting with + or *.
+    //Lines ahead of the header are the echo, URCs or the result code of a read without data
+    Stream& io = Transport();
+    char line[SIM7080G_URC_BUFFER] = { '\0' };
+    size_t lineLength = 0;
+    size_t dataLength = 0;
+    bool header = false;
+
+    for (uint32_t start = millis(); !header && millis() - start < 2000;) {
+        if (!io.available()) {
+            delay(1);
+            continue;
+        }
+
+        char c = (char)io.read();
+        if (c == '\r' || c == '\n') {
+            line[lineLength] = '\0';
+            if (lineLength == 1 && line[0] >= '0' && line[0] <= '9') {
+#if SIM7080G_METRICS
+                MetricsEnd(0, false);
+                if (line[0] != '0')
+                    MetricsFail();
+#endif
+                return;
+            }
+            ScanURC(line);
+            lineLength = 0;
+            continue;
+        }
+
+        if (lineLength < sizeof(line) - 1)
+            line[lineLength++] = c;
+        line[lineLength] = '\0';
+
+        if (c == ',' && !strncmp(line, "+CARECV: ", 9)) {
+            dataLength = CharToNmbr(line + 9);
+            header = true;
+        }
+    }
+
+    if (!header) {
+#if SIM7080G_METRICS
+        MetricsEnd(0, true);
+#endif
+        return;
+    }
+
+    //Exactly <recvlen> bytes follow, keep what fits in the ring
+    size_t received = 0;
+    for (uint32_t start = millis(); received < dataLength && millis() - start < 2000;) {
+        if (!io.available()) {
+            delay(1);
+            continue;
+        }
+
+        uint8_t c = (uint8_t)io.read();
+        if (received++ < space)
+            socket.rxBuffer[(socket.rxHead + socket.rxCount++) % SIM7080G_SOCKET_RX_BUFFER] = c;
+    }
+
+    //Result code after the data
+    WaitForResult(1000);
+
+    if (!received)
+        return;
+
+    //More data might be waiting in the module, further datagrams are not announced again
+    if (received >= space || socket.datagram)
+        socket.dataPending = true;
+
+    NotifyLinkTraffic();
+}
+
+//
+void SIM7080G::PingReply(uint32_t rtt) {
+    SIM7080G_PING_RESULT* result = pingResult;
+
+    //Timed out requests are reported with the timeout as RTT
+    if (rtt < pingTimeout) {
+        if (!result->received || rtt < result->min)
+            result->min = rtt;
+        if (rtt > result->max)
+            result->max = rtt;
+
+        if (result->received)
+            result->jitterSum += rtt > result->lastRtt ? rtt - result->lastRtt : result->lastRtt - rtt;
+        result->lastRtt = rtt;
+
+        //Welford's online mean and variance
+        result->received++;
+        double delta = rtt - result->mean;
+        result->mean += delta / result->received;
+        result->m2 += delta * (rtt - result->mean);
+
+        result->avg = (uint32_t)(result->mean + 0.5);
+        result->jitter = result->received > 1 ? result->jitterSum / (result->received - 1) : 0;
+        result->histogram[PingBucket(rtt)]++;
+
+        NotifyLinkTraffic();
+    }
+    else
+        result->lost++;
+
+    if (result->received + result->lost >= result->count)
+        PingFinish();
+}
+
+//
+void SIM7080G::PingFinish(void) {
+    SIM7080G_PING_RESULT* result = pingResult;
+    pingResult = nullptr;
+
+    result->lost = result->count - result->received;
+    result->loss = (uint32_t)result->lost * 1000 / result->count;
+    result->stddev = result->received > 1 ? (uint32_t)(sqrt(result->m2 / (result->received - 1)) + 0.5) : 0;
+
+    //Percentiles: midpoint of the bucket holding the rank, clamped to the observed range
+    uint32_t* percentiles[3] = { &result->p50, &result->p95, &result->p99 };
+    const uint8_t ranks[3] = { 50, 95, 99 };
+    for (uint8_t p = 0; p < 3 && result->received; p++) {
+        uint32_t rank = ((uint32_t)result->received * ranks[p] + 99) / 100;
+        uint32_t seen = 0;
+        for (uint8_t i = 0; i < SIM7080G_PING_BUCKETS; i++) {
+            seen += result->histogram[i];
+            if (seen < rank)
+                continue;
+            uint32_t value = (PingBucketFloor(i) + PingBucketFloor(i + 1)) / 2;
+            *percentiles[p] = value < result->min ? result->min : value > result->max ? result->max : value;
+            break;
+        }
+    }
+
+    result->done = true;
+    AddRATSample(result->p50, 0);
+
+#if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - Ping %s: %u/%u, RTT min/avg/max/mdev %u/%u/%u/%u ms, jitter %u ms\n", result->address, result->received, result->count, result->min, result->avg, result->max, result->stddev, result->jitter);
+#endif
+}
+
+//
+void SIM7080G::RefreshDNS(void) {
+    uint32_t now = millis();
+
+    //One query at a time, the module answers within the two tries of 5 s it was given
+    if (dnsRefresh >= 0) {
+        if (now - dnsRefreshStart >= 12000)
+            RefreshDNSDone(NULL);
+        return;
+    }
+
+    for (uint8_t i = 0; i < SIM7080G_DNS_CACHE; i++) {
+        SIM7080G_DNS_ENTRY& entry = dnsCache[i];
+
+        //Only positive entries still in use, in the last 10% of their lifetime
+        if (entry.host[0] == '\0' || entry.ip[0] == '\0' || !entry.used)
+            continue;
+        uint32_t age = now - entry.resolved;
+        if (age < entry.ttl - entry.ttl / 10)
+            continue;
+
+        //The old address stays valid until the result arrives
+        char buffer[96] = { '\0' };
+        sprintf(buffer, "AT+CDNSGIP=\"%s\",1,5000\r", entry.host);
+        entry.used = false;
+        dnsStats.refreshes++;
+        dnsRefresh = i;
+        dnsRefreshStart = now;
+        SendCommand(buffer, rxBuffer);
+        return;
+    }
+}
+
+//
+void SIM7080G::RefreshDNSDone(const char* line) {
+    SIM7080G_DNS_ENTRY& entry = dnsCache[dnsRefresh];
+    dnsRefresh = -1;
+
+    //Keep the old address if the refresh fails
+    char previous[16];
+    strcpy(previous, entry.ip);
+    uint32_t resolved = entry.resolved;
+    uint32_t ttl = entry.ttl;
+
+    dnsStats.lastLookupTime = millis() - dnsRefreshStart;
+    if (!ParseDNS(&entry, line) && millis() - resolved < ttl) {
+        strcpy(entry.ip, previous);
+        entry.resolved = resolved;
+        entry.ttl = ttl;
+    }
+}
+
+//
+bool SIM7080G::LookupHost(SIM7080G_DNS_ENTRY* entry) {
+    //A running refresh answers first
+    if (dnsRefresh >= 0) {
+        uint32_t waited = millis() - dnsRefreshStart;
+        rxBuffer[0] = '\0';
+        if (waited < 12000)
+            WaitForResponse("+CDNSGIP:", 12000 - waited);
+        if (dnsRefresh >= 0)
+            RefreshDNSDone(NULL);
+    }
+
+    char buffer[96] = { '\0' };
+    sprintf(buffer, "AT+CDNSGIP=\"%s\",1,5000\r", entry->host);
+
+    uint32_t start = millis();
+    SendCommand(buffer, rxBuffer, 1000);
+
+    bool resolved = WaitForResponse("+CDNSGIP:", 12000);
+    dnsStats.lastLookupTime = millis() - start;
+    return ParseDNS(entry, resolved ? strstr(rxBuffer, "+CDNSGIP:") : NULL);
+}
+
+//
+bool SIM7080G::ParseDNS(SIM7080G_DNS_ENTRY* entry, const char* line) {
+    //+CDNSGIP: 1,"<host>","<ip>"[,"<ip2>"] or +CDNSGIP: 0,<error>
+    bool resolved = line && line[10] == '1';
+    const char* startPtr = line;
+    entry->resolved = millis();
+    entry->ip[0] = '\0';
+
+    if (resolved) {
+        //Address is the 2nd quoted field
+        startPtr = strchr(startPtr, '\"');
+        startPtr = startPtr ? strchr(startPtr + 1, '\"') : NULL;
+        startPtr = startPtr ? strchr(startPtr + 1, '\"') : NULL;
+        size_t len = startPtr ? strcspn(startPtr + 1, "\"") : 0;
+        if (len >= 7 && len <= 15) {
+            memcpy(entry->ip, startPtr + 1, len);
+            entry->ip[len] = '\0';
+        }
+    }
+
+    if (entry->ip[0] == '\0') {
+        dnsStats.failures++;
+        entry->ttl = dnsNegativeTTL;
+#if SIM7080G_DEBUG_LEVEL >= 1
+        uartDebugInterface.printf("\tSIM7080G - DNS: Could not resolve %s\n", entry->host);
+#endif
+        return false;
+    }
+
+    entry->ttl = dnsTTL;
+#if SIM7080G_DEBUG_LEVEL >= 2
+    uartDebugInterface.printf("\tSIM7080G - DNS: %s -> %s (%u ms)\n", entry->host, entry->ip, dnsStats.lastLookupTime);
+#endif
+    return true;
+}
+
+//
+bool SIM7080G::IsIPv4(const char* address) {
+    uint8_t dots = 0;
+    size_t len = 0;
+
+    for (; address[len]; len++) {
+        if (address[len] == '.')
+            dots++;
+        else if (address[len] < '0' || address[len] > '9')
+            return false;
+    }
+
+    return dots == 3 && len >= 7 && len <= 15;
+}
+
+//
+void SIM7080G::ScanURC(const char* data) {
+    char line[SIM7080G_URC_BUFFER];
+
+    while (*data) {
+        //Skip line breaks
+        while (*data == '\r' || *data == '\n')
+            data++;
+
+        size_t len = strcspn(data, "\r\n");
+        if (!len)
+            break;
+
+        //Only URCs are of interest, they all start with + or *
+        if ((*data == '+' || *data == '*') && len < SIM7080G_URC_BUFFER) {
+            memcpy(line, data, len);
+            line[len] = '\0';
+            HandleURC(line);
+        }
+        data += len;
+    }
+}
+
+//
+void SIM7080G::HandleURC(const char* line) {
+#if SIM7080G_ENABLE_ASYNC
+    if (urcHook)
+        urcHook(urcHookContext, this, line);
+#endif
+
+    if (!strncmp(line, "+APP PDP: ", 10)) {
+        uint8_t pdidx = CharToNmbr((char*)line + 10);
+        bool deactive = strstr(line, ",DEACTIVE");
+        if (pdidx == linkConf.pdidx && deactive)
+            linkLost = true;
+
+#if SIM7080G_SHADOW
+        if (pdidx < SIM7080G_PDP_CONTEXTS) {
+            shadowAppn[pdidx] = !deactive;
+            shadowIP[pdidx][0] = '\0';
+            ShadowSet(SIM_SHADOW_APPN + pdidx);
+        }
+#endif
+        return;
+    }
+
+#if SIM7080G_SHADOW
+    //Status replies update the shadow state wherever they are received
+    if (!strncmp(line, "+CPIN: ", 7)) {
+        shadowPIN = !strncmp(line + 7, "READY", 5);
+        ShadowSet(SIM_SHADOW_PIN);
+        return;
+    }
+
+    if (!strncmp(line, "+CGNSPWR: ", 10)) {
+        shadowGNSS = line[10] - '0';
+        ShadowSet(SIM_SHADOW_GNSS);
+        return;
+    }
+
+    if (!strncmp(line, "+FTPSTATE: ", 11)) {
+        shadowFTP = line[11] - '0';
+        ShadowSet(SIM_SHADOW_FTP);
+        return;
+    }
+
+    //+FTPPUT: 1,<code>[,<max length>], code 1 keeps the session open
+    if (!strncmp(line, "+FTPPUT: 1,", 11)) {
+        shadowFTP = CharToNmbr((char*)line + 11) == 1;
+        ShadowSet(SIM_SHADOW_FTP);
+        return;
+    }
+
+    if (!strncmp(line, "+SHSTATE: ", 10)) {
+        shadowHTTP = line[10] - '0';
+        ShadowSet(SIM_SHADOW_HTTP);
+        return;
+    }
+
+    //+CNACT: <pdidx>,<statusx>,"<address>"
+    if (!strncmp(line, "+CNACT: ", 8)) {
+        uint8_t pdidx = line[8] - '0';
+        if (pdidx < SIM7080G_PDP_CONTEXTS && line[9] == ',') {
+            shadowAppn[pdidx] = line[10] - '0';
+            shadowIP[pdidx][0] = '\0';
+
+            const char* address = strchr(line, '\"');
+            size_t len = address ? strcspn(address + 1, "\"") : 0;
+            if (shadowAppn[pdidx] == 1 && len >= 7 && len <= 15) {
+                memcpy(shadowIP[pdidx], address + 1, len);
+                shadowIP[pdidx][len] = '\0';
+            }
+            ShadowSet(SIM_SHADOW_APPN + pdidx);
+        }
+        return;
+    }
+#endif
+
+    //+SNPING4: <seq>,<address>,<rtt>
+    if (!strncmp(line, "+SNPING4: ", 10)) {
+        const char* rttPtr = strrchr(line, ',');
+        if (pingResult && rttPtr)
+            PingReply(CharToNmbr((char*)rttPtr + 1));
+        return;
+    }
 
-    if(CharToNmbr(strchr(rxBuffer, ',') + 1) != dataLength)  {
-        #if SIM7080G_DEBUG_LEVEL >= 2
-        uartDebugInterface.printf("\tSIM7080G - FTP Upload: Requested and provided byte size not matched! Req: %u, prov: %u\n", CharToNmbr(strchr(rxBuffer, ',') + 1), dataLength);
-        #endif
+    //+CADATAIND: <cid>
+    if (!strncmp(line, "+CADATAIND: ", 12)) {
+        uint8_t id = CharToNmbr((char*)line + 12);
+        if (id < SIM7080G_MAX_SOCKETS && sockets[id].open)
+            sockets[id].dataPending = true;
+        return;
     }
 
-    #if SIM7080G_DEBUG_LEVEL >= 3
-    uartDebugInterface.printf("\tSIM7080G - FTP Upload: RX buffer: \n%s\n", rxBuffer);
-    #endif
+#if SIM7080G_ENABLE_MQTT
+    //+SMSUB: "<topic>","<message>"
+    if (!strncmp(line, "+SMSUB: \"", 9)) {
+        if (mqttInboxCount == SIM7080G_MQTT_INBOX) {
+            mqttStats.dropped++;
+            return;
+        }
 
-    //Send data to the server and update trackers
-    Send(src + dataSent, dataLength);
+        const char* topicPtr = line + 9;
+        const char* topicEnd = strstr(topicPtr, "\",\"");
+        const char* msgEnd = strrchr(line, '\"');
+        if (!topicEnd || msgEnd <= topicEnd + 2 || topicEnd - topicPtr >= SIM7080G_MQTT_TOPIC)
+            return;
 
-    //Wait for confirmation
-    if(!Receive((uint8_t*)rxBuffer, 0, 75000)) {
-        CloseFTPSession();
-        return SIM_FTP_TIMEOUT;
-    }
+        SIM7080G_MQTT_MSG& msg = mqttInbox[mqttInboxCount++];
+        memcpy(msg.topic, topicPtr, topicEnd - topicPtr);
+        msg.topic[topicEnd - topicPtr] = '\0';
 
-    startPtr = strchr(rxBuffer, ',') + 1;
-    responseCode = CharToNmbr(startPtr);
+        size_t length = msgEnd - (topicEnd + 3);
+        if (length > SIM7080G_MQTT_PAYLOAD)
+            length = SIM7080G_MQTT_PAYLOAD;
+        memcpy(msg.payload, topicEnd + 3, length);
+        msg.length = length;
+        msg.queued = millis();
 
-    #if SIM7080G_DEBUG_LEVEL >= 2
-    uartDebugInterface.printf("\tSIM7080G - FTP Upload: Status code: %u\n", rxBuffer[0]);
-    uartDebugInterface.printf("\tSIM7080G - FTP Upload: Put response code %d, bytes sent: %u\n", responseCode, dataSent);
-    #endif
-    #if SIM7080G_DEBUG_LEVEL >= 2
-    uartDebugInterface.printf("\tSIM7080G - FTP Upload: RX buffer: \n%s\n", rxBuffer);
-    #endif
+        mqttStats.received++;
+        return;
+    }
 
-    //Return if connection unsuccessful
-        if (responseCode > 1 && responseCode < 100)
-            return (SIM7080G_FTP_RESULT)responseCode;
-    
-    //End FTP transaction
-    SendCommand("AT+FTPPUT=2,0\r");
+    //+SMSTATE: 0 (connection to the broker lost)
+    if (!strncmp(line, "+SMSTATE: 0", 11)) {
+        mqttConnected = false;
+        return;
+    }
+#endif
 
-    //Wait for confirmation
-    if(!Receive((uint8_t*)rxBuffer, 0, 75000)) {
-        CloseFTPSession();
-        return SIM_FTP_TIMEOUT;
+    //+CASTATE: <cid>,<state> (0: closed by the remote side)
+    if (!strncmp(line, "+CASTATE: ", 10)) {
+        uint8_t id = CharToNmbr((char*)line + 10);
+        const char* statePtr = strchr(line, ',');
+        if (id < SIM7080G_MAX_SOCKETS && statePtr && statePtr[1] == '0') {
+            sockets[id].open = false;
+            sockets[id].closePending = true;
+        }
+        return;
     }
 
-    //Get response code from received data
-    responseCode = CharToNmbr(startPtr);
+    //+CDNSGIP: 1,"<host>","<ip>" or +CDNSGIP: 0,<error> of a running refresh
+    if (!strncmp(line, "+CDNSGIP: ", 10)) {
+        if (dnsRefresh >= 0) {
+            const char* host = dnsCache[dnsRefresh].host;
+            const char* hostPtr = strchr(line, '\"');
+            size_t hostLength = strlen(host);
+            if (line[10] != '1' || (hostPtr && !strncmp(hostPtr + 1, host, hostLength) && hostPtr[hostLength + 1] == '\"'))
+                RefreshDNSDone(line);
+        }
+        return;
+    }
 
-    #if SIM7080G_DEBUG_LEVEL >= 2
-    uartDebugInterface.printf("\tSIM7080G - FTP Upload: Put response code: %u\n", responseCode);
-    #endif
-    #if SIM7080G_DEBUG_LEVEL >= 3
-    uartDebugInterface.printf("\tSIM7080G - FTP Upload: RX buffer: \n%s\n", rxBuffer);
-    #endif
+    //+CPSMSTATUS: "ENTER PSM" / "EXIT PSM"
+    if (!strncmp(line, "+CPSMSTATUS: ", 13)) {
+        const char* statePtr = line + 13;
+        if (*statePtr == '\"')
+            statePtr++;
+        bool enter = toupper(statePtr[1]) == 'N';
+
+        uint32_t now = millis();
+        if (enter && !psmActive) {
+            psmActive = true;
+            psmEnterTime = now;
+            psmStats.entries++;
+        }
+        else if (!enter && psmActive) {
+            psmActive = false;
+            psmStats.psmTime += now - psmEnterTime;
+            //WakeFromPSM() might have started the measurement already
+            if (!psmWakePending) {
+                psmWakeStart = now;
+                psmWakePending = true;
+            }
+        }
+        return;
+    }
 
-    //Return if connection unsuccessful
-        if (responseCode > 0)
-            return (SIM7080G_FTP_RESULT)responseCode;
+    //+CEREG: <stat>,... (AT+CEREG=4)
+    if (!strncmp(line, "+CEREG: ", 8)) {
+        //Not registered (1: home network, 5: roaming), the cached band may be gone
+        if (netLocked && line[8] != '1' && line[8] != '5')
+            netUnlock = true;
+        ParseCEREG(line);
+        return;
+    }
 
-    startPtr = strchr(rxBuffer, ' ') + 1;
-    if (*startPtr == '1' &&  CharToNmbr(strchr(startPtr, ',') + 1) == 0) {
-        #if SIM7080G_DEBUG_LEVEL == 1
-        uartDebugInterface.printf("\tSIM7080G - FTP Upload: Successful!\n", length);
-        #elif SIM7080G_DEBUG_LEVEL >= 2
-        uartDebugInterface.printf("\tSIM7080G - FTP Upload: Session successful!\n");
-        #endif
-        return SIM_FTP_SUCCESS;
+    //+CEDRXP: <AcT-type>,<Requested_eDRX_value>,<NW-provided_eDRX_value>,<Paging_time_window>
+    if (!strncmp(line, "+CEDRXP: ", 9)) {
+        ParseEDRX(line);
+        return;
     }
 
-    //Upload was not confirmed to be successful
-    return SIM_FTP_UPL_ERR;
+    //*PSUTTZ: <yy>/<MM>/<dd>,<hh>:<mm>:<ss>",<zone>,<dst> (UTC, AT+CLTS=1)
+    if (!strncmp(line, "*PSUTTZ: ", 9)) {
+        const char* timePtr = line[9] == '\"' ? line + 10 : line + 9;
+        int year, month, day, hour, minute, second;
+        if (sscanf(timePtr, "%d/%d/%d,%d:%d:%d", &year, &month, &day, &hour, &minute, &second) == 6) {
+            if (year < 100)
+                year += year < 80 ? 2000 : 1900;
+            uint64_t unixMs = UnixMillis(year, month, day, hour, minute, second);
+
+            //Whole seconds, the URC arrived at some point since ReadURC() last emptied the UART
+            uint32_t now = millis();
+            uint32_t waited = now - urcDrained;
+            if (unixMs)
+                TimeSample(unixMs + 500 + waited / 2, now, 500 + waited / 2, SIM_TIME_NETWORK);
+        }
+        return;
+    }
 }
 
-//Will be implemented later
-//SIM7080G_FTP_RESULT SIM7080G::FTPDownload(uint8_t* dst, size_t* bytesReceived) {}
-
-//Will be implemented later
-//SIM7080G_FTP_RESULT SIM7080G::DeleteFTPFile(void) {}//
+#if SIM7080G_ENABLE_ASYNC
+//
+void SIM7080G::CommandLine(const char* line) {
+    //Discard the response of an abandoned command, its result code frees the slot
+    if (asyncDraining) {
+        if (!strcmp(line, "0") || !strcmp(line, "OK") || !strcmp(line, "4") || !strcmp(line, "ERROR") || !strncmp(line, "+CME ERROR", 10)) {
+            asyncState = SIM_ASYNC_IDLE;
+            asyncDraining = false;
+        }
+        return;
+    }
 
-//Will be implemented later
-//size_t SIM7080G::GetFTPFileSize(void) {}
+    size_t len = strlen(line);
+    if (asyncLength + len + 2 < SIM7080G_ASYNC_BUFFER) {
+        memcpy(asyncResponse + asyncLength, line, len);
+        asyncLength += len;
+        asyncResponse[asyncLength++] = '\r';
+        asyncResponse[asyncLength++] = '\n';
+        asyncResponse[asyncLength] = '\0';
+    }
 
-//
-uint8_t SIM7080G::GetFTPState(void) {
-    SendCommand("AT+FTPSTATE\r", rxBuffer);
-    char* startPtr = strchr(rxBuffer, ' ');
-    if(!strchr(rxBuffer, ' '))
-        return 0;
-    return *(startPtr + 1) - '0';
+    //Numeric (ATV0) or verbose result codes
+    if (!strcmp(line, "0") || !strcmp(line, "OK"))
+        asyncState = SIM_ASYNC_OK;
+    else if (!strcmp(line, "4") || !strcmp(line, "ERROR") || !strncmp(line, "+CME ERROR", 10))
+        asyncState = SIM_ASYNC_ERROR;
+    else if (asyncUntil[0] && !strncmp(line, asyncUntil, strlen(asyncUntil)))
+        asyncState = SIM_ASYNC_OK;
 }
+#endif
 
+#if SIM7080G_SHADOW
 //
-//bool SIM7080G::MkFTPDir(void) {}
-
-//
-//bool SIM7080G::RmFTPDir(void) {}
+bool SIM7080G::ShadowFresh(uint8_t field, bool count) {
+    bool fresh = (shadowValid & (1 << field)) && millis() - shadowTime[field] < shadowTTL;
+    if (count) {
+        if (fresh)
+            shadowStats.hits++;
+        else
+            shadowStats.misses++;
+    }
+    return fresh;
+}
 
 //
-void SIM7080G::CloseFTPSession() {
-    SendCommand("AT+FTPQUIT\r");
+void SIM7080G::ShadowSet(uint8_t field) {
+    shadowValid |= 1 << field;
+    shadowTime[field] = millis();
 }
-
-//  #
-//  #   GNSS Application
-//  #
+#endif
 
 //
-bool SIM7080G::PowerUpGNSS() { return GetGNSSPower() ? true : SendCommand("AT+CGNSPWR=1\r"); }
+void SIM7080G::ShadowBoot() {
+    InvalidateShadow(true);
+#if SIM7080G_SHADOW
+    bootCounting = true;
+    bootStart = millis();
+    shadowStats.bootRoundTrips = 0;
+    shadowStats.bootTime = 0;
+#endif
+}
 
 //
-bool SIM7080G::PowerDownGNSS() { return GetGNSSPower() ? SendCommand("AT+CGNSPWR=0\r") : true; }
+void SIM7080G::ReadIdentity(const char* command, char* dst, size_t len) {
+    //Does not change until the next boot
+    if (dst[0]) {
+#if SIM7080G_SHADOW
+        shadowStats.hits++;
+#endif
+        return;
+    }
 
-//
-uint8_t SIM7080G::GetGNSSPower() {
-    size_t bytesRecv = SendCommand("AT+CGNSPWR?\r", rxBuffer);
-    uint8_t status = rxBuffer[bytesRecv - 5] - '0';
-#if SIM7080G_DEBUG_LEVEL >= 1
-    uartDebugInterface.printf("\tSIM7080G - GNSS Power status: %d\n", status);
+#if SIM7080G_SHADOW
+    shadowStats.misses++;
 #endif
-    return status;
+    if (!SendCommand(command))
+        return;
+
+    //First line that is neither the echo nor the result code
+    const char* startPtr = rxBuffer;
+    while (*startPtr) {
+        startPtr += strspn(startPtr, "\r\n");
+        size_t lineLength = strcspn(startPtr, "\r\n");
+        if (!lineLength)
+            break;
+
+        if (strncmp(startPtr, "AT", 2) && !(lineLength == 1 && *startPtr == '0')) {
+            //Skip a label like "Revision:"
+            const char* colon = (const char*)memchr(startPtr, ':', lineLength);
+            if (colon) {
+                lineLength -= colon + 1 - startPtr;
+                startPtr = colon + 1;
+                while (lineLength && *startPtr == ' ') {
+                    startPtr++;
+                    lineLength--;
+                }
+            }
+
+            if (lineLength >= len)
+                lineLength = len - 1;
+            memcpy(dst, startPtr, lineLength);
+            dst[lineLength] = '\0';
+            return;
+        }
+        startPtr += lineLength;
+    }
 }
 
 //
-bool SIM7080G::ColdStartGNSS() { return GetGNSSPower() ? true : SendCommand("AT+CGNSCOLD\r", 2000); }
+void SIM7080G::ParseCEREG(const char* line) {
+    //Quoted fields in order: <tac>, <ci>, <Active-Time>, <Periodic-TAU>
+    char fields[4][9] = { { '\0' } };
+    uint8_t count = 0;
+
+    for (const char* ptr = strchr(line, '\"'); ptr && count < 4; count++) {
+        const char* end = strchr(ptr + 1, '\"');
+        if (!end)
+            break;
+        size_t length = end - ptr - 1;
+        if (length < sizeof(fields[0])) {
+            memcpy(fields[count], ptr + 1, length);
+            fields[count][length] = '\0';
+        }
+        ptr = strchr(end + 1, '\"');
+    }
 
-//
-bool SIM7080G::WarmStartGNSS() { return GetGNSSPower() ? true : SendCommand("AT+CGNSWARM\r", 2000); }
+    if (count < 4 || strlen(fields[2]) != 8 || strlen(fields[3]) != 8) {
+        psmGrant.psm = false;
+        return;
+    }
 
-//
-bool SIM7080G::HotStartGNSS() { return GetGNSSPower() ? true : SendCommand("AT+CGNSHOT\r", 2000); }
+    psmGrant.activeTime = DecodePSMTimer(fields[2], false);
+    psmGrant.tau = DecodePSMTimer(fields[3], true);
+    psmGrant.psm = psmGrant.activeTime != UINT32_MAX && psmGrant.tau != UINT32_MAX;
+}
 
 //
-void SIM7080G::GetGNSS(SIM7080G_GNSS* dst) {
+void SIM7080G::ParseEDRX(const char* line) {
+    //Skip <AcT-type>, <Requested_eDRX_value>
+    const char* ptr = strchr(line, ',');
+    ptr = ptr ? strchr(ptr + 1, ',') : nullptr;
+    const char* ptwPtr = ptr ? strchr(ptr + 1, ',') : nullptr;
+    if (!ptwPtr) {
+        psmGrant.edrx = false;
+        return;
+    }
 
-    //Get GNSS info from device
-    size_t bytesrecv = SendCommand("AT+CGNSINF\r", rxBuffer);
+    const uint16_t cycles[] = { 1, 2, 4, 8, 12, 16, 20, 24, 28, 32, 64, 128, 256, 512, 1024, 2048 };
+    long cycle = BitsToNmbr(ptr + 1, 4);
+    long ptw = BitsToNmbr(ptwPtr + 1, 4);
 
-#if SIM7080G_DEBUG_LEVEL >= 1
-    uartDebugInterface.printf("\tSIM7080G - GNSS update requested: %s\n", rxBuffer);
-#endif
-    
-    uint8_t comas = 0;      //Track comas in response text
-    uint8_t infCntr = 0;    //For indexing SIM7080G_GNSS arrays
+    psmGrant.edrx = cycle >= 0;
+    psmGrant.edrxCycle = cycle >= 0 ? (uint32_t)cycles[cycle] * 5120 : 0;
+    psmGrant.ptw = ptw >= 0 ? (ptw + 1) * (edrxAct == SIM_EDRX_NBIOT ? 2560 : 1280) : 0;
+}
 
-    for (uint8_t i = 0; i < bytesrecv; i++) {
-        if(rxBuffer[i] == ','){
-            comas++;
-            infCntr = 0;
-            continue;
+//
+void SIM7080G::EncodePSMTimer(uint32_t seconds, bool tau, char* dst) {
+    //Units in ascending order with their 3 bit codes (TS 24.008 GPRS Timer 2 / 3)
+    const uint32_t tauUnits[] = { 2, 30, 60, 600, 3600, 36000, 1152000 };
+    const uint8_t tauCodes[] = { 3, 4, 5, 0, 1, 2, 6 };
+    const uint32_t activeUnits[] = { 2, 60, 360 };
+    const uint8_t activeCodes[] = { 0, 1, 2 };
+
+    const uint32_t* units = tau ? tauUnits : activeUnits;
+    const uint8_t* codes = tau ? tauCodes : activeCodes;
+    uint8_t count = tau ? 7 : 3;
+
+    //Smallest unit that fits, value rounded up
+    uint8_t unit = count - 1;
+    uint32_t value = 31;
+    for (uint8_t i = 0; i < count; i++) {
+        uint32_t n = (seconds + units[i] - 1) / units[i];
+        if (n <= 31) {
+            unit = i;
+            value = n;
+            break;
         }
+    }
 
-        //
-        switch (comas)
-        {
-        case 0:     //GNSS Run status
-            dst->run = rxBuffer[i] - '0';
-            break;
+    uint8_t timer = (codes[unit] << 5) | value;
+    for (uint8_t i = 0; i < 8; i++)
+        dst[i] = (timer & (0x80 >> i)) ? '1' : '0';
+    dst[8] = '\0';
+}
 
-        case 2:     //UTC date & time
-            dst->datetime[infCntr++] = rxBuffer[i];
-            break;
+//
+uint32_t SIM7080G::DecodePSMTimer(const char* bits, bool tau) {
+    const uint32_t tauUnits[] = { 600, 3600, 36000, 2, 30, 60, 1152000, 0 };
+    const uint32_t activeUnits[] = { 2, 60, 360, 0, 0, 0, 0, 0 };
+
+    long timer = BitsToNmbr(bits, 8);
+    if (timer < 0)
+        return UINT32_MAX;
+
+    //Unit 7: timer deactivated
+    uint32_t unit = (tau ? tauUnits : activeUnits)[timer >> 5];
+    if (!unit)
+        return UINT32_MAX;
+    return unit * (timer & 0x1F);
+}
 
-        case 3:     //Latitude
-            dst->latitude[infCntr++] = rxBuffer[i];
-            break;
+//
+char* SIM7080G::FindAppNetwork(uint8_t pdidx) {
+    char token[12] = { '\0' };
+    sprintf(token, "+CNACT: %u,", pdidx);
+    char* startPtr = strstr(rxBuffer, token);
+    return startPtr ? startPtr + strlen(token) : NULL;
+}
 
-        case 4:     //Longitude
-            dst->longitude[infCntr++] = rxBuffer[i];
-            break;
-        
-        case 14:    //GPS Satellites in view
-            dst->gpsSat = (rxBuffer[i] - '0') + (infCntr++ ? 1 : 0) * 10;
-            break;
+//
+bool SIM7080G::ProbeLink(void) {
+    linkStats.probes++;
 
-        case 15:    //GNSS Satellites in view
-            dst->gnssSat = (rxBuffer[i] - '0') + (infCntr++ ? 1 : 0) * 10;
-            break;
+    if (Ping4(linkConf.probeAddress, 1, 32, linkConf.probeTimeout) > 0)
+        return true;    //Ping4 refreshes linkLastTraffic
 
-        case 16:    //GNSS Satellites in view
-            dst->glonassSat = (rxBuffer[i] - '0') + (infCntr++ ? 1 : 0) * 10;
-            break;
+    linkStats.probeFailures++;
+    return false;
+}
 
-        default:
-            break;
-        }
+//
+void SIM7080G::EscalateLink(void) {
+    //Recovery starts at the first failure
+    if (!linkRecovering) {
+        linkRecovering = true;
+        linkRecoveryStart = millis();
     }
+    linkProbeFails = 0;
+    linkAttempts++;
 
+    if (linkAttempts <= linkConf.reactivateAttempts)
+        linkState = SIM_LINK_REACTIVATE;
+    else if (linkAttempts <= linkConf.reactivateAttempts + linkConf.cfunAttempts)
+        linkState = SIM_LINK_CFUN_CYCLE;
+    else
+        linkState = SIM_LINK_REBOOT;
 }
 
 //
-SIM7080G_GNSS SIM7080G::GetGNSS(void) {
-    SIM7080G_GNSS gnssInfo;
-    GetGNSS(&gnssInfo);
-    return gnssInfo;
+void SIM7080G::LinkRecovered(uint32_t now) {
+    if (linkRecovering) {
+        uint32_t recoveryTime = now - linkRecoveryStart;
+        linkStats.recoveries++;
+        linkStats.lastRecoveryTime = recoveryTime;
+        linkStats.totalRecoveryTime += recoveryTime;
+        if (recoveryTime > linkStats.maxRecoveryTime)
+            linkStats.maxRecoveryTime = recoveryTime;
+        linkRecovering = false;
+    }
+
+    linkAttempts = 0;
+    linkProbeFails = 0;
+    linkLastTraffic = now;
+    linkState = SIM_LINK_UP;
 }
 
 //
-bool SIM7080G::GetGNSSLock(void) {
-    SIM7080G_GNSS gnssInfo;
-    GetGNSS(&gnssInfo);
-    return gnssInfo.datetime[0] != 0 && (gnssInfo.latitude[0] == '\0' || strcmp(gnssInfo.latitude, "0.000000"));
-}
+bool SIM7080G::WaitRegistration(uint32_t timeout) {
+    uint32_t start = millis();
+    do {
+        //+CEREG: <n>,<stat>[,...], 1: home network, 5: roaming
+        SendCommand("AT+CEREG?\r", rxBuffer);
+        char* startPtr = strstr(rxBuffer, "+CEREG: ");
+        startPtr = startPtr ? strchr(startPtr, ',') : nullptr;
+        if (startPtr && (startPtr[1] == '1' || startPtr[1] == '5'))
+            return true;
+
+        if (timeout)
+            delay(500);
+    } while (millis() - start < timeout);
 
+    return false;
+}
 
+#if SIM7080G_ENABLE_CMUX
 //  #
-//  #   Power
+//  #   CMUX virtual channel
 //  #
 
-uint16_t SIM7080G::GetVBat(void) {
-    SendCommand("AT+CBC\r", rxBuffer);
-    uint16_t vBat = CharToNmbr(strchr(strchr(rxBuffer, ',') + 1, ',') + 1);
-#if SIM7080G_DEBUG_LEVEL >= 1
-    uartDebugInterface.printf("\tSIM7080G - Battery voltage: %u\n", vBat);
-#endif
-    return vBat;
+//
+int SIM7080G_CMUX_CHANNEL::available() {
+    owner->CMUXPoll();
+    return rxCount;
 }
 
-//  #
-//  #   Private functions
-//  #
+//
+int SIM7080G_CMUX_CHANNEL::read() {
+    //Channels are read outside of command transactions, the ring shares the multiplexer lock
+#if SIM7080G_THREAD_SAFE
+    xSemaphoreTakeRecursive(owner->cmuxMutex, portMAX_DELAY);
+#endif
+
+    if (!rxCount)
+        owner->CMUXPoll();
+
+    int c = -1;
+    if (rxCount) {
+        c = rxBuffer[rxHead];
+        rxHead = (rxHead + 1) % SIM7080G_CMUX_BUFFER;
+        rxCount--;
+
+        //Let the module send again once the buffer has drained
+        if (localFC && rxCount < SIM7080G_CMUX_BUFFER / 4)
+            owner->CMUXFlowControl(dlci, false);
+    }
+
+#if SIM7080G_THREAD_SAFE
+    xSemaphoreGiveRecursive(owner->cmuxMutex);
+#endif
+    return c;
+}
 
 //
-void SIM7080G::PowerCycle() {
-    pinMode(pwrKey, OUTPUT);
-    digitalWrite(pwrKey, LOW);
-    delay(1100);
-    digitalWrite(pwrKey, HIGH);
-    pinMode(pwrKey, INPUT);     //Leave pin floating
+int SIM7080G_CMUX_CHANNEL::peek() {
+#if SIM7080G_THREAD_SAFE
+    xSemaphoreTakeRecursive(owner->cmuxMutex, portMAX_DELAY);
+#endif
+
+    if (!rxCount)
+        owner->CMUXPoll();
+    int c = rxCount ? rxBuffer[rxHead] : -1;
+
+#if SIM7080G_THREAD_SAFE
+    xSemaphoreGiveRecursive(owner->cmuxMutex);
+#endif
+    return c;
 }
 
 //
-void SIM7080G::EraseRXBuff(uint32_t value) {
-    size_t rounds = this->uartMaxRecvSize / 4;
-    //Erase buffer with 32 bit numbers for efficiency
-    for(size_t i = 0; i < rounds; i+=4)
-        rxBuffer[i] = value;
+size_t SIM7080G_CMUX_CHANNEL::write(uint8_t c) {
+    return owner->CMUXWrite(dlci, &c, 1);
 }
 
 //
-bool SIM7080G::AddHTTPContent(const char* type, const char* value, const char* command) {
-    if (type == NULL || value == NULL || command == NULL)
-        return false;
-    
-    char buffer[SIM7080G_HTTP_REQ_BUFFER] = { '\0' };
+size_t SIM7080G_CMUX_CHANNEL::write(const uint8_t* buffer, size_t size) {
+    return owner->CMUXWrite(dlci, buffer, size);
+}
 
-    sprintf(buffer, "%s=\"%s\",\"%s\"\r", command, type, value);
-    
-    return SendCommand(buffer);
+//
+bool SIM7080G_CMUX_CHANNEL::IsOpen() const {
+    return open;
 }
+#endif
 
+//  #
+//  #   Scoped lock
+//  #
 
+//
+SIM7080G_LOCK::SIM7080G_LOCK(SIM7080G* modem, SIM7080G_LANE lane, uint32_t timeout) : modem(modem) {
+    held = modem->Lock(lane, timeout);
+}
 
+//
+SIM7080G_LOCK::~SIM7080G_LOCK() {
+    if (held)
+        modem->Unlock();
+}
 
+//
+bool SIM7080G_LOCK::Held() const {
+    return held;
+}
@@ -2,6 +2,7 @@
 #define SIM7080G_H
 
 #include <stdio.h>
+#include <atomic>
 #include <Arduino.h>
 
 //DEPRECATED!!
@@ -16,8 +17,217 @@
  *      - 2: Debug most of the functions
  *      - 3: In depth debug messages about (almost) everything
 */
+#ifndef SIM7080G_DEBUG_LEVEL
 #define SIM7080G_DEBUG_LEVEL                1
-#define SIM7080G_HTTP_REQ_BUFFER            512     //HTTP request configuration buffer size
+#endif
+
+/*
+ *  Buffer sizes and subsystems
+ *      Every value can be overridden from the build flags (e.g. -DSIM7080G_ENABLE_FTP=0).
+ *      Disabled subsystems cost neither flash nor RAM, SIM7080G::ReportFootprint() prints
+ *      the RAM used by a configuration.
+*/
+#ifndef SIM7080G_RX_BUFFER
+#define SIM7080G_RX_BUFFER                  4096    //Command response buffer size (must be divisible by 4)
+#endif
+#ifndef SIM7080G_ENABLE_HTTP
+#define SIM7080G_ENABLE_HTTP                1       //HTTP(S) client (0: compiled out)
+#endif
+#ifndef SIM7080G_ENABLE_FTP
+#define SIM7080G_ENABLE_FTP                 1       //FTP client (0: compiled out)
+#endif
+#ifndef SIM7080G_ENABLE_GNSS
+#define SIM7080G_ENABLE_GNSS                1       //GNSS application (0: compiled out)
+#endif
+#ifndef SIM7080G_ENABLE_MQTT
+#define SIM7080G_ENABLE_MQTT                1       //MQTT client (0: compiled out)
+#endif
+#ifndef SIM7080G_ENABLE_COAP
+#define SIM7080G_ENABLE_COAP                1       //CoAP client (0: compiled out)
+#endif
+#ifndef SIM7080G_ENABLE_CMUX
+#define SIM7080G_ENABLE_CMUX                1       //GSM 07.10 multiplexer (0: compiled out)
+#endif
+#ifndef SIM7080G_ENABLE_ASYNC
+#define SIM7080G_ENABLE_ASYNC               1       //Non-blocking command slot and URC hook, used by sim7080g_co.h (0: compiled out)
+#endif
+#ifndef SIM7080G_HTTP_REQ_BUFFER
+#define SIM7080G_HTTP_REQ_BUFFER            512     //Command build buffer size (longest command incl. HTTP URLs and header values)
+#endif
+#ifndef SIM7080G_UART_RX_FIFO
+#define SIM7080G_UART_RX_FIFO               4096    //Host UART driver receive buffer size (absorbs bursts while the application is busy)
+#endif
+#ifndef SIM7080G_URC_BUFFER
+#define SIM7080G_URC_BUFFER                 256     //Unsolicited result code line buffer size (must fit inbound MQTT messages)
+#endif
+#ifndef SIM7080G_PDP_CONTEXTS
+#define SIM7080G_PDP_CONTEXTS               4       //Number of APP network PDP contexts supported by the module (pdidx 0-3)
+#endif
+#ifndef SIM7080G_MAX_SOCKETS
+#define SIM7080G_MAX_SOCKETS                13      //Number of concurrent TCP/UDP connections supported by the module (cid 0-12)
+#endif
+#ifndef SIM7080G_SOCKET_RX_BUFFER
+#define SIM7080G_SOCKET_RX_BUFFER           256     //Per socket receive buffer size
+#endif
+#ifndef SIM7080G_SOCKET_MAX_SEND
+#define SIM7080G_SOCKET_MAX_SEND            1460    //Max bytes per AT+CASEND / AT+CARECV
+#endif
+#ifndef SIM7080G_MQTT_TOPIC
+#define SIM7080G_MQTT_TOPIC                 64      //Max MQTT topic length (including null terminator)
+#endif
+#ifndef SIM7080G_MQTT_PAYLOAD
+#define SIM7080G_MQTT_PAYLOAD               128     //Max queued / received MQTT payload length
+#endif
+#ifndef SIM7080G_MQTT_QUEUE
+#define SIM7080G_MQTT_QUEUE                 4       //Number of MQTT messages that can be queued for a batched publish
+#endif
+#ifndef SIM7080G_MQTT_INBOX
+#define SIM7080G_MQTT_INBOX                 2       //Number of received MQTT messages held until Loop() delivers them
+#endif
+#ifndef SIM7080G_MQTT_SUBS
+#define SIM7080G_MQTT_SUBS                  4       //Number of MQTT subscriptions with callbacks
+#endif
+#ifndef SIM7080G_TLS_CERTS
+#define SIM7080G_TLS_CERTS                  4       //Number of uploaded certificates tracked for change detection
+#endif
+#ifndef SIM7080G_TLS_FAST_RATIO
+#define SIM7080G_TLS_FAST_RATIO             60      //Handshakes faster than this percentage of a slow one count as fast
+#endif
+#ifndef SIM7080G_DNS_CACHE
+#define SIM7080G_DNS_CACHE                  4       //Number of cached host name resolutions
+#endif
+#ifndef SIM7080G_DNS_TTL
+#define SIM7080G_DNS_TTL                    300000  //Default lifetime of a resolved address in ms (the module does not report record TTLs)
+#endif
+#ifndef SIM7080G_DNS_NEGATIVE_TTL
+#define SIM7080G_DNS_NEGATIVE_TTL           30000   //Lifetime of a failed resolution in ms
+#endif
+#ifndef SIM7080G_PING_BUCKETS
+#define SIM7080G_PING_BUCKETS               60      //RTT histogram buckets (4 per power of two, covers 0-65535 ms)
+#endif
+#ifndef SIM7080G_COAP_BUFFER
+#define SIM7080G_COAP_BUFFER                256     //Max CoAP message size (header, options and one block of payload)
+#endif
+#ifndef SIM7080G_COAP_BLOCK_SZX
+#define SIM7080G_COAP_BLOCK_SZX             2       //CoAP block size exponent, block size is 2^(SZX + 4): 2 -> 64 bytes
+#endif
+#ifndef SIM7080G_COAP_ACK_TIMEOUT
+#define SIM7080G_COAP_ACK_TIMEOUT           2000    //CoAP ACK_TIMEOUT in ms (RFC 7252)
+#endif
+#ifndef SIM7080G_COAP_MAX_RETRANSMIT
+#define SIM7080G_COAP_MAX_RETRANSMIT        4       //CoAP MAX_RETRANSMIT (RFC 7252)
+#endif
+#ifndef SIM7080G_COAP_RESPONSE_TIMEOUT
+#define SIM7080G_COAP_RESPONSE_TIMEOUT      30000   //Max time to wait for a separate or non-confirmable response in ms
+#endif
+#ifndef SIM7080G_CMUX_CHANNELS
+#define SIM7080G_CMUX_CHANNELS              3       //Number of GSM 07.10 virtual channels (DLCI 1-3, DLCI 1 carries the driver's commands)
+#endif
+#ifndef SIM7080G_CMUX_BUFFER
+#define SIM7080G_CMUX_BUFFER                512     //Per channel receive buffer size
+#endif
+#ifndef SIM7080G_CMUX_N1
+#define SIM7080G_CMUX_N1                    127     //Max information field length of sent frames
+#endif
+#ifndef SIM7080G_CMUX_FC_TIMEOUT
+#define SIM7080G_CMUX_FC_TIMEOUT            1000    //Max time a channel write waits for the module to lift flow control in ms
+#endif
+#ifndef SIM7080G_ASYNC_BUFFER
+#define SIM7080G_ASYNC_BUFFER               256     //Response buffer of the non-blocking command
+#endif
+#ifndef SIM7080G_ASYNC_DRAIN
+#define SIM7080G_ASYNC_DRAIN                10000   //Max time an abandoned command keeps the slot busy until its result code arrives in ms
+#endif
+#ifndef SIM7080G_METRICS
+#define SIM7080G_METRICS                    1       //Per command family counters and latency histograms in the command path (0: compiled out)
+#endif
+#ifndef SIM7080G_METRICS_FAMILIES
+#define SIM7080G_METRICS_FAMILIES           16      //Number of tracked command families (the last one collects the rest)
+#endif
+#ifndef SIM7080G_METRICS_BUCKETS
+#define SIM7080G_METRICS_BUCKETS            17      //Latency histogram buckets (log2 of ms, the last one collects >= 32768 ms)
+#endif
+#ifndef SIM7080G_METRICS_TRACE
+#define SIM7080G_METRICS_TRACE              64      //Number of recent commands kept for the trace export
+#endif
+#ifndef SIM7080G_TRACE
+#define SIM7080G_TRACE                      1       //Binary event trace for polled status functions (0: compiled out)
+#endif
+#ifndef SIM7080G_TRACE_EVENTS
+#define SIM7080G_TRACE_EVENTS               64      //Trace ring size (power of two)
+#endif
+#ifndef SIM7080G_SHADOW
+#define SIM7080G_SHADOW                     1       //Answer status getters from state learned by commands and URCs (0: compiled out)
+#endif
+#ifndef SIM7080G_SHADOW_TTL
+#define SIM7080G_SHADOW_TTL                 30000   //Default time a learned state answers getters in ms
+#endif
+#ifndef SIM7080G_BOOT_TIMEOUT
+#define SIM7080G_BOOT_TIMEOUT               10000   //Max time from PWRKEY release to the module answering in ms
+#endif
+#ifndef SIM7080G_BOOT_PROBE
+#define SIM7080G_BOOT_PROBE                 100     //Time between AT probes while the module boots in ms
+#endif
+#ifndef SIM7080G_PSM_WAKE_PULSE
+#define SIM7080G_PSM_WAKE_PULSE             100     //PWRKEY low time waking the module from PSM in ms (well below the power off pulse)
+#endif
+#ifndef SIM7080G_NET_STORE
+#define SIM7080G_NET_STORE                  1       //Keep the last serving network per SIM in ESP32 Preferences (0: the application persists it)
+#endif
+#ifndef SIM7080G_REG_CACHED_TIMEOUT
+#define SIM7080G_REG_CACHED_TIMEOUT         30000   //Time a registration restricted to the last serving network may take in ms
+#endif
+#ifndef SIM7080G_CATM_BANDS
+#define SIM7080G_CATM_BANDS                 "1,2,3,4,5,8,12,13,14,18,19,20,25,26,27,28,31,66,72,73,85"     //LTE-M bands scanned without a cached network
+#endif
+#ifndef SIM7080G_NBIOT_BANDS
+#define SIM7080G_NBIOT_BANDS                "1,2,3,4,5,8,12,13,18,19,20,25,26,28,31,66,71,72,73,85"        //NB-IoT bands scanned without a cached network
+#endif
+#ifndef SIM7080G_RAT_SITES
+#define SIM7080G_RAT_SITES                  8       //Number of sites (PLMN and tracking area) with RAT measurements kept per SIM in Preferences
+#endif
+#ifndef SIM7080G_RAT_LOG
+#define SIM7080G_RAT_LOG                    16      //Number of RAT decisions kept
+#endif
+#ifndef SIM7080G_SIGNAL_SAMPLES
+#define SIM7080G_SIGNAL_SAMPLES             32      //Signal samples kept (ring buffer)
+#endif
+#ifndef SIM7080G_SIGNAL_INTERVAL
+#define SIM7080G_SIGNAL_INTERVAL            10000   //Default time between signal samples taken by Loop() in ms
+#endif
+#ifndef SIM7080G_SIGNAL_ALPHA
+#define SIM7080G_SIGNAL_ALPHA               25      //Weight of a new sample in the smoothed signal in percent
+#endif
+#ifndef SIM7080G_CE1_RSRP
+#define SIM7080G_CE1_RSRP                   -110    //RSRP below which coverage enhancement level 1 is assumed in dBm
+#endif
+#ifndef SIM7080G_CE2_RSRP
+#define SIM7080G_CE2_RSRP                   -120    //RSRP below which coverage enhancement level 2 is assumed in dBm
+#endif
+#ifndef SIM7080G_TX_QUEUE
+#define SIM7080G_TX_QUEUE                   4       //Number of deferred transmissions
+#endif
+#ifndef SIM7080G_TIME_MAX_ERROR
+#define SIM7080G_TIME_MAX_ERROR             2000    //Default bound of the clock error in ms, timestamps are refused beyond it
+#endif
+#ifndef SIM7080G_TIME_DRIFT_PPM
+#define SIM7080G_TIME_DRIFT_PPM             100     //Host clock drift assumed until it is measured in ppm
+#endif
+#ifndef SIM7080G_TIME_RESIDUAL_PPM
+#define SIM7080G_TIME_RESIDUAL_PPM          10      //Error of the measured drift in ppm
+#endif
+#ifndef SIM7080G_TIME_RETRY
+#define SIM7080G_TIME_RETRY                 60000   //Time between automatic synchronisation attempts in ms
+#endif
+#ifndef SIM7080G_NTP_SERVER
+#define SIM7080G_NTP_SERVER                 "pool.ntp.org"  //Default NTP server
+#endif
+#ifndef SIM7080G_MAX_INSTANCES
+#define SIM7080G_MAX_INSTANCES              8       //Number of driver instances serviced by PollAll() and the worker task
+#endif
+#ifndef SIM7080G_THREAD_SAFE
+#define SIM7080G_THREAD_SAFE                1       //Arbitrate commands from several tasks with priority lanes (0: compiled out)
+#endif
 
 
 /**
@@ -29,6 +239,36 @@ enum SIM7080G_PWR {
     SIM_SLEEP       //Hardware sleep
 };
 
+/**
+ *  @brief SIM7080G PDP context IP type
+*/
+enum SIM7080G_PDP_IPTYPE {
+    SIM_PDP_DUAL = 0,       //Dual PDN stack
+    SIM_PDP_IPV4 = 1,       //IPv4
+    SIM_PDP_IPV6 = 2        //IPv6
+};
+
+/**
+ *  @brief SIM7080G PDP context authentication
+*/
+enum SIM7080G_PDP_AUTH {
+    SIM_PDP_AUTH_NONE = 0,      //No authentication
+    SIM_PDP_AUTH_PAP = 1,       //PAP
+    SIM_PDP_AUTH_CHAP = 2,      //CHAP
+    SIM_PDP_AUTH_PAPCHAP = 3    //PAP or CHAP
+};
+
+/**
+ *  @brief SIM7080G APP network PDP context configuration
+*/
+struct SIM7080G_PDPCONF {
+    char apn[64] = { '\0' };                        //Access point name (empty: network default)
+    char username[32] = { '\0' };                   //APN username
+    char password[32] = { '\0' };                   //APN password
+    SIM7080G_PDP_AUTH auth = SIM_PDP_AUTH_NONE;     //Authentication method
+    SIM7080G_PDP_IPTYPE ipType = SIM_PDP_IPV4;      //IP type
+};
+
 /**
  *  @brief SIM7080G APP network (mobile internet) info data structure
 */
@@ -38,12 +278,327 @@ struct SIM7080G_APPN {
     char ipv4[16] = { '\0' };
 };
 
+/**
+ *  @brief SIM7080G APP network link supervisor states
+*/
+enum SIM7080G_LINK_STATE {
+    SIM_LINK_DOWN,          //PDP context inactive, activation pending
+    SIM_LINK_VERIFY,        //PDP context active, verifying that data flows
+    SIM_LINK_UP,            //Link is up and data flows
+    SIM_LINK_REACTIVATE,    //Recovery level 1: deactivate and re-activate the PDP context
+    SIM_LINK_CFUN_CYCLE,    //Recovery level 2: cycle phone functionality (AT+CFUN=0 -> AT+CFUN=1)
+    SIM_LINK_REBOOT         //Recovery level 3: reboot the module
+};
+
+/**
+ *  @brief SIM7080G APP network link supervisor configuration
+*/
+struct SIM7080G_LINK_CONF {
+    uint8_t pdidx = 0;                      //Supervised PDP context (0-3)
+    char probeAddress[16] = "8.8.8.8";      //IPv4 address pinged to verify that data flows
+    uint32_t probeInterval = 60000;         //Probe the link after this many ms without traffic
+    uint32_t probeTimeout = 5000;           //Probe ping timeout in ms
+    uint8_t stallThreshold = 2;             //Consecutive failed probes before the link is considered stalled
+    uint8_t reactivateAttempts = 2;         //PDP re-activations before escalating to a CFUN cycle
+    uint8_t cfunAttempts = 1;               //CFUN cycles before escalating to a reboot
+    uint32_t activationTimeout = 30000;     //Max time to wait for the +APP PDP: <pdidx>,ACTIVE URC in ms
+    uint32_t registrationTimeout = 60000;   //Max time to wait for the registration after a CFUN cycle in ms
+};
+
+/**
+ *  @brief SIM7080G APP network link supervisor counters
+*/
+struct SIM7080G_LINK_STATS {
+    uint32_t upTime = 0;                    //Time spent with the link up in ms
+    uint32_t downTime = 0;                  //Time spent with the link down or recovering in ms
+    uint16_t availability = 0;              //Link availability in per mille
+    uint32_t probes = 0;                    //Data flow probes sent
+    uint32_t probeFailures = 0;             //Data flow probes without reply
+    uint32_t stalls = 0;                    //Detected stalls and link losses
+    uint32_t reactivations = 0;             //PDP context re-activations
+    uint32_t cfunCycles = 0;                //CFUN cycles
+    uint32_t reboots = 0;                   //Module reboots
+    uint32_t recoveries = 0;                //Successful recoveries
+    uint32_t lastRecoveryTime = 0;          //Duration of the last recovery in ms
+    uint32_t maxRecoveryTime = 0;           //Longest recovery in ms
+    uint32_t totalRecoveryTime = 0;         //Sum of all recovery durations in ms
+};
+
+/**
+ *  @brief SIM7080G eDRX access technology
+*/
+enum SIM7080G_EDRX_ACT {
+    SIM_EDRX_CATM = 4,      //LTE Cat-M (E-UTRAN WB-S1)
+    SIM_EDRX_NBIOT = 5      //NB-IoT (E-UTRAN NB-S1)
+};
+
+/**
+ *  @brief SIM7080G power saving timers granted by the network
+*/
+struct SIM7080G_PSM_GRANT {
+    bool psm = false;                       //PSM granted (both timers present and active)
+    uint32_t activeTime = 0;                //Active time (T3324) in s
+    uint32_t tau = 0;                       //Periodic TAU (T3412 extended) in s
+    bool edrx = false;                      //eDRX granted
+    uint32_t edrxCycle = 0;                 //eDRX cycle in ms
+    uint32_t ptw = 0;                       //Paging time window in ms
+};
+
+/**
+ *  @brief SIM7080G power saving counters
+*/
+struct SIM7080G_PSM_STATS {
+    uint32_t entries = 0;                   //PSM entries
+    uint32_t psmTime = 0;                   //Time spent in PSM in ms
+    uint32_t wakes = 0;                     //Wake-ups with a measured wake-to-data latency
+    uint32_t lastWakeLatency = 0;           //Time from the last wake-up to the first data exchange in ms
+    uint32_t maxWakeLatency = 0;            //Longest wake-to-data latency in ms
+    uint32_t totalWakeLatency = 0;          //Sum of all wake-to-data latencies in ms
+};
+
+/**
+ *  @brief SIM7080G shadow state fields
+*/
+enum SIM7080G_SHADOW_FIELD {
+    SIM_SHADOW_PIN,         //SIM PIN status (+CPIN)
+    SIM_SHADOW_GNSS,        //GNSS power (+CGNSPWR)
+    SIM_SHADOW_FTP,         //FTP session state (+FTPSTATE, +FTPPUT)
+    SIM_SHADOW_HTTP,        //HTTP connection state (+SHSTATE)
+    SIM_SHADOW_APPN,        //APP network status of pdidx 0, followed by the other contexts (+CNACT, +APP PDP)
+    SIM_SHADOW_FIELDS = SIM_SHADOW_APPN + SIM7080G_PDP_CONTEXTS
+};
+
+/**
+ *  @brief SIM7080G shadow state counters
+*/
+struct SIM7080G_SHADOW_STATS {
+    uint32_t hits = 0;                      //Status queries answered without a command (round trips saved)
+    uint32_t misses = 0;                    //Status queries sent to the module
+    uint32_t invalidations = 0;             //Times the state was dropped (power up/down, reboot, cell function change)
+    uint32_t roundTrips = 0;                //Commands sent
+    uint32_t bootRoundTrips = 0;            //Commands sent from the last boot to the first data exchange
+    uint32_t bootTime = 0;                  //Time from the last boot to the first data exchange in ms
+};
+
+/**
+ *  @brief SIM7080G boot counters
+*/
+struct SIM7080G_BOOT_STATS {
+    uint32_t boots = 0;                     //Boots waited for
+    uint32_t failures = 0;                  //Boots without an answer within the timeout
+    uint32_t rdy = 0;                       //Boots detected by the RDY URC (fixed baud rate)
+    uint32_t probes = 0;                    //AT probes sent while waiting
+    uint32_t lastTime = 0;                  //Time from PWRKEY release to the first answer of the last boot in ms
+    uint32_t maxTime = 0;                   //Longest boot in ms
+    uint32_t totalTime = 0;                 //Sum of the boot times in ms
+    uint32_t profileStored = 0;             //Init profile checks that found it stored on the module
+    uint32_t profileWritten = 0;            //Init profile configured and saved with AT&W
+};
+
+/**
+ *  @brief SIM7080G radio access technologies (AT+CMNB)
+*/
+enum SIM7080G_RAT {
+    SIM_RAT_NONE    = 0,    //No service
+    SIM_RAT_CATM    = 1,    //LTE-M (CAT-M1)
+    SIM_RAT_NBIOT   = 2,    //NB-IoT
+    SIM_RAT_BOTH    = 3     //LTE-M and NB-IoT
+};
+
+/**
+ *  @brief SIM7080G serving cell (AT+CPSI)
+*/
+struct SIM7080G_CELL_INFO {
+    SIM7080G_RAT rat = SIM_RAT_NONE;        //Serving RAT (SIM_RAT_NONE: no service)
+    bool online = false;                    //Operation mode
+    char plmn[8] = { '\0' };                //MCC and MNC ("26201")
+    uint16_t tac = 0;                       //Tracking area code
+    uint32_t cellId = 0;                    //Serving cell id
+    uint16_t pci = 0;                       //Physical cell id
+    uint8_t band = 0;                       //E-UTRAN band
+    uint32_t earfcn = 0;                    //Channel number
+    int16_t rsrq = 0;                       //Reference signal received quality in dB
+    int16_t rsrp = 0;                       //Reference signal received power in dBm
+    int16_t rssi = 0;                       //Received signal strength in dBm
+    int16_t sinr = 0;                       //Signal to interference and noise ratio in dB
+};
+
+/**
+ *  @brief SIM7080G last serving network, scanned first on the next registration
+*/
+struct SIM7080G_NET_CACHE {
+    uint8_t version = 1;                    //Layout of the stored record
+    char plmn[8] = { '\0' };                //MCC and MNC ("": nothing cached)
+    SIM7080G_RAT rat = SIM_RAT_NONE;
+    uint8_t band = 0;
+};
+
+/**
+ *  @brief SIM7080G registration counters
+*/
+struct SIM7080G_REG_STATS {
+    uint32_t attempts = 0;                  //RegisterNetwork() calls
+    uint32_t cachedHits = 0;                //Registrations on the cached network
+    uint32_t cachedTime = 0;                //Sum of their registration times in ms
+    uint32_t fullScans = 0;                 //Registrations after scanning every band
+    uint32_t fullTime = 0;                  //Sum of their registration times in ms
+    uint32_t fallbacks = 0;                 //Cached networks not found within SIM7080G_REG_CACHED_TIMEOUT
+    uint32_t failures = 0;                  //Registrations that timed out
+    uint32_t lastTime = 0;                  //Time of the last registration in ms
+};
+
+/**
+ *  @brief SIM7080G link quality measured with one RAT at one site
+*/
+struct SIM7080G_RAT_SCORE {
+    uint16_t samples = 0;                   //Measurements taken
+    uint16_t failures = 0;                  //Registrations that failed after switching to the RAT
+    uint32_t regTime = 0;                   //Registration time in ms (moving average)
+    uint32_t rtt = 0;                       //Round trip time in ms (moving average)
+    uint32_t goodput = 0;                   //Goodput in bytes/s (moving average)
+};
+
+/**
+ *  @brief SIM7080G RAT measurements and preference of a site
+*/
+struct SIM7080G_RAT_SITE {
+    char plmn[8] = { '\0' };                //MCC and MNC ("": unused)
+    uint16_t tac[2] = { 0 };                //Tracking area code seen with LTE-M, NB-IoT
+    SIM7080G_RAT preferred = SIM_RAT_NONE;  //RAT selected when registering at the site
+    uint16_t uses = 0;                      //Registrations at the site (least used site is replaced)
+    SIM7080G_RAT_SCORE scores[2];           //LTE-M, NB-IoT
+};
+
+/**
+ *  @brief SIM7080G RAT policy
+ * 
+ *  A RAT is rated by the time a typical transaction takes:
+ *  roundTrips * RTT + payload / goodput + regWeight % of the registration time.
+ *  Terms not measured for both RATs are left out.
+*/
+struct SIM7080G_RAT_POLICY {
+    uint16_t payload = 1024;                //Bytes per typical transaction
+    uint8_t roundTrips = 4;                 //Round trips per typical transaction
+    uint8_t regWeight = 10;                 //Share of the registration time counted per transaction in percent
+    uint8_t hysteresis = 25;                //Advantage in percent the other RAT needs for a switch
+    uint8_t minSamples = 3;                 //Measurements of the serving RAT before it is compared
+    bool explore = true;                    //Try the other RAT once per site
+    uint32_t minDwell = 3600000;            //Min time between switches in ms
+    uint32_t regTimeout = 120000;           //Max registration time after a switch in ms
+};
+
+/**
+ *  @brief SIM7080G RAT decision reasons
+*/
+enum SIM7080G_RAT_REASON {
+    SIM_RAT_SITE,           //Preference stored for the site
+    SIM_RAT_EXPLORE,        //Other RAT not measured at the site yet
+    SIM_RAT_UNDERPERFORM,   //Other RAT is faster by more than the hysteresis
+    SIM_RAT_REG_FAILED      //Switch back, no registration with the selected RAT
+};
+
+/**
+ *  @brief SIM7080G RAT decision
+*/
+struct SIM7080G_RAT_DECISION {
+    uint32_t time = 0;                      //millis() of the decision
+    SIM7080G_RAT from = SIM_RAT_NONE;
+    SIM7080G_RAT to = SIM_RAT_NONE;
+    SIM7080G_RAT_REASON reason = SIM_RAT_SITE;
+    uint32_t cost = 0;                      //Transaction time with the serving RAT in ms (0: not rated)
+    uint32_t otherCost = 0;                 //Transaction time with the other RAT in ms (0: not rated)
+};
+
+/**
+ *  @brief SIM7080G signal sample (AT+CPSI?, or AT+CESQ and AT+CSQ without a serving cell)
+*/
+struct SIM7080G_SIGNAL_SAMPLE {
+    uint32_t time = 0;                      //millis() of the sample
+    SIM7080G_RAT rat = SIM_RAT_NONE;        //Serving RAT (SIM_RAT_NONE: no serving cell)
+    int16_t rssi = INT16_MIN;               //Received signal strength in dBm (SIM7080_SIGNAL_UNKNOWN: not reported)
+    int16_t rsrp = INT16_MIN;               //Reference signal received power in dBm
+    int16_t rsrq = INT16_MIN;               //Reference signal received quality in dB
+    int16_t sinr = INT16_MIN;               //Signal to interference and noise ratio in dB
+    uint8_t ce = UINT8_MAX;                 //Coverage enhancement level estimated from the RSRP (0-2, SIM7080_CE_UNKNOWN: no RSRP)
+};
+
+/**
+ *  @brief SIM7080G smoothed signal (exponentially weighted moving averages)
+*/
+struct SIM7080G_SIGNAL {
+    uint32_t samples = 0;                   //Samples taken
+    uint32_t time = 0;                      //millis() of the last sample
+    float rssi = 0;                         //dBm
+    float rsrp = 0;                         //dBm
+    float rsrq = 0;                         //dB
+    float sinr = 0;                         //dB
+    uint8_t known = 0;                      //Fields measured at least once (bit 0: RSSI, 1: RSRP, 2: RSRQ, 3: SINR)
+    uint8_t ce = UINT8_MAX;                 //Coverage enhancement level estimated from the smoothed RSRP (0-2, SIM7080_CE_UNKNOWN: no RSRP yet)
+};
+
+class SIM7080G;
+
+/**
+ *  @brief Deferred transmission, called from Loop()
+ * 
+ *  @param context Context given to ScheduleTransmit()
+ *  @param modem Driver instance
+ *  @param late The deadline expired before the link quality was reached
+*/
+typedef void (*SIM7080G_TX_CALLBACK)(void* context, SIM7080G* modem, bool late);
+
+/**
+ *  @brief SIM7080G deferred transmission
+*/
+struct SIM7080G_TX_JOB {
+    SIM7080G_TX_CALLBACK callback = nullptr;    //nullptr: free slot
+    void* context = nullptr;
+    uint32_t queued = 0;                    //millis() when scheduled
+    uint32_t maxDelay = 0;                  //Deadline relative to queued in ms
+    uint8_t maxCE = 0;                      //Highest coverage enhancement level to transmit at
+};
+
+/**
+ *  @brief SIM7080G transmit scheduler counters
+*/
+struct SIM7080G_TX_STATS {
+    uint32_t scheduled = 0;                 //Transmissions scheduled
+    uint32_t onQuality = 0;                 //Run once the link quality was reached
+    uint32_t onDeadline = 0;                //Run when the deadline expired
+    uint32_t cancelled = 0;                 //Cancelled before running
+    uint32_t totalDelay = 0;                //Sum of the delays until running in ms
+};
+
+/**
+ *  @brief SIM7080G time source
+*/
+enum SIM7080G_TIME_SOURCE {
+    SIM_TIME_NONE = 0,
+    SIM_TIME_RTC,           //Module clock (AT+CCLK?)
+    SIM_TIME_NTP,           //NTP server (AT+CNTP), read back from the module clock
+    SIM_TIME_NETWORK,       //Network time (*PSUTTZ, AT+CLTS=1)
+    SIM_TIME_GNSS           //UTC of the last GNSS fix
+};
+
+/**
+ *  @brief SIM7080G clock state
+*/
+struct SIM7080G_TIME_STATUS {
+    SIM7080G_TIME_SOURCE source = SIM_TIME_NONE;    //Source of the current reference
+    uint32_t syncTime = 0;                  //millis() of the current reference
+    uint32_t error = UINT32_MAX;            //Estimated clock error in ms (UINT32_MAX: not synchronised)
+    float drift = 0;                        //Measured host clock drift in ppm (positive: host clock slow)
+    bool driftKnown = false;                //Drift measured at least once
+    uint32_t samples = 0;                   //Time samples received
+    uint32_t accepted = 0;                  //Samples that became the reference
+};
+
 /**
  *  @brief SIM7080G GNSS Data structure
 */
 struct SIM7080G_GNSS {
     uint8_t run = 0;            //Run status
-    //uint8_t fix;            //Fix status
+    uint8_t fix = 0;            //Fix status
     char datetime[19] = {'\0'};      //UTC date & time
     char latitude[11] = {'\0'};      //GNSS Latitude
     char longitude[12] = {'\0'};     //GNSS Longitude
@@ -65,6 +620,118 @@ struct SIM7080G_GNSS {
 
 enum SIM7080G_HTTP_METHOD {SIM7080G_HTTP_GET = 1, SIM7080G_HTTP_PUT = 2, SIM7080G_HTTP_POST = 3};
 
+/**
+ *  @brief SIM7080G SSL/TLS protocol version
+*/
+enum SIM7080G_TLS_VERSION {
+    SIM_TLS_ANY = 0,        //Negotiated
+    SIM_TLS_1_0 = 1,        //TLS 1.0
+    SIM_TLS_1_1 = 2,        //TLS 1.1
+    SIM_TLS_1_2 = 3         //TLS 1.2
+};
+
+/**
+ *  @brief SIM7080G SSL/TLS context configuration
+*/
+struct SIM7080G_TLSCONF {
+    uint8_t ctxIndex = 1;                               //SSL context index (0-5)
+    SIM7080G_TLS_VERSION version = SIM_TLS_1_2;         //Protocol version
+    char caCert[32] = { '\0' };                         //Root CA file name on the module (empty: no server verification)
+    char clientCert[32] = { '\0' };                     //Client certificate file name (empty: no client authentication)
+    char clientKey[32] = { '\0' };                      //Client key file name
+    char sni[65] = { '\0' };                            //Server name indication (empty: none)
+    bool ignoreRtcTime = true;                          //Skip certificate validity check against the module's clock
+};
+
+/**
+ *  @brief SIM7080G SSL/TLS counters
+*/
+struct SIM7080G_TLS_STATS {
+    uint32_t handshakes = 0;            //Successful handshakes
+    uint32_t fullHandshakes = 0;        //Handshakes not classified as fast
+    uint32_t fastHandshakes = 0;        //Handshakes faster than SIM7080G_TLS_FAST_RATIO % of the average slow one (timing heuristic only)
+    uint32_t failures = 0;              //Failed handshakes / connections
+    uint32_t lastHandshakeTime = 0;     //Duration of the last handshake in ms
+    uint32_t fullHandshakeTime = 0;     //Average duration of a handshake not classified as fast in ms
+    uint32_t certUploads = 0;           //Certificates written and converted
+    uint32_t certSkips = 0;             //Certificate uploads skipped because the content was unchanged
+};
+
+/**
+ *  @brief SIM7080G uploaded certificate (change detection)
+*/
+struct SIM7080G_TLS_CERT {
+    char name[32] = { '\0' };           //File name on the module
+    uint32_t hash = 0;                  //FNV-1a hash of the content
+    bool pending = false;               //Written but not yet converted
+};
+
+/**
+ *  @brief SIM7080G DNS cache entry
+*/
+struct SIM7080G_DNS_ENTRY {
+    char host[65] = { '\0' };           //Host name (empty: free entry)
+    char ip[16] = { '\0' };             //Resolved IPv4 address (empty: negative entry)
+    uint32_t resolved = 0;              //Time of the resolution
+    uint32_t ttl = 0;                   //Lifetime in ms
+    bool used = false;                  //Used since the last resolution (refresh candidate)
+    uint32_t lastUsed = 0;              //Time of the last lookup (LRU replacement)
+};
+
+/**
+ *  @brief SIM7080G DNS cache counters
+*/
+struct SIM7080G_DNS_STATS {
+    uint32_t hits = 0;                  //Lookups answered from the cache
+    uint32_t negativeHits = 0;          //Lookups answered from a negative entry
+    uint32_t misses = 0;                //Lookups that needed AT+CDNSGIP
+    uint32_t failures = 0;              //Failed AT+CDNSGIP queries
+    uint32_t refreshes = 0;             //Entries refreshed ahead of expiry
+    uint32_t lastLookupTime = 0;        //Duration of the last AT+CDNSGIP query in ms
+};
+
+/**
+ *  @brief SIM7080G ping probe result and RTT statistics
+*/
+struct SIM7080G_PING_RESULT {
+    char address[16] = { '\0' };        //Pinged IPv4 address
+    uint16_t count = 0;                 //Echo requests sent
+    uint16_t received = 0;              //Replies received in time
+    uint16_t lost = 0;                  //Requests without reply (set when done)
+    uint16_t loss = 0;                  //Packet loss in per mille (set when done)
+    uint32_t min = 0;                   //Minimum RTT in ms
+    uint32_t max = 0;                   //Maximum RTT in ms
+    uint32_t avg = 0;                   //Average RTT in ms
+    uint32_t stddev = 0;                //RTT standard deviation in ms (set when done)
+    uint32_t p50 = 0;                   //RTT percentiles in ms, from the histogram (set when done)
+    uint32_t p95 = 0;
+    uint32_t p99 = 0;
+    uint32_t jitter = 0;                //Mean RTT difference of consecutive replies in ms
+    bool done = false;                  //Probe finished
+    uint16_t histogram[SIM7080G_PING_BUCKETS] = { 0 };  //Log-linear RTT histogram, see SIM7080G::PingBucket()
+
+    //Running state
+    uint32_t lastRtt = 0;               //RTT of the previous reply
+    uint64_t jitterSum = 0;             //Sum of consecutive RTT differences
+    double mean = 0;                    //Welford running mean
+    double m2 = 0;                      //Welford sum of squared differences
+};
+
+/**
+ *  @brief SIM7080G link characterisation and derived transfer sizes
+*/
+struct SIM7080G_LINK_PROFILE {
+    bool valid = false;                 //Profile was measured
+    uint32_t measured = 0;              //Time of the measurement
+    uint16_t mtu = 0;                   //Effective IP MTU in bytes (largest echoed ping payload + 28)
+    uint32_t minRtt = 0;                //Minimum RTT of small packets in ms
+    uint32_t rttPerKB = 0;              //RTT increase per KB of payload in ms (slope of RTT vs payload size)
+    uint32_t goodput = 0;               //Upload goodput in bytes/s (upload burst, or ping slope without a sink)
+    uint32_t bdp = 0;                   //Bandwidth-delay product in bytes
+    uint16_t ftpChunk = 0;              //Recommended AT+FTPPUT chunk size
+    uint16_t socketChunk = 0;           //Recommended AT+CASEND size
+};
+
 /**
  *  @brief SIM7080G HTTP(S) configuration
 */
@@ -74,6 +741,7 @@ struct SIM7080G_HTTPCONF {
     uint16_t bodylen = 0;                               //HTTP(S) body length 0-4096
     uint16_t headerlen = 0;                             //HTTP(S) header length 0-350
     SIM7080G_HTTP_METHOD method = SIM7080G_HTTP_POST;   //GET = 1, PUT = 2, POST = 3
+    bool tls = false;                                   //Use the SSL context configured with SetTLS() (https:// URLs)
 };
 
 /**
@@ -101,395 +769,2175 @@ struct SIM7080G_HTTP_RESULT {
 };
 
 /**
- *  @brief SIM7080G FTP transaction result codes
+ *  @brief SIM7080G socket protocol
 */
-enum SIM7080G_FTP_RESULT {
-    SIM_FTP_SUCCESS = 0,        //Successful
-    SIM_FTP_PAR_ERR = 1,        //Given parameter was invalid
-    SIM_FTP_RESP_TO = 2,        //Server did not respond in the specified time
-    SIM_FTP_OTH_ERR = 3,        //Undefined error
-    SIM_FTP_NET_ERR = 61,       //Network error
-    SIM_FTP_DNS_ERR = 62,       //DNS error
-    SIM_FTP_CON_ERR = 63,       //Connect error
-    SIM_FTP_TIMEOUT = 64,       //Timeout
-    SIM_FTP_SRV_ERR = 65,       //Server error
-    SIM_FTP_OPNTALL = 66,       //Operation not allowed
-    SIM_FTP_REPLERR = 70,       //Replay error
-    SIM_FTP_USR_ERR = 71,       //Username error
-    SIM_FTP_PWD_ERR = 72,       //Password error
-    SIM_FTP_TYPEERR = 73,       //Type error
-    SIM_FTP_RESTERR = 74,       //Rest error
-    SIM_FTP_PSS_ERR = 75,       //Passive error
-    SIM_FTP_ACT_ERR = 76,       //Active error
-    SIM_FTP_OPR_ERR = 77,       //Operate error
-    SIM_FTP_UPL_ERR = 78,       //Upload error
-    SIM_FTP_DWL_ERR = 79,       //Download error
-    SIM_FTP_MANQUIT = 80,       //Manual quit
-    SIM_FTP_SSLCERR = 90,       //SSL connect error
-    SIM_FTP_SSLAERR = 91,       //SSL alert error
-    SIM_FTP_AUT_ERR = 92,       //AUTH error
-    SIM_FTP_PBS_ERR = 93,       //PBSIZE error
-    SIM_FTP_PRT_ERR = 94       //PORT error
+enum SIM7080G_SOCKET_TYPE {
+    SIM_SOCKET_TCP,
+    SIM_SOCKET_UDP
 };
 
 /**
- *  @brief SIM7080G FTP data type
+ *  @brief SIM7080G socket state and receive buffer
 */
-enum SIM7080G_FTP_DTYPE {
-    SIM_FTP_ASCII  = 0,
-    SIM_FTP_BINARY = 1
+struct SIM7080G_SOCKET {
+    bool open = false;                              //Connection is open
+    bool dataPending = false;                       //+CADATAIND received, data waits in the module
+    bool closePending = false;                      //Closed by the remote side, the module still holds the ID until AT+CACLOSE
+    bool datagram = false;                          //UDP: rxBuffer holds at most one datagram
+    bool ssl = false;                               //SSL enabled for the ID on the module (AT+CASSLCFG)
+    uint8_t pdidx = 0;                              //PDP context the socket is bound to
+    uint16_t rxHead = 0;                            //Index of the oldest byte in rxBuffer
+    uint16_t rxCount = 0;                           //Number of bytes in rxBuffer
+    uint8_t rxBuffer[SIM7080G_SOCKET_RX_BUFFER];    //Receive ring buffer
 };
 
 /**
- *  @brief SIM7080G FTP operating mode
+ *  @brief SIM7080G MQTT connection configuration
 */
-enum SIM7080G_FTP_MODE {
-    SIM_FTP_ACTIVE  = 0,
-    SIM_FTP_PASSIVE = 1
+struct SIM7080G_MQTTCONF {
+    char host[65] = { '\0' };          //Broker IP address or domain name
+    uint16_t port = 1883;              //Broker port
+    char clientId[33] = { '\0' };      //Client identifier
+    char username[33] = { '\0' };      //Username (empty: none)
+    char password[33] = { '\0' };      //Password (empty: none)
+    uint16_t keepAlive = 60;           //Keep alive interval in seconds
+    bool cleanSession = false;         //false: broker keeps the session (subscriptions, QoS 1 messages) across reconnects
+};
+
+/**
+ *  @brief SIM7080G MQTT message
+*/
+struct SIM7080G_MQTT_MSG {
+    char topic[SIM7080G_MQTT_TOPIC] = { '\0' };
+    uint8_t payload[SIM7080G_MQTT_PAYLOAD];
+    uint16_t length = 0;                //Payload length
+    uint8_t qos = 0;                    //QoS 0 or 1
+    bool retain = false;                //Retain flag
+    uint32_t queued = 0;                //Time the message was queued
 };
 
-class SIM7080G {
+/**
+ *  @brief SIM7080G worker hook, application code run by the shared worker task between polls
+*/
+typedef void (*SIM7080G_WORKER_HOOK)(void);
+
+/**
+ *  @brief SIM7080G command lanes, a waiting lane is served before every lane below it
+*/
+enum SIM7080G_LANE {
+    SIM_LANE_CONTROL,   //Short status and control commands (registration, signal, URC servicing)
+    SIM_LANE_NORMAL,    //Regular commands
+    SIM_LANE_BULK,      //Long transfers, yield to the other lanes between chunks
+    SIM_LANES
+};
+
+/**
+ *  @brief SIM7080G lane counters
+*/
+struct SIM7080G_LANE_STATS {
+    uint32_t acquisitions = 0;          //Transactions started in this lane
+    uint32_t contended = 0;             //Transactions that had to wait for another task
+    uint32_t yields = 0;                //Times a transfer in this lane stepped aside for a higher lane
+    uint32_t timeouts = 0;              //Lock() calls that gave up
+    uint32_t maxWait = 0;               //Longest wait for the lock in ms
+    uint32_t totalWait = 0;             //Sum of all waits in ms
+};
+
+/**
+ *  @brief SIM7080G MQTT inbound message callback
+*/
+typedef void (*SIM7080G_MQTT_CALLBACK)(const char* topic, const uint8_t* payload, size_t length);
+
+/**
+ *  @brief SIM7080G MQTT subscription
+*/
+struct SIM7080G_MQTT_SUB {
+    char topic[SIM7080G_MQTT_TOPIC] = { '\0' };     //Topic filter (+ and # wildcards supported)
+    uint8_t qos = 0;
+    SIM7080G_MQTT_CALLBACK callback = nullptr;
+};
+
+/**
+ *  @brief SIM7080G MQTT counters
+*/
+struct SIM7080G_MQTT_STATS {
+    uint32_t published = 0;             //Successful publishes
+    uint32_t failed = 0;                //Failed publishes
+    uint32_t received = 0;              //Inbound messages
+    uint32_t dropped = 0;               //Messages dropped (queue or inbox full)
+    uint32_t connects = 0;              //Broker connections (including reconnects)
+    uint32_t batches = 0;               //Batched flushes
+    uint64_t bytesPublished = 0;        //Payload bytes published
+    uint32_t lastLatency = 0;           //Last AT+SMPUB round trip in ms
+    uint32_t maxLatency = 0;            //Longest AT+SMPUB round trip in ms
+    uint64_t totalLatency = 0;          //Sum of AT+SMPUB round trips in ms
+    uint32_t avgLatency = 0;            //Average AT+SMPUB round trip in ms
+    uint32_t maxQueueDelay = 0;         //Longest time a queued message waited for its flush in ms
+    uint32_t throughput = 0;            //Payload bytes per second while publishing
+};
+
+/**
+ *  @brief SIM7080G CoAP message type
+*/
+enum SIM7080G_COAP_TYPE {
+    SIM_COAP_CON = 0,       //Confirmable, retransmitted until acknowledged
+    SIM_COAP_NON = 1        //Non-confirmable, sent once
+};
+
+/**
+ *  @brief SIM7080G CoAP request method
+*/
+enum SIM7080G_COAP_METHOD {
+    SIM_COAP_GET = 1,
+    SIM_COAP_POST = 2,
+    SIM_COAP_PUT = 3,
+    SIM_COAP_DELETE = 4
+};
+
+/**
+ *  @brief SIM7080G CoAP response (one block of it for block-wise responses)
+*/
+struct SIM7080G_COAP_RESPONSE {
+    uint8_t code = 0;                   //Response code (class << 5 | detail, e.g. 0x45 = 2.05), 0 if the request failed
+    const uint8_t* payload = nullptr;   //Payload of this block
+    size_t length = 0;                  //Payload length of this block
+    size_t offset = 0;                  //Offset of this block in the whole payload
+    bool more = false;                  //More blocks follow
+};
+
+/**
+ *  @brief SIM7080G CoAP response callback. Called from Loop().
+*/
+typedef void (*SIM7080G_COAP_CALLBACK)(const SIM7080G_COAP_RESPONSE* response);
+
+/**
+ *  @brief SIM7080G CoAP counters
+*/
+struct SIM7080G_COAP_STATS {
+    uint32_t requests = 0;              //Requests started
+    uint32_t completed = 0;             //Requests with a final response
+    uint32_t failed = 0;                //Requests timed out or reset
+    uint32_t messages = 0;              //Messages sent, including blocks and retransmissions
+    uint32_t retransmissions = 0;       //CON retransmissions
+    uint64_t bytesSent = 0;             //Bytes sent including CoAP headers
+    uint64_t bytesReceived = 0;         //Bytes received including CoAP headers
+};
+
+/**
+ *  @brief SIM7080G FTP transaction result codes
+*/
+enum SIM7080G_FTP_RESULT {
+    SIM_FTP_SUCCESS = 0,        //Successful
+    SIM_FTP_PAR_ERR = 1,        //Given parameter was invalid
+    SIM_FTP_RESP_TO = 2,        //Server did not respond in the specified time
+    SIM_FTP_OTH_ERR = 3,        //Undefined error
+    SIM_FTP_NET_ERR = 61,       //Network error
+    SIM_FTP_DNS_ERR = 62,       //DNS error
+    SIM_FTP_CON_ERR = 63,       //Connect error
+    SIM_FTP_TIMEOUT = 64,       //Timeout
+    SIM_FTP_SRV_ERR = 65,       //Server error
+    SIM_FTP_OPNTALL = 66,       //Operation not allowed
+    SIM_FTP_REPLERR = 70,       //Replay error
+    SIM_FTP_USR_ERR = 71,       //Username error
+    SIM_FTP_PWD_ERR = 72,       //Password error
+    SIM_FTP_TYPEERR = 73,       //Type error
+    SIM_FTP_RESTERR = 74,       //Rest error
+    SIM_FTP_PSS_ERR = 75,       //Passive error
+    SIM_FTP_ACT_ERR = 76,       //Active error
+    SIM_FTP_OPR_ERR = 77,       //Operate error
+    SIM_FTP_UPL_ERR = 78,       //Upload error
+    SIM_FTP_DWL_ERR = 79,       //Download error
+    SIM_FTP_MANQUIT = 80,       //Manual quit
+    SIM_FTP_SSLCERR = 90,       //SSL connect error
+    SIM_FTP_SSLAERR = 91,       //SSL alert error
+    SIM_FTP_AUT_ERR = 92,       //AUTH error
+    SIM_FTP_PBS_ERR = 93,       //PBSIZE error
+    SIM_FTP_PRT_ERR = 94       //PORT error
+};
+
+/**
+ *  @brief SIM7080G FTP data type
+*/
+enum SIM7080G_FTP_DTYPE {
+    SIM_FTP_ASCII  = 0,
+    SIM_FTP_BINARY = 1
+};
+
+/**
+ *  @brief SIM7080G FTP operating mode
+*/
+enum SIM7080G_FTP_MODE {
+    SIM_FTP_ACTIVE  = 0,
+    SIM_FTP_PASSIVE = 1
+};
+
+/**
+ *  @brief SIM7080G FTP session profile
+*/
+struct SIM7080G_FTPCONF {
+    char server[65] = { '\0' };                 //Server host name or IPv4 address
+    uint16_t port = 21;                         //Control port
+    SIM7080G_FTP_MODE mode = SIM_FTP_PASSIVE;   //Operating mode
+    SIM7080G_FTP_DTYPE type = SIM_FTP_BINARY;   //Data type
+    uint8_t pdidx = 0;                          //APP network PDP context
+    char username[33] = { '\0' };
+    char password[33] = { '\0' };
+    char upName[49] = { '\0' };                 //Upload file name ("" to leave unchanged)
+    char upPath[65] = { '\0' };                 //Upload file path ("" to leave unchanged)
+    char downName[49] = { '\0' };               //Download file name ("" to leave unchanged)
+    char downPath[65] = { '\0' };               //Download file path ("" to leave unchanged)
+};
+
+/**
+ *  @brief SIM7080G session profile counters (FTP and HTTP)
+*/
+struct SIM7080G_PROFILE_STATS {
+    uint32_t applied = 0;                   //Profiles applied
+    uint32_t sent = 0;                      //Parameters sent to the module
+    uint32_t skipped = 0;                   //Parameters already set on the module
+};
+
+/**
+ *  @brief SIM7080G per command family metrics
+*/
+struct SIM7080G_CMD_METRICS {
+    char family[12] = { '\0' };             //Command without "AT" and parameters ("+CGNSINF", "E0", ...), "*" for the rest
+    uint32_t calls = 0;                     //Commands sent
+    uint32_t failures = 0;                  //Commands answered with an error result
+    uint32_t timeouts = 0;                  //Commands without a response in time
+    uint32_t bytesOut = 0;                  //Bytes sent (command and data)
+    uint32_t bytesIn = 0;                   //Bytes received (response and data)
+    uint32_t totalTime = 0;                 //Sum of all latencies in ms
+    uint32_t maxTime = 0;                   //Longest latency in ms
+    uint16_t histogram[SIM7080G_METRICS_BUCKETS] = { 0 };  //Latencies, bucket 0: < 1 ms, bucket n: 2^(n-1) - 2^n - 1 ms
+};
+
+/**
+ *  @brief SIM7080G command trace entry
+*/
+struct SIM7080G_CMD_SPAN {
+    uint8_t family = 0;                     //Index of the command family
+    bool failed = false;                    //Error result or timeout
+    uint32_t start = 0;                     //Time the command was sent in us
+    uint32_t duration = 0;                  //Time until the last byte of the exchange in us
+};
+
+/**
+ *  @brief SIM7080G trace event IDs
+*/
+enum SIM7080G_TRACE_ID : uint8_t {
+    SIM_TRACE_NETREG,           //Network registration status (a: status)
+    SIM_TRACE_APPN_STATUS,      //APP network status (a: pdidx, b: status, 255: no response)
+    SIM_TRACE_GNSS_POWER,       //GNSS power status (a: status)
+    SIM_TRACE_GNSS,             //GNSS update (a: run status, b: GNSS satellites in view)
+    SIM_TRACE_VBAT,             //Battery voltage (a: mV)
+    SIM_TRACE_PING,             //Ping probe finished (a: replies, b: requests)
+    SIM_TRACE_IDS
+};
+
+/**
+ *  @brief SIM7080G trace event
+*/
+struct SIM7080G_TRACE_EVENT {
+    uint32_t time = 0;                      //Time of the event in us
+    SIM7080G_TRACE_ID id = SIM_TRACE_NETREG;    //Event
+    int32_t a = 0;                          //1st argument
+    int32_t b = 0;                          //2nd argument
+};
+
+/**
+ *  @brief SIM7080G CMUX counters
+*/
+struct SIM7080G_CMUX_STATS {
+    uint32_t framesIn = 0;                  //Frames received
+    uint32_t framesOut = 0;                 //Frames sent
+    uint32_t bytesIn = 0;                   //Channel data bytes received
+    uint32_t bytesOut = 0;                  //Channel data bytes sent
+    uint32_t fcsErrors = 0;                 //Frames with a bad checksum
+    uint32_t flowStops = 0;                 //Times a channel was stopped because its receive buffer filled up
+    uint32_t remoteFlowStops = 0;           //Times the module stopped a channel
+    uint32_t overruns = 0;                  //Channel data bytes dropped because the receive buffer was full
+};
+
+#if SIM7080G_ENABLE_ASYNC
+/**
+ *  @brief SIM7080G non-blocking command state
+*/
+enum SIM7080G_ASYNC {
+    SIM_ASYNC_IDLE,         //Command slot free
+    SIM_ASYNC_PENDING,      //Waiting for the result
+    SIM_ASYNC_OK,           //Result OK (or the expected line) received
+    SIM_ASYNC_ERROR,        //Result ERROR received
+    SIM_ASYNC_TIMEOUT,      //No result in time
+    SIM_ASYNC_CANCELLED     //Abandoned by the caller
+};
+
+class SIM7080G;
+
+/**
+ *  @brief SIM7080G URC hook, called for every line Loop() or a command receives. Must not send commands.
+*/
+typedef void (*SIM7080G_URC_HOOK)(void* context, SIM7080G* modem, const char* line);
+#endif
+
+#if SIM7080G_ENABLE_CMUX
+class SIM7080G;
+
+/**
+ *  @brief SIM7080G CMUX virtual channel
+ * 
+ *  Stream over one DLCI of the multiplexer. Reading or polling any channel
+ *  demultiplexes everything waiting on the UART, so channels that are not
+ *  read fill up and get flow controlled individually.
+*/
+class SIM7080G_CMUX_CHANNEL : public Stream {
+
+    friend class SIM7080G;
+
+    SIM7080G* owner = nullptr;              //Multiplexer
+    uint8_t dlci = 0;                       //Data link connection identifier
+    bool open = false;                      //Channel established (SABM acknowledged)
+    bool localFC = false;                   //Module asked to stop sending (buffer filling up)
+    bool remoteFC = false;                  //Module asked us to stop sending
+    uint8_t rxBuffer[SIM7080G_CMUX_BUFFER]; //Receive ring buffer
+    uint16_t rxHead = 0;                    //Index of the oldest byte
+    uint16_t rxCount = 0;                   //Number of bytes in rxBuffer
+
+public:
+
+    int available(void) override;
+    int read(void) override;
+    int peek(void) override;
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t* buffer, size_t size) override;
+    using Print::write;
+
+    /**
+     *  @brief Get channel state
+     * 
+     *  @return true: Channel established | false: Channel closed
+    */
+    bool IsOpen(void) const;
+    //*OK
+
+};
+#endif
+
+class SIM7080G {
+
+#if SIM7080G_ENABLE_CMUX
+    friend class SIM7080G_CMUX_CHANNEL;
+#endif
+
+    //Serial communication
+
+    uint8_t uartTX = 0;                  //UART TX pin
+    uint8_t uartRX = 0;                  //UART RX pin
+
+    uint64_t uartBaudrate = 921600;             //UART Baudrate     (921600)
+    int uartRTS = -1;                           //UART RTS pin for hardware flow control (-1: not connected)
+    int uartCTS = -1;                           //UART CTS pin for hardware flow control (-1: not connected)
+    HardwareSerial& uartInterface = Serial1;    //UART interface to use
+
+    const static size_t uartMaxRecvSize = SIM7080G_RX_BUFFER;   //Max number of bytes to receive (Must be divisible by 4)
+    size_t uartRecvtimeout = 100;               //Wait this ammount of ms after last received byte before returning. ( used in Receive() )
+                                                //if 0 timeout will be ignored
+
+    uint32_t uartResponseTimeout = 50;    //Time to wait before reading response from device
+
+    char rxBuffer[uartMaxRecvSize];
+    char txBuffer[SIM7080G_HTTP_REQ_BUFFER];    //Commands with long parameters are built here instead of on the stack
+
+    //Power control
+    int dtrKey = -1;                        //Send module to light sleep (active high)
+    uint8_t pwrKey = 0;                    //Power on/off the module
+    int statusPin = -1;                     //Module STATUS output, high while powered (-1: not connected)
+    SIM7080G_BOOT_STATS bootStats;          //Boot counters
+
+    //Network selection
+    SIM7080G_NET_CACHE netCache;                //Last serving network
+    char netCacheId[24] = { '\0' };             //ICCID of the SIM the cache was read for ("": not read)
+    SIM7080G_REG_STATS regStats;                //Registration counters
+    bool netLocked = false;                     //Bands and operator restricted to the cached network
+    bool netUnlock = false;                     //Registration lost, unlock in the next Loop()
+
+    //RAT policy
+    SIM7080G_RAT_POLICY ratPolicy;
+    SIM7080G_RAT_SITE ratSites[SIM7080G_RAT_SITES];     //Measurements per site
+    int8_t ratSite = -1;                        //Site of the serving cell (-1: unknown)
+    SIM7080G_RAT ratServing = SIM_RAT_NONE;     //RAT of the serving cell
+    bool ratSiteApplied = false;                //Site preference checked since the registration
+    bool ratSwitched = false;                   //Switched at least once
+    bool ratDirty = false;                      //Measurements changed since they were stored
+    uint32_t ratSwitchTime = 0;                 //Time of the last switch
+    SIM7080G_RAT_DECISION ratLog[SIM7080G_RAT_LOG];     //Decisions (ring buffer)
+    uint8_t ratLogHead = 0;                     //Index of the oldest entry
+    uint8_t ratLogCount = 0;                    //Number of entries in ratLog
+
+    //Signal sampler and transmit scheduler
+    SIM7080G_SIGNAL_SAMPLE signalRing[SIM7080G_SIGNAL_SAMPLES];     //Samples (ring buffer)
+    uint8_t signalHead = 0;                     //Index of the oldest sample
+    uint8_t signalCount = 0;                    //Number of samples in signalRing
+    SIM7080G_SIGNAL signalSmooth;               //Smoothed signal
+    uint32_t signalInterval = SIM7080G_SIGNAL_INTERVAL;     //Time between samples taken by Loop() in ms
+    bool signalAlways = false;                  //Sample without waiting transmissions too
+    SIM7080G_TX_JOB txJobs[SIM7080G_TX_QUEUE];  //Deferred transmissions
+    uint8_t txPending = 0;                      //Number of used txJobs slots
+    SIM7080G_TX_STATS txStats;                  //Scheduler counters
+
+    //Clock, Unix time kept as a reference against millis()
+    uint64_t timeRef = 0;                       //Unix time in ms at timeRefMillis (0: not synchronised)
+    uint32_t timeRefMillis = 0;
+    uint32_t timeRefError = 0;                  //Error of the reference in ms
+    uint64_t timeBase = 0;                      //Unix time in ms at timeBaseMillis, start of the drift measurement
+    uint32_t timeBaseMillis = 0;
+    uint32_t timeBaseError = 0;
+    uint32_t timeMaxError = SIM7080G_TIME_MAX_ERROR;    //Bound of the clock error in ms
+    SIM7080G_TIME_SOURCE timeAutoSource = SIM_TIME_NONE;    //Source Loop() synchronises from
+    uint32_t timeAttempt = 0;                   //millis() of the last automatic synchronisation
+    SIM7080G_TIME_STATUS timeStatus;            //Source, drift and counters
+
+    //
+    bool uartOpen = false;                      //UART interface state
+    SIM7080G_PWR pwrState = SIM_PWDN;           //Power state
+
+#if SIM7080G_METRICS
+    //Command metrics
+    SIM7080G_CMD_METRICS metrics[SIM7080G_METRICS_FAMILIES];    //Counters per command family
+    uint8_t metricsFamilies = 0;                //Number of used entries in metrics
+    bool metricsOpen = false;                   //A command exchange is being measured
+    SIM7080G_CMD_SPAN metricsSpan;              //Exchange being measured
+    uint32_t metricsEnd = 0;                    //Time the last byte of the exchange was received in us
+    SIM7080G_CMD_SPAN metricsTrace[SIM7080G_METRICS_TRACE];     //Recent exchanges (ring buffer)
+    uint16_t metricsTraceHead = 0;              //Index of the oldest entry
+    uint16_t metricsTraceCount = 0;             //Number of entries in metricsTrace
+#endif
+
+#if SIM7080G_TRACE
+    //Event trace (single producer: driver, single consumer: ReadTrace() / PrintTrace())
+    SIM7080G_TRACE_EVENT traceRing[SIM7080G_TRACE_EVENTS];
+    std::atomic<uint16_t> traceHead{0};         //Next slot to write
+    std::atomic<uint16_t> traceTail{0};         //Next slot to read
+    std::atomic<uint32_t> traceDropped{0};      //Events dropped because the ring was full
+#endif
+
+#if SIM7080G_SHADOW
+    //Shadow state (kept up to date by HandleURC() and command results)
+    uint32_t shadowTime[SIM_SHADOW_FIELDS];     //Time each field was learned
+    uint16_t shadowValid = 0;                   //Bit per SIM7080G_SHADOW_FIELD
+    uint32_t shadowTTL = SIM7080G_SHADOW_TTL;   //Time a learned field answers getters in ms
+    bool shadowPIN = false;                     //SIM ready
+    uint8_t shadowGNSS = 0;                     //GNSS power
+    uint8_t shadowFTP = 0;                      //FTP session state
+    uint8_t shadowHTTP = 0;                     //HTTP connection state
+    uint8_t shadowAppn[SIM7080G_PDP_CONTEXTS] = { 0 };      //APP network status per context
+    char shadowIP[SIM7080G_PDP_CONTEXTS][16];   //APP network address per context ("" if unknown)
+    SIM7080G_SHADOW_STATS shadowStats;          //Shadow state counters
+    bool bootCounting = true;                   //Counting commands until the first data exchange
+    uint32_t bootStart = 0;                     //Time of the last boot
+#endif
+
+    //Identity, read once per boot
+    char imei[16] = { '\0' };
+    char iccid[24] = { '\0' };
+    char firmware[32] = { '\0' };
+
+    //Unsolicited result codes
+    char urcBuffer[SIM7080G_URC_BUFFER];        //Line buffer for URCs received outside of commands
+    size_t urcLength = 0;                       //Number of characters in urcBuffer
+    uint32_t urcDrained = 0;                    //Time ReadURC() last emptied the UART
+
+#if SIM7080G_ENABLE_ASYNC
+    //Non-blocking command (lines are collected by Loop())
+    SIM7080G_ASYNC asyncState = SIM_ASYNC_IDLE; //State of the command slot
+    char asyncResponse[SIM7080G_ASYNC_BUFFER];  //Lines received since the command was sent
+    size_t asyncLength = 0;                     //Number of characters in asyncResponse
+    char asyncUntil[24] = { '\0' };             //Line prefix completing the command before the result code
+    uint32_t asyncStart = 0;                    //Time the command was sent
+    uint32_t asyncTimeout = 0;                  //Max time to wait for the result in ms
+    bool asyncDraining = false;                 //Slot discards the lines of an abandoned command until its result code
+    SIM7080G_URC_HOOK urcHook = nullptr;        //Observer of received lines
+    void* urcHookContext = nullptr;             //Context passed to urcHook
+#endif
+
+    //APP network link supervisor
+    SIM7080G_LINK_CONF linkConf;                //Supervisor configuration
+    SIM7080G_LINK_STATE linkState = SIM_LINK_DOWN;  //Current supervisor state
+    SIM7080G_LINK_STATS linkStats;              //Supervisor counters
+    uint8_t linkAttempts = 0;                   //Recovery attempts since the link was last up
+    uint8_t linkProbeFails = 0;                 //Consecutive failed probes
+    uint32_t linkLastTick = 0;                  //Time of the last supervisor tick
+    uint32_t linkLastTraffic = 0;               //Time data was last confirmed to flow
+    uint32_t linkRecoveryStart = 0;             //Time the current recovery started
+    bool linkRecovering = false;                //Recovery in progress
+    bool linkLost = false;                      //+APP PDP: <pdidx>,DEACTIVE received for the supervised context
+
+    //Power saving
+    SIM7080G_PSM_GRANT psmGrant;                //Timers granted by the network
+    SIM7080G_PSM_STATS psmStats;                //PSM counters
+    SIM7080G_EDRX_ACT edrxAct = SIM_EDRX_CATM;  //Access technology of the eDRX request
+    bool psmActive = false;                     //Module is in PSM
+    uint32_t psmEnterTime = 0;                  //Time the module entered PSM
+    bool psmWakePending = false;                //Waiting for the first data exchange after a wake-up
+    uint32_t psmWakeStart = 0;                  //Time of the last wake-up
+
+    //TCP/UDP sockets
+    SIM7080G_SOCKET sockets[SIM7080G_MAX_SOCKETS];
+
+#if SIM7080G_ENABLE_MQTT
+    //MQTT client
+    SIM7080G_MQTTCONF mqttConf;                 //Connection configuration of the persistent session
+    bool mqttConnected = false;                 //Broker connection state
+    SIM7080G_MQTT_STATS mqttStats;              //Publish counters
+    SIM7080G_MQTT_MSG mqttQueue[SIM7080G_MQTT_QUEUE];   //Messages waiting for MQTTFlush()
+    uint8_t mqttQueued = 0;                     //Number of messages in mqttQueue
+    SIM7080G_MQTT_MSG mqttInbox[SIM7080G_MQTT_INBOX];   //Received messages waiting for Loop()
+    uint8_t mqttInboxCount = 0;                 //Number of messages in mqttInbox
+    SIM7080G_MQTT_SUB mqttSubs[SIM7080G_MQTT_SUBS];     //Subscriptions
+    SIM7080G_MQTT_CALLBACK mqttCallback = nullptr;      //Callback for messages not matching a subscription callback
+#endif
+
+    //SSL/TLS
+    SIM7080G_TLSCONF tlsConf;                   //Last applied SSL context configuration
+    bool tlsConfigured = false;                 //SetTLS() was successful
+#if SIM7080G_ENABLE_HTTP
+    bool httpTLS = false;                       //HTTP session uses TLS
+#endif
+    SIM7080G_TLS_STATS tlsStats;                //Handshake counters
+    SIM7080G_TLS_CERT tlsCerts[SIM7080G_TLS_CERTS]; //Certificates uploaded since boot
+
+    //DNS cache
+    SIM7080G_DNS_ENTRY dnsCache[SIM7080G_DNS_CACHE];
+    uint32_t dnsTTL = SIM7080G_DNS_TTL;         //Lifetime of resolved addresses
+    uint32_t dnsNegativeTTL = SIM7080G_DNS_NEGATIVE_TTL;    //Lifetime of failed resolutions
+    SIM7080G_DNS_STATS dnsStats;                //Cache counters
+    int8_t dnsRefresh = -1;                     //Cache entry waiting for its +CDNSGIP refresh result
+    uint32_t dnsRefreshStart = 0;               //Time the refresh query was sent
+#if SIM7080G_ENABLE_HTTP
+    char httpHost[65] = { '\0' };               //Host name replaced by its address in the HTTP URL (sent as Host header)
+    uint32_t httpURLHash = 0;                   //Hash of the URL last configured on the module
+    uint16_t httpBodyLength = 0;                //Body length last configured on the module
+    uint16_t httpHeaderLength = 0;              //Header length last configured on the module
+#endif
+
+    //Session profiles
+#if SIM7080G_ENABLE_FTP
+    SIM7080G_FTPCONF ftpConf;                   //FTP parameters last set on the module
+    char ftpAddress[16] = { '\0' };             //Server address last set on the module
+#endif
+    uint32_t profileKnown = 0;                  //Bit per FTP / HTTP parameter known to be set on the module
+    SIM7080G_PROFILE_STATS profileStats;        //Profile counters
+
+    //Link characterisation
+    SIM7080G_LINK_PROFILE linkProfile;          //Transfer sizes used by FTP uploads and socket sends
+
+    //Ping probe
+    SIM7080G_PING_RESULT* pingResult = nullptr; //Result of the running probe
+    uint32_t pingTimeout = 0;                   //Reply timeout of the running probe
+    uint32_t pingDeadline = 0;                  //Time the running probe gives up on missing replies
+
+#if SIM7080G_ENABLE_COAP
+    //CoAP client
+    int coapSocket = -1;                        //UDP socket of the CoAP endpoint
+    bool coapBusy = false;                      //Request in progress
+    SIM7080G_COAP_TYPE coapType = SIM_COAP_CON; //Type of the current request
+    SIM7080G_COAP_METHOD coapMethod = SIM_COAP_GET; //Method of the current request
+    char coapPath[64] = { '\0' };               //Uri-Path of the current request
+    const uint8_t* coapPayload = nullptr;       //Payload of the current request (owned by the caller)
+    size_t coapLength = 0;                      //Payload length of the current request
+    uint32_t coapBlock1 = 0;                    //Current request block number
+    uint32_t coapBlock2 = 0;                    //Current response block number
+    uint16_t coapMessageId = 0;                 //Last message ID
+    uint32_t coapToken = 0;                     //Token of the current request
+    uint8_t coapRetries = 0;                    //Retransmissions of the current message
+    bool coapAcked = false;                     //Current message acknowledged, waiting for a separate response
+    uint32_t coapSentTime = 0;                  //Time the current message was (re)sent
+    uint32_t coapTimeout = 0;                   //Current retransmission timeout
+    SIM7080G_COAP_CALLBACK coapCallback = nullptr;  //Callback of the current request
+    uint8_t coapMessage[SIM7080G_COAP_BUFFER];  //Last message sent, kept for retransmission
+    size_t coapMessageLength = 0;               //Length of coapMessage
+    SIM7080G_COAP_STATS coapStats;              //CoAP counters
+#endif
+
+#if SIM7080G_ENABLE_CMUX
+    //GSM 07.10 multiplexer
+    bool cmuxActive = false;                    //Multiplexer running, commands go through DLCI 1
+    SIM7080G_CMUX_CHANNEL cmuxChannels[SIM7080G_CMUX_CHANNELS];    //Virtual channels (index: DLCI - 1)
+    uint8_t cmuxReply[SIM7080G_CMUX_CHANNELS + 1];  //Last UA / DM control field received per DLCI
+    uint8_t cmuxState = 0;                      //Frame parser state
+    uint8_t cmuxHeader[4];                      //Address, control and length of the frame being received
+    uint8_t cmuxHeaderLength = 0;               //Number of bytes in cmuxHeader
+    uint16_t cmuxLength = 0;                    //Information field length of the frame being received
+    uint16_t cmuxIndex = 0;                     //Information field bytes received
+    uint8_t cmuxControlData[16];                //Information field of the DLCI 0 frame being received
+    SIM7080G_CMUX_STATS cmuxStats;              //Multiplexer counters
+#endif
+
+    //Driver instances
+    static SIM7080G* instances[SIM7080G_MAX_INSTANCES];     //Registered instances (PollAll(), worker task)
+    static TaskHandle_t workerTask;             //Shared I/O worker task
+    static SemaphoreHandle_t workerExit;        //Given by the worker task when it leaves its loop
+    static volatile bool workerRun;             //Worker task keeps running
+    static uint32_t workerInterval;             //Worker poll interval in ms
+    static SIM7080G_WORKER_HOOK workerHook;     //Application code run by the worker
+
+#if SIM7080G_THREAD_SAFE
+    //Command arbitration
+    SemaphoreHandle_t laneMutex = nullptr;      //Protects the lane state below (held only briefly)
+    TaskHandle_t laneOwner = nullptr;           //Task running a transaction
+    SIM7080G_LANE laneOwnerLane = SIM_LANE_NORMAL;  //Lane of the running transaction
+    uint16_t laneDepth = 0;                     //Nesting depth of the owner's Lock() calls
+    uint8_t laneWaiting[SIM_LANES] = { 0 };     //Tasks waiting per lane
+    SIM7080G_LANE_STATS laneStats[SIM_LANES];   //Lane counters
+#if SIM7080G_ENABLE_CMUX
+    SemaphoreHandle_t cmuxMutex = nullptr;      //Serialises UART access of the multiplexer and the channel rings
+#endif
+#endif
+
+#if SIM7080G_DEBUG_LEVEL >= 1
+
+    //UART debug interface
+    //HardwareSerial& uartDebugInterface = Serial;
+    HWCDC& uartDebugInterface = Serial;
+
+#endif
+
+public:
+
+    /**
+     *  @brief Constructor
+    */
+    SIM7080G(uint8_t rx, uint8_t tx, uint8_t pwr, int dtr = -1, bool openUART = true, HardwareSerial& uart = Serial1);
+    //*OK
+
+    /**
+     *  @brief Destructor, removes the instance from PollAll() and the worker
+    */
+    ~SIM7080G();
+    //*OK
+
+    //
+    //  Instances
+    //
+
+    /**
+     *  @brief Run Loop(false) of every instance
+     * 
+     *  One call services all modems, instances without pending data return
+     *  after a UART availability check. The services that wait for the module
+     *  (network unlock after a lost cached registration, signal sampling and
+     *  deferred transmissions, time synchronisation) are skipped, call Loop()
+     *  of the instances that use them from the application (e.g. the worker
+     *  hook).
+    */
+    static void PollAll(void);
+    //*OK
+
+    /**
+     *  @brief Start a task that runs PollAll() for every instance
+     * 
+     *  With SIM7080G_THREAD_SAFE the instances can be used from other tasks
+     *  while the worker runs, otherwise call them only from the hook (or from
+     *  the callbacks it triggers).
+     * 
+     *  @param interval Time between polls in ms
+     *  @param hook Application code run by the worker after every poll
+     *  @param stackSize Task stack size in bytes
+     *  @param priority Task priority
+     * 
+     *  @returns Whether the task was created (or already runs)
+    */
+    static bool StartWorker(uint32_t interval = 10, SIM7080G_WORKER_HOOK hook = nullptr, uint32_t stackSize = 4096, uint8_t priority = 1);
+    //*OK
+
+    /**
+     *  @brief Stop the worker task after its current iteration
+     * 
+     *  Waits until the task left its loop, called from the hook it returns
+     *  immediately and the task exits after the hook.
+    */
+    static void StopWorker(void);
+    //*OK
+
+    /**
+     *  @brief Get the number of registered instances
+    */
+    static uint8_t GetInstanceCount(void);
+    //*OK
+
+    /**
+     *  @brief Get a registered instance
+     * 
+     *  @param index Index of the instance (0 - GetInstanceCount() - 1)
+     * 
+     *  @returns Instance or nullptr
+    */
+    static SIM7080G* GetInstance(uint8_t index);
+    //*OK
+
+    //
+    //  Arbitration
+    //
+
+    /**
+     *  @brief Reserve the modem for a transaction of the calling task
+     * 
+     *  Public functions lock their own lane, call this only to group several
+     *  of them into one transaction. Calls nest within a task. The lock is
+     *  granted once the modem is free and no task waits in a higher lane.
+     * 
+     *  @param lane Lane of the transaction
+     *  @param timeout Max time to wait in ms (UINT32_MAX: forever)
+     * 
+     *  @returns Whether the lock is held, always true without SIM7080G_THREAD_SAFE
+    */
+    bool Lock(SIM7080G_LANE lane = SIM_LANE_NORMAL, uint32_t timeout = UINT32_MAX);
+    //*OK
+
+    /**
+     *  @brief Release one level of Lock()
+    */
+    void Unlock(void);
+    //*OK
+
+    /**
+     *  @brief Get the counters of a lane
+    */
+    SIM7080G_LANE_STATS GetLaneStats(SIM7080G_LANE lane) const;
+    //*OK
+
+    /**
+     *  @brief Reset the lane counters
+    */
+    void ResetLaneStats(void);
+    //*OK
+
+    //
+    //  IO / Power control
+    //
+
+    /**
+     * 
+    */
+    void SetDTR(int dtr);
+    //
+
+    /**
+     *  @brief Set the pin connected to the module's STATUS output
+     * 
+     *  @param status STATUS pin (-1: not connected)
+    */
+    void SetStatusPin(int status);
+    //*OK
+
+    /**
+     *  @brief Power up module with PWR pin
+     * 
+     *  Waits until the module answers and applies the init profile.
+     * 
+     *  @returns Whether the module answers
+    */
+    bool PowerUp(void);
+    //*OK
+
+    /**
+     *  @brief Wait for a booting module to answer
+     * 
+     *  Probing starts once the STATUS pin (if set) is high. A RDY URC ends the
+     *  wait between probes.
+     * 
+     *  @param timeout Max wait in ms
+     * 
+     *  @returns Whether the module answers
+    */
+    bool WaitReady(uint32_t timeout = SIM7080G_BOOT_TIMEOUT);
+    //*OK
+
+    /**
+     *  @brief Configure echo, result codes, error reporting and URCs and save them with AT&W, then set flow control
+     * 
+     *  The module boots with the saved profile. If it answers without echo and
+     *  with numeric result codes and reports the saved +CEREG mode, only flow
+     *  control is set. The baud rate and flow control are not saved, so a
+     *  module outliving a host reset stays reachable with autobauding.
+     * 
+     *  @param force Configure and save even if the profile is stored
+     * 
+     *  @returns Whether the module runs with the profile
+    */
+    bool ApplyInitProfile(bool force = false);
+    //*OK
+
+    /**
+     *  @brief Get the boot counters
+    */
+    SIM7080G_BOOT_STATS GetBootStats(void) const;
+    //*OK
+
+    /**
+     *  @brief Reset the boot counters
+    */
+    void ResetBootStats(void);
+    //*OK
+
+    /**
+     *  @brief Power down module with PWR pin
+    */
+    void PowerDown(void);
+    //*OK
+
+    /**
+     *  @brief Get the module's power state
+     * 
+     *  @return Power state of the module
+    */
+    SIM7080G_PWR GetPowerState(void) const;
+    //*OK
+
+    /**
+     *  @brief Reboot module
+    */
+    void Reboot(void);
+    //*OK
+
+    /**
+     *  @brief Put the module to sleep mode with dtr pin
+    */
+    void EnterSleep(void);
+    //*OK
+
+    /**
+     *  @brief Wake the module from sleep mode with dtr pin
+    */
+    void LeaveSleep(void);
+    //*OK
+
+    //
+    //  UART 
+    //
+
+    /**
+     *  @brief Open serial interface
+    */
+    void OpenUART(void);
+    //*OK
+
+    /**
+     *  @brief Close serial interface
+    */
+    void CloseUART(void);
+    //*OK
+
+    /**
+     *  @brief Flush data from UART FIFO
+    */
+    void FlushUART(void);
+    //*OK
+
+    /**
+     * @brief Get nuber of bytes in the UART RX FIFO
+     * 
+     * @return Number of bytes in the RX FIFO
+    */
+    size_t AvailableUART(void);
+    //*OK
+
+    /**
+     *  @brief Get serial interface status
+     * 
+     *  @return true: Serial open | false: Serial closed
+    */
+    bool GetUART(void) const;
+    //*OK
+
+    /**
+     *  @brief Get the specified baudrate
+     * 
+     *  @return Serial baudrate
+    */
+    uint64_t GetBaudrate(void) const;
+    //*OK
+
+    /**
+     *  @brief Raise the UART baudrate as far as the link allows and enable hardware flow control
+     * 
+     *  Every candidate rate is set with AT+IPR and verified with echoed round trips,
+     *  a failing rate falls back to the last verified one. The echo setting is kept.
+     * 
+     *  @param maxBaudrate Highest baudrate to try (module maximum: 3686400)
+     *  @param rtsPin Host RTS pin connected to the module's RTS input (-1: no flow control)
+     *  @param ctsPin Host CTS pin connected to the module's CTS output (-1: no flow control)
+     * 
+     *  @returns Baudrate in use after the negotiation (0 if the module does not respond,
+     *  also when it stops answering after a failed rate; the host then stays at the
+     *  last verified rate)
+    */
+    uint32_t NegotiateBaudrate(uint32_t maxBaudrate = 3686400, int rtsPin = -1, int ctsPin = -1);
+    //*OK
+
+#if SIM7080G_ENABLE_CMUX
+    /**
+     *  @brief Start the GSM 07.10 multiplexer (AT+CMUX, basic option)
+     * 
+     *  The driver's commands move to DLCI 1, the other channels can be read and
+     *  written through GetCMUXChannel() independently (e.g. GNSS polling while an
+     *  FTP upload runs).
+     * 
+     *  @returns Whether the control channel and DLCI 1 were established
+    */
+    bool StartCMUX(void);
+    //*OK
+
+    /**
+     *  @brief Close every channel and leave multiplexer mode (CLD)
+    */
+    void StopCMUX(void);
+    //*OK
+
+    /**
+     *  @brief Get multiplexer state
+     * 
+     *  @return true: Multiplexer running | false: Plain AT interface
+    */
+    bool CMUXActive(void) const;
+    //*OK
+
+    /**
+     *  @brief Get a virtual channel
+     * 
+     *  @param dlci DLCI of the channel (2 - SIM7080G_CMUX_CHANNELS, DLCI 1 is used by the driver)
+     * 
+     *  @returns Channel stream or nullptr if the channel is not established
+    */
+    Stream* GetCMUXChannel(uint8_t dlci);
+    //*OK
+
+    /**
+     *  @brief Get multiplexer counters
+    */
+    SIM7080G_CMUX_STATS GetCMUXStats(void) const;
+    //*OK
+#endif
+
+    /**
+     *  @brief Sent AT command to the module
+     * 
+     *  @param command      Char array containing the command with null terminator
+     *  @param response     Char array to store the response (if nullptr response will be discarded)
+     *  @param timeout      Maximum amount of time to wait for response (if response not NULL)
+     * 
+     *  @return Number of bytes received as response (including null terminator)
+    */
+    size_t SendCommand(const char* command, char* response, uint32_t timeout = 0);
+    //*OK
+
+    /**
+     *  @brief Send AT command and wait for ERROR or OK
+     * 
+     *  @param command      Char array containing the command with null terminator
+     *  @param timeout      Maximum amount of time to wait for response
+     * 
+     *  @return true: command successfull | false: command error
+    */
+    bool SendCommand(const char* command, uint32_t timeout = 0);
+    //*OK
+
+    /**
+     *  @brief Send len number of bytes to the module
+     * 
+     *  @param src          Array of data to send
+     *  @param len          Number of bytes to send
+    */
+    void Send(uint8_t* src, size_t len);
+    //*OK
+
+    /**
+     *  @brief Receive len number of bytes from the module
+     * 
+     *  @param dst          Array to store the received data
+     *  @param len          Number of bytes to receive (If 0 all available data will be read)
+     *  @param timeout      Maximum amount of time to wait for response
+     *  
+     *  @return Number of bytes actually received
+    */
+    size_t Receive(uint8_t* dst, size_t len = 0, uint32_t timeout = 0);
+    //*OK
+
+    /**
+     *  @brief Test UART communication with device.
+     * 
+     *  @return True: Communcation OK | False: No response from device
+    */
+    bool TestUART(void);
+    //*OK
+
+    /**
+     *  @brief Set AT command response format
+    */
+    void SetTAResponseFormat(bool textResponse = false);
+    //*OK
+
+    /**
+     *  @brief Set command echo mode
+     * 
+     *  @param echo Enable or disable command echo
+    */
+    bool SetEcho(bool echo);
+    //*OK
+
+    /**
+     *  @brief Process unsolicited result codes received since the last call. Call periodically.
+     * 
+     *  @param blocking Also run the services that wait for the module (network
+     *  unlock after a lost cached registration, signal sampling and deferred
+     *  transmissions, time synchronisation)
+    */
+    void Loop(bool blocking = true);
+    //*OK
+
+#if SIM7080G_ENABLE_ASYNC
+    //  #
+    //  #   Non-blocking commands
+    //  #
+
+    /**
+     *  @brief Send a command without waiting for the result
+     * 
+     *  The response is collected by Loop(). Do not call blocking functions
+     *  while the command is pending, they would consume its response.
+     * 
+     *  @param command Command to send
+     *  @param timeout Max time to wait for the result in ms
+     *  @param until Line prefix that completes the command before a result code (e.g. "+FTPPUT: 2,")
+     * 
+     *  @returns False if the slot is not free (see CommandRelease())
+    */
+    bool CommandStart(const char* command, uint32_t timeout = 1000, const char* until = nullptr);
+    //*OK
+
+    /**
+     *  @brief Get the state of the non-blocking command, checks the timeout
+    */
+    SIM7080G_ASYNC CommandPoll(void);
+    //*OK
+
+    /**
+     *  @brief Get the lines received for the non-blocking command
+     * 
+     *  @returns Response, valid until the next CommandStart()
+    */
+    const char* CommandResponse(void) const;
+    //*OK
+
+    /**
+     *  @brief Free the command slot once the result was read, abandons a pending command
+     * 
+     *  A pending or timed out command keeps the slot busy until the module
+     *  sent its result code or SIM7080G_ASYNC_DRAIN passed, its lines are
+     *  discarded.
+    */
+    void CommandRelease(void);
+    //*OK
+
+    /**
+     *  @brief Observe every received line (URCs and command responses)
+     * 
+     *  @param hook Observer, nullptr to remove it
+     *  @param context Passed to the hook
+    */
+    void SetURCHook(SIM7080G_URC_HOOK hook, void* context = nullptr);
+    //*OK
+#endif
+
+    //  #
+    //  #   Command metrics
+    //  #
+
+    /**
+     *  @brief Copy the per command family metrics
+     * 
+     *  Latency runs from sending a command to the last byte of its exchange,
+     *  including data phases and waits for final result codes.
+     * 
+     *  @param dst Array to store the metrics
+     *  @param max Size of dst
+     * 
+     *  @returns Number of families copied (0 if SIM7080G_METRICS is 0)
+    */
+    uint8_t GetCommandMetrics(SIM7080G_CMD_METRICS* dst, uint8_t max);
+    //*OK
+
+    /**
+     *  @brief Reset command metrics and the trace
+    */
+    void ResetCommandMetrics(void);
+    //*OK
+
+    /**
+     *  @brief Print a table of the command metrics (calls, errors, bytes, latency percentiles)
+     * 
+     *  @param out Destination (Serial, a file, ...)
+    */
+    void ExportMetrics(Print& out);
+    //*OK
+
+    /**
+     *  @brief Print the recent commands as Chrome trace JSON (chrome://tracing, Perfetto)
+     * 
+     *  @param out Destination (Serial, a file, ...)
+    */
+    void ExportTrace(Print& out);
+    //*OK
+
+    //  #
+    //  #   Event trace
+    //  #
+
+    /**
+     *  @brief Take recorded events out of the trace ring (binary, e.g. for a host tool)
+     * 
+     *  Status functions that are polled in loops record compact events instead of
+     *  printing. May be called from another task than the one using the driver.
+     * 
+     *  @param dst Array to store the events
+     *  @param max Size of dst
+     * 
+     *  @returns Number of events taken (0 if SIM7080G_TRACE is 0)
+    */
+    size_t ReadTrace(SIM7080G_TRACE_EVENT* dst, size_t max);
+    //*OK
+
+    /**
+     *  @brief Take recorded events out of the trace ring and print them as text
+     * 
+     *  @param out Destination (e.g. the debug interface, from a low priority task)
+     *  @param max Max number of events to print (0: all)
+     * 
+     *  @returns Number of events printed
+    */
+    size_t PrintTrace(Print& out, size_t max = 0);
+    //*OK
+
+    /**
+     *  @brief Get the number of events dropped because the ring was full
+    */
+    uint32_t GetTraceDropped(void) const;
+    //*OK
+
+    /**
+     *  @brief Print the RAM used by every buffer and subsystem of this configuration
+     * 
+     *  @param out Destination (Serial, a file, ...)
+    */
+    static void ReportFootprint(Print& out);
+    //*OK
+
+    //  #
+    //  #   Shadow state
+    //  #
+
+    /**
+     *  @brief Get the shadow state counters
+    */
+    SIM7080G_SHADOW_STATS GetShadowStats(void) const;
+    //*OK
+
+    /**
+     *  @brief Reset the shadow state counters (the boot measurement is kept)
+    */
+    void ResetShadowStats(void);
+    //*OK
+
+    /**
+     *  @brief Set how long a learned state answers getters
+     * 
+     *  States changed by URCs (PIN, APP networks, sessions) are updated as
+     *  long as Loop() runs, the TTL bounds the age of the rest.
+     * 
+     *  @param ttl Time in ms, 0 to always query the module
+    */
+    void SetShadowTTL(uint32_t ttl);
+    //*OK
+
+    /**
+     *  @brief Drop the learned state, the next getters query the module
+     * 
+     *  @param boot The module restarted: drop the identity and the FTP / HTTP parameters set on it too
+    */
+    void InvalidateShadow(bool boot = false);
+    //*OK
+
+    /**
+     *  @brief Get the IMEI (AT+CGSN), read once per boot
+     * 
+     *  @returns IMEI or "" if the module did not answer
+    */
+    const char* GetIMEI(void);
+    //*OK
+
+    /**
+     *  @brief Get the ICCID of the SIM (AT+CCID), read once per boot
+     * 
+     *  @returns ICCID or "" if the module did not answer
+    */
+    const char* GetICCID(void);
+    //*OK
+
+    /**
+     *  @brief Get the firmware revision (AT+CGMR), read once per boot
+     * 
+     *  @returns Revision or "" if the module did not answer
+    */
+    const char* GetFirmware(void);
+    //*OK
+
+    //  #
+    //  #   Cellular network parameters
+    //  #
+
+    /**
+     *  @brief Get cellular network registration status
+     * 
+     *  @return Registration status (See SIM7080G AT Command Manual page 63)
+    */
+    uint8_t GetNetworkReg(void);
+    //*OK
+
+    /**
+     *  @brief Get cellular signal quality report
+     * 
+     *  @return RSSI
+    */
+    uint8_t GetSignalQuality(void);
+    //*OK
+
+    /**
+     *  @brief List available operators to serial debug interface
+     * 
+     *  @param debugInterface       
+    */
+    //void GetCellOperators(HardwareSerial& debugInterface);
+    //! TODO
+
+    /**
+     *  @brief List available operators to software serial debug interface
+    */
+    //void GetCellOperators(SoftwareSerial& debugInterface) const;
+    //! TODO
+
+    /**
+     *  @brief List available operators (AT+COPS=?), scans every band and takes up to minutes
+     * 
+     *  @param dst                  Char array to store the results
+     *  @param len                  Size of dst, a longer list is truncated
+     * 
+     *  @return Number of bytes written to dst
+    */
+    size_t GetCellOperators(char* dst, size_t len);
+    //*OK
+
+    /**
+     *  @brief Select cellular operator to use
+     * 
+     *  @param plmn MCC and MNC ("26201"), NULL for automatic selection
+     *  @param rat RAT to register with (SIM_RAT_NONE: any)
+     *  @param fallback Select automatically if the operator is not found
+     * 
+     *  @returns Whether the operation was successful
+    */
+    bool SetCellOperator(const char* plmn, SIM7080G_RAT rat = SIM_RAT_NONE, bool fallback = true);
+    //*OK
+
+    /**
+     *  @brief Get the registered operator (AT+COPS?)
+     * 
+     *  @param dst Char array to store the MCC and MNC (min 8 characters long)
+     * 
+     *  @returns Whether the module is registered with an operator
+    */
+    bool GetCellOperator(char* dst);
+    //*OK
+
+    /**
+     *  @brief Get the serving cell (AT+CPSI?)
+     * 
+     *  @returns Whether the module reported a serving cell
+    */
+    bool GetCellInfo(SIM7080G_CELL_INFO& info);
+    //*OK
+
+    /**
+     *  @brief Set the bands scanned by a RAT (AT+CBANDCFG)
+     * 
+     *  @param rat SIM_RAT_CATM or SIM_RAT_NBIOT
+     *  @param bands Comma separated band numbers ("3,8,20")
+     * 
+     *  @returns Whether the operation was successful
+    */
+    bool SetBands(SIM7080G_RAT rat, const char* bands);
+    //*OK
+
+    /**
+     *  @brief Select the RATs scanned (AT+CMNB)
+     * 
+     *  @returns Whether the operation was successful
+    */
+    bool SetRAT(SIM7080G_RAT rat);
+    //*OK
+
+    /**
+     *  @brief Register with the network, the last serving network first
+     * 
+     *  The scan is restricted to the cached operator, RAT and band. If the
+     *  module does not register within SIM7080G_REG_CACHED_TIMEOUT, every
+     *  band of both RATs is scanned with automatic operator selection. The
+     *  serving network is cached on success. After a registration on the
+     *  cached network, all bands and automatic operator selection are
+     *  restored at the next SetCellFunction(0) or, once the registration
+     *  is lost, in the next Loop(). Doing it while attached could trigger
+     *  a new PLMN selection or a detach.
+     * 
+     *  @param timeout Max time to wait for the registration in ms
+     * 
+     *  @returns Whether the module is registered
+    */
+    bool RegisterNetwork(uint32_t timeout = 600000);
+    //*OK
+
+    /**
+     *  @brief Get the last serving network
+     * 
+     *  The cache is kept per SIM (keyed by the ICCID), so several modems
+     *  on different carriers do not share it. Reads the ICCID if needed.
+    */
+    SIM7080G_NET_CACHE GetNetworkCache(void);
+    //*OK
+
+    /**
+     *  @brief Replace the last serving network (e.g. restored by the application)
+     * 
+     *  @param cache Network to scan first, an empty PLMN clears the cache
+    */
+    void SetNetworkCache(const SIM7080G_NET_CACHE cache);
+    //*OK
+
+    /**
+     *  @brief Get the registration counters
+    */
+    SIM7080G_REG_STATS GetRegStats(void) const;
+    //*OK
+
+    /**
+     *  @brief Set the RAT policy
+    */
+    void SetRATPolicy(const SIM7080G_RAT_POLICY policy);
+    //*OK
+
+    /**
+     *  @brief Add a link measurement of the serving RAT
+     * 
+     *  Registrations, CharacteriseLink() and ping probes add measurements on
+     *  their own, add the goodput of the application's transfers here.
+     * 
+     *  @param rtt Round trip time in ms (0: not measured)
+     *  @param goodput Goodput in bytes/s (0: not measured)
+    */
+    void AddRATSample(uint32_t rtt, uint32_t goodput);
+    //*OK
+
+    /**
+     *  @brief Compare the RATs at the serving site and switch if the serving one underperforms
+     * 
+     *  Call while idle, e.g. before a transmission window. A switch cycles the
+     *  cell function and waits for the registration, it is undone if the
+     *  module does not register.
+     * 
+     *  @param apply Switch, otherwise only log the decision
+     * 
+     *  @returns Serving RAT (or the selected one if apply is false)
+    */
+    SIM7080G_RAT EvaluateRAT(bool apply = true);
+    //*OK
+
+    /**
+     *  @brief Get the measurements of the serving site
+     * 
+     *  @returns Whether the site is known (registered with RegisterNetwork())
+    */
+    bool GetRATSite(SIM7080G_RAT_SITE& site) const;
+    //*OK
+
+    /**
+     *  @brief Take a signal sample (AT+CPSI?, AT+CESQ and AT+CSQ without a serving cell)
+     * 
+     *  @returns Whether the module reported a signal
+    */
+    bool SampleSignal(void);
+    //*OK
+
+    /**
+     *  @brief Set how Loop() samples the signal
+     * 
+     *  @param interval Time between samples in ms
+     *  @param always Sample without waiting transmissions too (otherwise only while one waits)
+    */
+    void SetSignalSampling(uint32_t interval, bool always = false);
+    //*OK
+
+    /**
+     *  @brief Get the smoothed signal
+    */
+    SIM7080G_SIGNAL GetSignal(void) const;
+    //*OK
+
+    /**
+     *  @brief Get the signal samples, oldest first
+     * 
+     *  @param dst Array to store the samples
+     *  @param max Size of dst
+     * 
+     *  @returns Number of samples copied
+    */
+    size_t GetSignalHistory(SIM7080G_SIGNAL_SAMPLE* dst, size_t max) const;
+    //*OK
+
+    /**
+     *  @brief Defer a transmission until the link is good enough or the deadline expires
+     * 
+     *  Loop() samples the signal while transmissions wait and calls the callback
+     *  once the smoothed coverage enhancement level is at most maxCE, or when
+     *  maxDelay expired. The callback may use the driver.
+     * 
+     *  @param callback Function sending the data
+     *  @param context Passed to the callback
+     *  @param maxDelay Deadline in ms (0: run on the next Loop())
+     *  @param maxCE Highest coverage enhancement level to transmit at before the deadline (0-2)
+     * 
+     *  @returns Transmission id or -1 if the queue is full
+    */
+    int ScheduleTransmit(SIM7080G_TX_CALLBACK callback, void* context, uint32_t maxDelay, uint8_t maxCE = 0);
+    //*OK
+
+    /**
+     *  @brief Cancel a deferred transmission
+     * 
+     *  @returns Whether it was still waiting
+    */
+    bool CancelTransmit(int id);
+    //*OK
+
+    /**
+     *  @brief Get the transmit scheduler counters
+    */
+    SIM7080G_TX_STATS GetTxStats(void) const;
+    //*OK
+
+    /**
+     *  @brief Reset the transmit scheduler counters
+    */
+    void ResetTxStats(void);
+    //*OK
+
+    /**
+     *  @brief Take a time sample and update the host clock
+     * 
+     *  The clock keeps Unix time as an offset against millis() and measures the
+     *  host clock drift between samples far enough apart. A sample replaces the
+     *  reference when its error is lower than the current clock error.
+     * 
+     *  @param source SIM_TIME_RTC, SIM_TIME_NTP or SIM_TIME_GNSS (GNSS must be running).
+     *                SIM_TIME_NETWORK samples arrive as URCs, see SetNetworkTime()
+     *  @param server NTP server (nullptr: SIM7080G_NTP_SERVER)
+     * 
+     *  @returns Whether a sample was taken
+    */
+    bool SyncTime(SIM7080G_TIME_SOURCE source = SIM_TIME_RTC, const char* server = nullptr);
+    //*OK
+
+    /**
+     *  @brief Enable network time updates (AT+CLTS), each *PSUTTZ URC is a time sample
+    */
+    bool SetNetworkTime(bool enable);
+    //*OK
+
+    /**
+     *  @brief Set the clock error bound
+     * 
+     *  @param maxError Bound in ms, GetUnixTime() fails beyond it
+     *  @param autoSource Source Loop() synchronises from before the bound is reached (SIM_TIME_NONE: none)
+    */
+    void SetTimeSync(uint32_t maxError, SIM7080G_TIME_SOURCE autoSource = SIM_TIME_NONE);
+    //*OK
+
+    /**
+     *  @brief Get the Unix time from the host clock, no module I/O
+     * 
+     *  @param unixMs Receives the milliseconds since 1970-01-01 UTC
+     * 
+     *  @returns Whether the clock is within its error bound
+    */
+    bool GetUnixTime(uint64_t& unixMs) const;
+    //*OK
+
+    /**
+     *  @brief Get the clock state
+    */
+    SIM7080G_TIME_STATUS GetTimeStatus(void) const;
+    //*OK
+
+    /**
+     *  @brief Get the RAT decisions, oldest first
+     * 
+     *  @param dst Array to store the decisions
+     *  @param max Size of dst
+     * 
+     *  @returns Number of decisions copied
+    */
+    size_t GetRATLog(SIM7080G_RAT_DECISION* dst, size_t max) const;
+    //*OK
+
+    /**
+     *  @brief Reset the registration counters
+    */
+    void ResetRegStats(void);
+    //*OK
+
+    /**
+     *  @brief Get cellular (phone) functionality
+     * 
+     *  @return Functionality code (See SIM7080G AT Command Manual page 70)
+    */
+    uint8_t GetCellFunction(void);
+    //*OK
+
+    /**
+     *  @brief Set cellular (phone) functionality
+     * 
+     *  @param functionCode 0: Minimum | 1: Full | 4: Flight mode (See SIM7080G AT Command Manual page 70)
+     * 
+     *  @returns Whether the operation was successful
+    */
+    bool SetCellFunction(uint8_t functionCode);
+    //*OK
+
+    /**
+     *  @brief Get the UTC time from the host clock ("yy/MM/dd,hh:mm:ss+00"), synchronises from the module clock first if needed
+     * 
+     *  @param dst          Char array to store time and date (min 21 characters long, including \0)
+     * 
+     *  @returns Whether the clock is within its error bound
+    */
+    bool GetTime(char* dst);
+    //*OK
+
+    /**
+     *  @brief Enter SIM PIN code
+     * 
+     *  @param pin          SIM PIN code
+    */
+    bool EnterPIN(const char* pin, bool force = false);
+    //*OK
 
-    //Serial communication
+    /**
+     *  @brief Get SIM PIN status
+    */
+    bool GetPINStatus(void);
+    //*OK
 
-    uint8_t uartTX = 0;                  //UART TX pin
-    uint8_t uartRX = 0;                  //UART RX pin
+    /**
+     *  @brief Configure an APP network PDP context (APN, authentication, IP type)
+     * 
+     *  @param pdidx PDP context index (0-3)
+     *  @param conf PDP context configuration
+     * 
+     *  @returns Whether the operation was successful
+    */
+    bool SetPDPContext(uint8_t pdidx, const SIM7080G_PDPCONF conf);
+    //*OK
 
-    uint64_t uartBaudrate = 921600;             //UART Baudrate     (921600)
-    HardwareSerial& uartInterface = Serial1;    //UART interface to use
+    /**
+     *  @brief Activate APP network and wait for the +APP PDP: <pdidx>,ACTIVE URC
+     * 
+     *  @param pdidx PDP context index (0-3)
+     *  @param timeout Maximum time to wait for the activation in ms
+     * 
+     *  @returns Whether the APP network is active
+    */
+    bool ActivateAppNetwork(uint8_t pdidx = 0, uint32_t timeout = 30000);
+    //*OK
 
-    const static size_t uartMaxRecvSize = 4096; //Max number of bytes to receive (Must be divisible by 4)
-    size_t uartRecvtimeout = 100;               //Wait this ammount of ms after last received byte before returning. ( used in Receive() )
-                                                //if 0 timeout will be ignored
+    /**
+     *  @brief Deactivate APP network and wait for the +APP PDP: <pdidx>,DEACTIVE URC
+     * 
+     *  @param pdidx PDP context index (0-3)
+     *  @param timeout Maximum time to wait for the deactivation in ms
+     * 
+     *  @returns Whether the APP network is inactive
+    */
+    bool DeactivateAppNetwork(uint8_t pdidx = 0, uint32_t timeout = 10000);
+    //*OK
 
-    uint32_t uartResponseTimeout = 50;    //Time to wait before reading response from device
+    /**
+     *  @brief Get APP network status
+     * 
+     *  @param pdidx PDP context index (0-3)
+     * 
+     *  @returns 0: Inactive | 1: Active | 2: In operation
+    */
+    uint8_t GetAppNetworkStatus(uint8_t pdidx = 0);
+    //*OK
 
-    char rxBuffer[uartMaxRecvSize];
-    //char txBuffer[100];
+    /**
+     *  @brief Get the active APP network PDP contexts with a single query
+     * 
+     *  @returns Bitmask of active contexts (bit n: pdidx n)
+    */
+    uint8_t GetActiveAppNetworks(void);
+    //*OK
 
-    //Power control
-    int dtrKey = -1;                        //Send module to light sleep (active high)
-    uint8_t pwrKey = 0;                    //Power on/off the module
+    /**
+     *  @brief Get App Network details
+     * 
+     *  @param info Pointer to SIM7080G_APPN struct to store APP network details
+     *  @param pdidx PDP context index (0-3)
+    */
+    void GetAppNetworkInfo(SIM7080G_APPN* info, uint8_t pdidx = 0);
+    //*OK
 
-    //
-    bool uartOpen = false;                      //UART interface state
-    SIM7080G_PWR pwrState = SIM_PWDN;           //Power state
+    /**
+     *  @brief Get App Network details of PDP context 0
+     * 
+     *  @returns SIM7080G_APPN struct containing APP network details
+    */
+    SIM7080G_APPN GetAppNetworkInfo(void);
+    //*OK
 
-#if SIM7080G_DEBUG_LEVEL >= 1
+    /**
+     *  @brief Configure the APP network link supervisor
+     * 
+     *  @param conf Supervisor configuration
+    */
+    void SetLinkSupervisor(const SIM7080G_LINK_CONF conf);
+    //*OK
 
-    //UART debug interface
-    //HardwareSerial& uartDebugInterface = Serial;
-    HWCDC& uartDebugInterface = Serial;
+    /**
+     *  @brief Run one step of the APP network link supervisor. Call periodically.
+     * 
+     *  Activates the link, verifies that data flows and escalates through
+     *  PDP re-activation -> CFUN cycle -> reboot when the link stalls.
+     * 
+     *  @returns Link state after the step
+    */
+    SIM7080G_LINK_STATE SuperviseLink(void);
+    //*OK
 
-#endif
+    /**
+     *  @brief Get the link supervisor state
+     * 
+     *  @returns Link state
+    */
+    SIM7080G_LINK_STATE GetLinkState(void) const;
+    //*OK
 
-public:
+    /**
+     *  @brief Get the link supervisor counters
+     * 
+     *  @returns Availability and recovery counters
+    */
+    SIM7080G_LINK_STATS GetLinkStats(void) const;
+    //*OK
 
     /**
-     *  @brief Constructor
+     *  @brief Reset the link supervisor counters
     */
-    SIM7080G(uint8_t rx, uint8_t tx, uint8_t pwr, int dtr = -1, bool openUART = true);
+    void ResetLinkStats(void);
     //*OK
 
-    //
-    //  IO / Power control
-    //
+    /**
+     *  @brief Tell the supervisor that data was exchanged successfully (postpones the next probe)
+    */
+    void NotifyLinkTraffic(void);
+    //*OK
+
+    //  #
+    //  #   Power saving (PSM / eDRX)
+    //  #
 
     /**
+     *  @brief Request power saving mode timers (AT+CPSMS)
+     * 
+     *  Timers are rounded up to the next value the network encoding can carry.
+     *  The network decides, check GetPowerSavingGrant() for what was granted.
      * 
+     *  @param enable Enable or disable PSM
+     *  @param tau Requested periodic TAU (T3412 extended) in s
+     *  @param activeTime Requested active time (T3324) in s
+     * 
+     *  @returns Whether the PSM URCs were enabled and the request was accepted by the module
     */
-    void SetDTR(int dtr);
-    //
+    bool SetPSM(bool enable, uint32_t tau = 3600, uint32_t activeTime = 60);
+    //*OK
 
     /**
-     *  @brief Power up module with PWR pin
+     *  @brief Request an eDRX cycle (AT+CEDRXS)
+     * 
+     *  @param enable Enable or disable eDRX
+     *  @param act Access technology the request applies to
+     *  @param cycle Requested eDRX cycle in ms (rounded up to the next valid value, 5120 - 10485760)
+     * 
+     *  @returns Whether the request was accepted by the module
     */
-    void PowerUp(void);
+    bool SetEDRX(bool enable, SIM7080G_EDRX_ACT act = SIM_EDRX_CATM, uint32_t cycle = 81920);
     //*OK
 
     /**
-     *  @brief Power down module with PWR pin
+     *  @brief Get the power saving timers granted by the network (AT+CEREG?, AT+CEDRXRDP)
+     * 
+     *  @param refresh Query the module (false: last values received in URCs)
+     * 
+     *  @returns Granted timers
     */
-    void PowerDown(void);
+    SIM7080G_PSM_GRANT GetPowerSavingGrant(bool refresh = true);
     //*OK
 
     /**
-     *  @brief Get the module's power state
+     *  @brief Get PSM state (from +CPSMSTATUS URCs)
      * 
-     *  @return Power state of the module
+     *  @return true: Module in PSM | false: Module awake
     */
-    SIM7080G_PWR GetPowerState(void) const;
+    bool InPSM(void) const;
     //*OK
 
     /**
-     *  @brief Reboot module
+     *  @brief Wake the module from PSM with the PWRKEY pin
+     * 
+     *  An awake module is left alone, otherwise a short PWRKEY pulse
+     *  (SIM7080G_PSM_WAKE_PULSE) wakes it. The pulse starts the wake-to-data
+     *  latency measurement, which ends at the next successful data exchange.
+     * 
+     *  @param timeout Maximum amount of time to wait for the module to respond in ms
+     * 
+     *  @returns Whether the module responds
     */
-    void Reboot(void);
+    bool WakeFromPSM(uint32_t timeout = 5000);
     //*OK
 
     /**
-     *  @brief Put the module to sleep mode with dtr pin
+     *  @brief Get power saving counters
     */
-    void EnterSleep(void);
+    SIM7080G_PSM_STATS GetPSMStats(void) const;
     //*OK
 
     /**
-     *  @brief Wake the module from sleep mode with dtr pin
+     *  @brief Reset power saving counters
     */
-    void LeaveSleep(void);
+    void ResetPSMStats(void);
     //*OK
 
-    //
-    //  UART 
-    //
+
+    //  #
+    //  #   IP applications
+    //  #
 
     /**
-     *  @brief Open serial interface
+     *  @brief Ping an IPv4 address (blocking)
+     * 
+     *  @param address IP address or host name to ping
+     *  @param pingCount Ping count (1 - 500)
+     *  @param packetSize Ping packet's size in bytes (1-1400)
+     *  @param timeout Maximum time to wai for reply in ms (1 - 60000)
+     *  @param result Optional struct to store RTT statistics
+     * 
+     *  @returns Successful ping count
     */
-    void OpenUART(void);
+    int Ping4(const char* address, uint16_t pingCount = 4, uint16_t packetSize = 64, uint32_t timeout = 2500, SIM7080G_PING_RESULT* result = nullptr);
     //*OK
 
     /**
-     *  @brief Close serial interface
+     *  @brief Start a ping probe without blocking. +SNPING4 replies are collected by Loop().
+     * 
+     *  @param result Struct to store RTT statistics (must stay valid until result->done)
+     *  @param address IP address or host name to ping
+     *  @param pingCount Ping count (1 - 500)
+     *  @param packetSize Ping packet's size in bytes (1-1400)
+     *  @param timeout Maximum time to wai for reply in ms (1 - 60000)
+     * 
+     *  @returns Whether the probe was started (one probe at a time)
     */
-    void CloseUART(void);
+    bool Ping4Start(SIM7080G_PING_RESULT* result, const char* address, uint16_t pingCount = 4, uint16_t packetSize = 64, uint32_t timeout = 2500);
     //*OK
 
     /**
-     *  @brief Flush data from UART FIFO
+     *  @brief Get ping probe state
+     * 
+     *  @returns Whether a probe is running
     */
-    void FlushUART(void);
+    bool Ping4Busy(void) const;
     //*OK
 
     /**
-     * @brief Get nuber of bytes in the UART RX FIFO
+     *  @brief Characterise the link and derive FTP and socket transfer sizes from it
      * 
-     * @return Number of bytes in the RX FIFO
+     *  Probes RTT against payload size to find the effective MTU and the serialisation
+     *  cost per byte, then measures goodput with short upload bursts on socket (if given).
+     *  The result is applied to FTPUpload() and SocketSend().
+     * 
+     *  @param address IP address or host name to ping
+     *  @param profile Struct to store the result (optional)
+     *  @param socket Open TCP socket to a sink for the upload bursts (-1: estimate goodput from the RTT slope)
+     * 
+     *  @returns Whether the link could be characterised
     */
-    size_t AvailableUART(void);
+    bool CharacteriseLink(const char* address, SIM7080G_LINK_PROFILE* profile = nullptr, int socket = -1);
     //*OK
 
     /**
-     *  @brief Get serial interface status
+     *  @brief Get the link profile in use
      * 
-     *  @return true: Serial open | false: Serial closed
+     *  @returns Link profile (valid is false until measured or set)
     */
-    bool GetUART(void) const;
+    SIM7080G_LINK_PROFILE GetLinkProfile(void) const;
     //*OK
 
     /**
-     *  @brief Get the specified baudrate
+     *  @brief Set the link profile, e.g. one stored from an earlier measurement on the same cell
      * 
-     *  @return Serial baudrate
+     *  @param profile Link profile (valid = false restores the module's defaults)
     */
-    uint64_t GetBaudrate(void) const;
+    void SetLinkProfile(const SIM7080G_LINK_PROFILE profile);
     //*OK
 
+
+    //  #
+    //  #   TCP/UDP sockets
+    //  #
+
     /**
-     *  @brief Sent AT command to the module
+     *  @brief Open a TCP or UDP connection
      * 
-     *  @param command      Char array containing the command with null terminator
-     *  @param response     Char array to store the response (if nullptr response will be discarded)
-     *  @param timeout      Maximum amount of time to wait for response (if response not NULL)
+     *  @param type Socket protocol
+     *  @param host Server IP address or domain name
+     *  @param port Server port
+     *  @param pdidx PDP context to bind the connection to (0-3)
+     *  @param tls Use the SSL context configured with SetTLS() (TCP only)
      * 
-     *  @return Number of bytes received as response (including null terminator)
+     *  @returns Socket ID (0-12) or SIM7080_INVALID_PARAMETER on failure
     */
-    size_t SendCommand(const char* command, char* response, uint32_t timeout = 0);
+    int SocketOpen(SIM7080G_SOCKET_TYPE type, const char* host, uint16_t port, uint8_t pdidx = 0, bool tls = false);
     //*OK
 
     /**
-     *  @brief Send AT command and wait for ERROR or OK
+     *  @brief Close a connection (received data not yet read is discarded)
      * 
-     *  @param command      Char array containing the command with null terminator
-     *  @param timeout      Maximum amount of time to wait for response
+     *  @param id Socket ID
      * 
-     *  @return true: command successfull | false: command error
+     *  @returns Whether the operation was successful
     */
-    bool SendCommand(const char* command, uint32_t timeout = 0);
+    bool SocketClose(uint8_t id);
     //*OK
 
     /**
-     *  @brief Send len number of bytes to the module
+     *  @brief Send data on a connection (split into AT+CASEND sized chunks if needed)
      * 
-     *  @param src          Array of data to send
-     *  @param len          Number of bytes to send
+     *  @param id Socket ID
+     *  @param src Data to send
+     *  @param len Number of bytes to send
+     * 
+     *  @returns Number of bytes sent
     */
-    void Send(uint8_t* src, size_t len);
+    size_t SocketSend(uint8_t id, const uint8_t* src, size_t len);
     //*OK
 
     /**
-     *  @brief Receive len number of bytes from the module
+     *  @brief Read received data without blocking. Data is fetched from the module by Loop().
+     *  UDP sockets return one datagram per call, the part of a datagram that does not fit in dst is discarded.
      * 
-     *  @param dst          Array to store the received data
-     *  @param len          Number of bytes to receive (If 0 all available data will be read)
-     *  @param timeout      Maximum amount of time to wait for response
-     *  
-     *  @return Number of bytes actually received
+     *  @param id Socket ID
+     *  @param dst Buffer to store the data
+     *  @param len Size of dst
+     * 
+     *  @returns Number of bytes read
     */
-    size_t Receive(uint8_t* dst, size_t len = 0, uint32_t timeout = 0);
+    size_t SocketRead(uint8_t id, uint8_t* dst, size_t len);
     //*OK
 
     /**
-     *  @brief Test UART communication with device.
+     *  @brief Get number of received bytes waiting to be read
      * 
-     *  @return True: Communcation OK | False: No response from device
+     *  @param id Socket ID
+     * 
+     *  @returns Number of bytes in the socket's receive buffer
     */
-    bool TestUART(void);
+    size_t SocketAvailable(uint8_t id) const;
     //*OK
 
     /**
-     *  @brief Set AT command response format
+     *  @brief Get connection state
+     * 
+     *  @param id Socket ID
+     * 
+     *  @returns Whether the connection is open
     */
-    void SetTAResponseFormat(bool textResponse = false);
+    bool SocketConnected(uint8_t id) const;
     //*OK
 
+
+    //  #
+    //  #   DNS
+    //  #
+
     /**
-     *  @brief Set command echo mode
+     *  @brief Resolve a host name through the DNS cache (AT+CDNSGIP on a miss)
      * 
-     *  @param echo Enable or disable command echo
+     *  @param host Host name or IPv4 address
+     *  @param ip Buffer to store the IPv4 address (min 16 characters)
+     * 
+     *  @returns Whether the host could be resolved
     */
-    bool SetEcho(bool echo);
+    bool ResolveHost(const char* host, char* ip);
+    //*OK
+
+    /**
+     *  @brief Set DNS cache lifetimes
+     * 
+     *  @param ttl Lifetime of resolved addresses in ms
+     *  @param negativeTtl Lifetime of failed resolutions in ms
+    */
+    void SetDNSTTL(uint32_t ttl, uint32_t negativeTtl = SIM7080G_DNS_NEGATIVE_TTL);
+    //*OK
+
+    /**
+     *  @brief Drop every cached resolution
+    */
+    void FlushDNSCache(void);
+    //*OK
+
+    /**
+     *  @brief Get DNS cache counters
+     * 
+     *  @returns DNS cache counters
+    */
+    SIM7080G_DNS_STATS GetDNSStats(void) const;
     //*OK
 
+
     //  #
-    //  #   Cellular network parameters
+    //  #   SSL/TLS
     //  #
 
     /**
-     *  @brief Get cellular network registration status
+     *  @brief Upload a certificate or key to the module's file system if its content changed
      * 
-     *  @return Registration status (See SIM7080G AT Command Manual page 63)
+     *  A hash of the content is stored next to the file (<name>.fnv), so unchanged
+     *  certificates are neither written nor converted again, even after a reboot.
+     * 
+     *  @param name File name on the module (e.g. "ca.crt")
+     *  @param data Certificate or key in PEM format
+     *  @param length Data length
+     * 
+     *  @returns Whether the file on the module matches data (false if SIM7080G_TLS_CERTS files are already tracked)
     */
-    uint8_t GetNetworkReg(void);
+    bool UploadCertificate(const char* name, const uint8_t* data, size_t length);
     //*OK
 
     /**
-     *  @brief Get cellular signal quality report
+     *  @brief Configure an SSL context and convert certificates that changed since the last upload
      * 
-     *  @return RSSI
+     *  @param conf SSL context configuration
+     * 
+     *  @returns Whether the operation was successful
     */
-    uint8_t GetSignalQuality(void);
+    bool SetTLS(const SIM7080G_TLSCONF conf);
     //*OK
 
     /**
-     *  @brief List available operators to serial debug interface
+     *  @brief Get SSL/TLS handshake counters
      * 
-     *  @param debugInterface       
+     *  @returns SSL/TLS counters
     */
-    //void GetCellOperators(HardwareSerial& debugInterface);
-    //! TODO
+    SIM7080G_TLS_STATS GetTLSStats(void) const;
+    //*OK
 
     /**
-     *  @brief List available operators to software serial debug interface
+     *  @brief Reset SSL/TLS handshake counters
+    */
+    void ResetTLSStats(void);
+    //*OK
+
+
+#if SIM7080G_ENABLE_MQTT
+    //  #
+    //  #   MQTT
+    //  #
+
+    /**
+     *  @brief Configure the module's MQTT client and connect to the broker
+     * 
+     *  @param conf Connection configuration, kept for automatic reconnects
+     * 
+     *  @returns Whether the connection was successful
+    */
+    bool MQTTConnect(const SIM7080G_MQTTCONF conf);
+    //*OK
+
+    /**
+     *  @brief Disconnect from the broker
+    */
+    void MQTTDisconnect(void);
+    //*OK
+
+    /**
+     *  @brief Get broker connection state
+     * 
+     *  @returns Whether the client is connected
     */
-    //void GetCellOperators(SoftwareSerial& debugInterface) const;
-    //! TODO
+    bool MQTTConnected(void) const;
+    //*OK
 
     /**
-     *  @brief List available operators to software serial debug interface
+     *  @brief Publish a message right away (reconnects if the session dropped)
      * 
-     *  @param dst                  Char array to store the results
+     *  @param topic Topic
+     *  @param payload Message payload
+     *  @param length Payload length
+     *  @param qos QoS 0 or 1
+     *  @param retain Retain flag
      * 
-     *  @return Number of bytes written to dst
+     *  @returns Whether the publish was successful
     */
-    //size_t GetCellOperators(char* dst);
-    //! TODO
+    bool MQTTPublish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos = 0, bool retain = false);
+    //*OK
 
     /**
-     *  @brief Select cellular operator to use
+     *  @brief Queue a message for the next batched publish (flushes automatically when the queue is full)
+     * 
+     *  @param topic Topic
+     *  @param payload Message payload (max SIM7080G_MQTT_PAYLOAD bytes)
+     *  @param length Payload length
+     *  @param qos QoS 0 or 1
+     *  @param retain Retain flag
+     * 
+     *  @returns Whether the message was queued
     */
-    //void SetCellOperator(const char* opName);
-    //! TODO
+    bool MQTTQueue(const char* topic, const uint8_t* payload, size_t length, uint8_t qos = 0, bool retain = false);
+    //*OK
 
     /**
-     *  @brief Get cellular (phone) functionality
+     *  @brief Publish every queued message back-to-back on the current session
      * 
-     *  @return Functionality code (See SIM7080G AT Command Manual page 70)
+     *  @returns Number of messages published
     */
-    //uint8_t GetCellFunction(void);
-    //! TODO
+    size_t MQTTFlush(void);
+    //*OK
 
     /**
-     *  @brief Set cellular (phone) functionality
+     *  @brief Subscribe to a topic (re-subscribed automatically after reconnects)
+     * 
+     *  @param topic Topic filter
+     *  @param qos QoS 0 or 1
+     *  @param callback Callback for matching messages (nullptr: use MQTT callback)
+     * 
+     *  @returns Whether the operation was successful
     */
-    //void SetCellFunction(uint8_t functionCode);
-    //! TODO
+    bool MQTTSubscribe(const char* topic, uint8_t qos = 0, SIM7080G_MQTT_CALLBACK callback = nullptr);
+    //*OK
 
     /**
-     *  @brief Get chip time
+     *  @brief Unsubscribe from a topic
      * 
-     *  @param dst          Char array to store time and date (min 21 characters long, including \0)
+     *  @param topic Topic filter
+     * 
+     *  @returns Whether the operation was successful
     */
-    //void GetTime(char* dst);
-    //! TODO
+    bool MQTTUnsubscribe(const char* topic);
+    //*OK
 
     /**
-     *  @brief Enter SIM PIN code
+     *  @brief Set callback for inbound messages without a subscription callback. Called from Loop().
      * 
-     *  @param pin          SIM PIN code
+     *  @param callback Inbound message callback
     */
-    bool EnterPIN(const char* pin, bool force = false);
+    void SetMQTTCallback(SIM7080G_MQTT_CALLBACK callback);
     //*OK
 
     /**
-     *  @brief Get SIM PIN status
+     *  @brief Get MQTT publish latency and throughput counters
+     * 
+     *  @returns MQTT counters
     */
-    bool GetPINStatus(void);
+    SIM7080G_MQTT_STATS GetMQTTStats(void) const;
     //*OK
 
     /**
-     *  @brief Activate APP network
+     *  @brief Reset MQTT counters
     */
-    bool ActivateAppNetwork(void);
+    void ResetMQTTStats(void);
     //*OK
 
+
+#endif
+
+#if SIM7080G_ENABLE_COAP
+    //  #
+    //  #   CoAP
+    //  #
+
     /**
-     *  @brief Deactivate APP network
+     *  @brief Open the CoAP endpoint (UDP)
+     * 
+     *  @param host Server IP address or domain name
+     *  @param port Server port (Default: 5683)
+     *  @param pdidx PDP context to use (0-3)
+     * 
+     *  @returns Whether the operation was successful
     */
-    bool DeactivateAppNetwork(void);
+    bool CoAPOpen(const char* host, uint16_t port = 5683, uint8_t pdidx = 0);
     //*OK
 
     /**
-     *  @brief Get APP network status
+     *  @brief Close the CoAP endpoint (a request in progress is dropped)
     */
-    uint8_t GetAppNetworkStatus(void);
+    void CoAPClose(void);
     //*OK
 
     /**
-     *  @brief Get App Network details
+     *  @brief Start a CoAP request. Progress is driven by Loop(), the response is passed to the callback.
      * 
-     *  @param info Pointer to SIM7080G_APPN struct to store APP network details
+     *  Payloads larger than one block are sent block-wise (Block1), block-wise responses (Block2)
+     *  are fetched automatically and passed to the callback block by block.
+     * 
+     *  @param method Request method
+     *  @param path Uri-Path (e.g. "sensors/temp")
+     *  @param payload Request payload, must stay valid until the final callback
+     *  @param length Payload length
+     *  @param type Confirmable or non-confirmable
+     *  @param callback Response callback (response->code is 0 if the request failed)
+     * 
+     *  @returns Whether the request was started (one request at a time)
     */
-    void GetAppNetworkInfo(SIM7080G_APPN* info);
+    bool CoAPRequest(SIM7080G_COAP_METHOD method, const char* path, const uint8_t* payload = nullptr, size_t length = 0, SIM7080G_COAP_TYPE type = SIM_COAP_CON, SIM7080G_COAP_CALLBACK callback = nullptr);
     //*OK
 
     /**
-     *  @brief Get App Network details
+     *  @brief Get CoAP request state
      * 
-     *  @returns SIM7080G_APPN struct containing APP network details
+     *  @returns Whether a request is in progress
     */
-    SIM7080G_APPN GetAppNetworkInfo(void);
+    bool CoAPBusy(void) const;
     //*OK
 
-
-    //  #
-    //  #   IP applications
-    //  #
-
     /**
-     *  @brief Ping an IPv4 address
-     * 
-     *  @param address IP address to ping
-     *  @param pingCount Ping count (1 - 500)
-     *  @param packetSize Ping packet's size in bytes (1-1400)
-     *  @param timeout Maximum time to wai for reply in ms (1 - 60000)
+     *  @brief Get CoAP counters
      * 
-     *  @returns Successful ping count
+     *  @returns CoAP counters
     */
-    int Ping4(const char* address, uint16_t pingCount = 4, uint16_t packetSize = 64, uint32_t timeout = 2500);
-    //TODO
+    SIM7080G_COAP_STATS GetCoAPStats(void) const;
+    //*OK
 
 
+#endif
+
+#if SIM7080G_ENABLE_HTTP
     //  #
     //  #   HTTP(S) applications
     //  #
@@ -497,6 +2945,9 @@ public:
     /**
      *  @brief Set HTTP request parameters
      * 
+     *  Only parameters that differ from the last configuration are sent. The
+     *  connection is kept if the URL did not change.
+     * 
      *  @param httpConf HTTP configuration
      *  @param build Auto build HTTP request
      * 
@@ -530,6 +2981,8 @@ public:
 
     /**
      *  @brief CLear HTTP header
+     * 
+     *  The Host header of a URL that holds the cached address is added again.
     */
     bool ClearHTTPHeader(void);
     //*OK
@@ -566,6 +3019,9 @@ public:
     //*OK
 
 
+#endif
+
+#if SIM7080G_ENABLE_FTP
     //  #
     //  #   File Transfer Protocol (FTP)
     //  #
@@ -599,9 +3055,9 @@ public:
     //*OK
 
     /**
-     *  @brief Set FTP PDP identifier (Note: APP network defaults to ID 0 for now)
+     *  @brief Bind FTP sessions to an APP network PDP context
      * 
-     *  @param pdpidx PDP identifier
+     *  @param pdpidx PDP context index (0-3)
      * 
      *  @returns Whether the operation was successful
     */
@@ -621,7 +3077,7 @@ public:
     /**
      *  @brief Set FTP Server IP address
      * 
-     *  @param ip Server IP address as string or domain name (Only if DNS available)
+     *  @param ip Server IP address or domain name (resolved through the DNS cache)
      * 
      *  @returns Whether the operation was successful
     */
@@ -688,6 +3144,34 @@ public:
     bool SetFTPUpFP(const char* filePath);
     //*OK
 
+    /**
+     *  @brief Apply an FTP session profile
+     * 
+     *  Only parameters that differ from the ones last set on the module (by a
+     *  profile or the setters above) are sent.
+     * 
+     *  @param conf Profile
+     * 
+     *  @returns Whether the operation was successful
+    */
+    bool SetFTPProfile(const SIM7080G_FTPCONF conf);
+    //*OK
+#endif
+
+    /**
+     *  @brief Get the FTP / HTTP profile counters
+    */
+    SIM7080G_PROFILE_STATS GetProfileStats(void) const;
+    //*OK
+
+    /**
+     *  @brief Reset the FTP / HTTP profile counters
+    */
+    void ResetProfileStats(void);
+    //*OK
+
+#if SIM7080G_ENABLE_FTP
+
     /**
      *  @brief Upload specified file to FTP server
      * 
@@ -754,6 +3238,9 @@ public:
     void CloseFTPSession(void);
     //*OK
 
+#endif
+
+#if SIM7080G_ENABLE_GNSS
     //  #
     //  #   GLobal Navigation Satellite System
     //  #
@@ -828,6 +3315,8 @@ public:
     bool GetGNSSLock(void);
     //TODO
 
+#endif
+
     //  #
     //  #   Power Info
     //  #
@@ -842,12 +3331,90 @@ public:
 
 private:
 
+    /**
+     *  @brief Worker task body
+    */
+    static void WorkerTask(void* parameter);
+
+    /**
+     *  @brief Lock() body
+     * 
+     *  @param count Count the acquisition in the lane counters (false: a yielding transaction resumes)
+    */
+    bool AcquireLane(SIM7080G_LANE lane, uint32_t timeout, bool count);
+
+    /**
+     *  @brief Step aside for waiting higher lanes at a chunk boundary of a transfer, then resume
+    */
+    void YieldLane(void);
+
     /**
      *  @brief Power cycle the module with PWRKEY pin
+     * 
+     *  @param pulse PWRKEY low time in ms (a short pulse only wakes the module from PSM)
     */
-    inline void PowerCycle(void);
+    inline void PowerCycle(uint32_t pulse = 1100);
     //*OK
 
+    /**
+     *  @brief Send AT and wait for a result code in any format
+     * 
+     *  @param stored Set if the answer has no echo and a numeric result code
+     * 
+     *  @returns Whether the module answered
+    */
+    bool ProbeAT(bool& stored);
+
+    /**
+     *  @brief Verify the UART link with echoed round trips
+     * 
+     *  @param rounds           Number of round trips
+     *  @param echo             Echo setting restored afterwards
+     * 
+     *  @returns Whether every echo and result matched
+    */
+    bool VerifyUART(uint8_t rounds, bool echo);
+
+    /**
+     *  @brief Switch the host UART to a baudrate
+    */
+    void SetHostBaudrate(uint32_t baudrate);
+
+    /**
+     *  @brief Stream carrying the driver's commands (DLCI 1 while the multiplexer runs, the UART otherwise)
+    */
+    Stream& Transport(void);
+
+    /**
+     *  @brief Command metrics helpers
+    */
+    void MetricsBegin(const char* command);
+    void MetricsEnd(size_t bytesIn, bool timeout);
+    void MetricsFail(void);
+    void MetricsCommit(void);
+    static uint8_t MetricsBucket(uint32_t ms);
+
+    /**
+     *  @brief Record a trace event (never blocks, drops the event if the ring is full)
+    */
+    void Trace(SIM7080G_TRACE_ID id, int32_t a = 0, int32_t b = 0);
+
+#if SIM7080G_ENABLE_CMUX
+    /**
+     *  @brief Multiplexer helpers
+    */
+    void CMUXPoll(void);
+    void CMUXParse(uint8_t c);
+    void CMUXFrame(void);
+    void CMUXControl(void);
+    void CMUXSendFrame(uint8_t dlci, uint8_t control, const uint8_t* data = nullptr, size_t len = 0, bool response = false);
+    size_t CMUXWrite(uint8_t dlci, const uint8_t* data, size_t len);
+    bool CMUXConnect(uint8_t dlci, uint8_t control, uint32_t timeout);
+    void CMUXFlowControl(uint8_t dlci, bool stop);
+    void CMUXReset(void);
+    static uint8_t CMUXFcs(const uint8_t* data, size_t len);
+#endif
+
     /**
      *  @brief Erase RX Buffer
      * 
@@ -855,11 +3422,259 @@ private:
     */
     void EraseRXBuff(uint32_t value = 0x04040404);
 
+#if SIM7080G_ENABLE_HTTP
     /**
      * 
     */
     bool AddHTTPContent(const char* type, const char* value, const char* command);
 
+    /**
+     *  @brief Add the Host header of a URL that holds the cached address (counted in HEADERLEN)
+    */
+    bool AddHTTPHost(void);
+#endif
+
+    /**
+     *  @brief Find a context's +CNACT line in rxBuffer
+     * 
+     *  @returns Pointer to the status field of the line or nullptr
+    */
+    char* FindAppNetwork(uint8_t pdidx);
+
+    /**
+     *  @brief Read from the module into rxBuffer until token is received
+     * 
+     *  @param token            String to wait for (checked against the last response first)
+     *  @param timeout          Maximum amount of time to wait in ms
+     * 
+     *  @returns Whether the token was received
+    */
+    bool WaitForResponse(const char* token, uint32_t timeout);
+
+    /**
+     *  @brief Read from the module into rxBuffer until a numeric result code line is received
+     * 
+     *  @param timeout          Maximum amount of time to wait in ms
+     * 
+     *  @returns true: OK (0) | false: error or timeout
+    */
+    bool WaitForResult(uint32_t timeout);
+
+    /**
+     *  @brief Send a command that answers with a > prompt, then the data, and wait for the result
+     * 
+     *  @param command          Command with null terminator
+     *  @param src              Data to send after the prompt
+     *  @param len              Number of bytes to send
+     *  @param timeout          Maximum amount of time to wait for the result in ms
+     * 
+     *  @returns Whether the data was accepted
+    */
+    bool SendData(const char* command, const uint8_t* src, size_t len, uint32_t timeout, const char* prompt = ">");
+
+    /**
+     *  @brief Read a file from the module's customer directory
+     * 
+     *  @returns Number of bytes read
+    */
+    size_t ReadModuleFile(const char* name, char* dst, size_t len);
+
+    /**
+     *  @brief Write a file to the module's customer directory
+     * 
+     *  @returns Whether the operation was successful
+    */
+    bool WriteModuleFile(const char* name, const uint8_t* data, size_t len);
+
+    /**
+     *  @brief Convert a pending certificate and store its hash
+    */
+    bool ConvertCertificate(uint8_t type, const char* name, const char* key = nullptr);
+
+    /**
+     *  @brief Classify and count a TLS handshake
+    */
+    void RecordHandshake(uint32_t duration, bool success);
+
+    /**
+     *  @brief Move data waiting in the module into a socket's receive buffer (AT+CARECV)
+    */
+    void SocketFetch(uint8_t id);
+
+#if SIM7080G_ENABLE_MQTT
+    /**
+     *  @brief MQTT helpers
+    */
+    bool MQTTEnsureConnected(void);
+    bool MQTTSendPublish(const char* topic, const uint8_t* payload, size_t length, uint8_t qos, bool retain);
+    void MQTTDeliver(void);
+    static bool MQTTTopicMatch(const char* filter, const char* topic);
+#endif
+
+    /**
+     *  @brief Dispatch the received lines to HandleURC() and end an overdue ping probe
+    */
+    void ReadURC(void);
+
+    /**
+     *  @brief Start the refresh of one used DNS cache entry that is about to expire
+     * 
+     *  The +CDNSGIP result is picked up by HandleURC(), a missing one is given up here.
+    */
+    void RefreshDNS(void);
+
+    /**
+     *  @brief Apply the +CDNSGIP result of the running refresh
+     * 
+     *  @param line +CDNSGIP line (nullptr: no result)
+    */
+    void RefreshDNSDone(const char* line);
+
+    /**
+     *  @brief Query the module's resolver (AT+CDNSGIP) and store the result in entry
+    */
+    bool LookupHost(SIM7080G_DNS_ENTRY* entry);
+
+    /**
+     *  @brief Store a +CDNSGIP result in entry
+     * 
+     *  @param line +CDNSGIP line (nullptr: no result)
+     * 
+     *  @returns Whether an address was resolved
+    */
+    bool ParseDNS(SIM7080G_DNS_ENTRY* entry, const char* line);
+
+    /**
+     *  @brief Check whether a string is a dotted IPv4 address
+    */
+    static bool IsIPv4(const char* address);
+
+    /**
+     *  @brief Ping probe helpers
+    */
+    void PingReply(uint32_t rtt);
+    void PingFinish(void);
+
+public:
+
+    /**
+     *  @brief Histogram bucket of an RTT (exact below 4 ms, then 4 buckets per power of two)
+    */
+    static uint8_t PingBucket(uint32_t rtt);
+
+    /**
+     *  @brief Lower bound of a histogram bucket in ms
+    */
+    static uint32_t PingBucketFloor(uint8_t bucket);
+
+private:
+
+#if SIM7080G_ENABLE_COAP
+    /**
+     *  @brief CoAP helpers
+    */
+    bool CoAPSendMessage(void);
+    void CoAPService(void);
+    void CoAPFinish(uint8_t code, const uint8_t* payload, size_t length, bool more);
+    static size_t CoAPPutOption(uint8_t* dst, uint16_t delta, const uint8_t* value, size_t length);
+#endif
+
+    /**
+     *  @brief Pass every line of data to HandleURC()
+    */
+    void ScanURC(const char* data);
+
+    /**
+     *  @brief Update driver state from an unsolicited result code line. Must not send commands.
+    */
+    void HandleURC(const char* line);
+
+#if SIM7080G_ENABLE_ASYNC
+    /**
+     *  @brief Add a line to the response of the non-blocking command and detect its end
+    */
+    void CommandLine(const char* line);
+#endif
+
+    /**
+     *  @brief Shadow state helpers
+    */
+#if SIM7080G_SHADOW
+    bool ShadowFresh(uint8_t field, bool count = true);
+    void ShadowSet(uint8_t field);
+#endif
+    void ShadowBoot(void);
+    void ReadIdentity(const char* command, char* dst, size_t len);
+
+    /**
+     *  @brief Session profile helpers
+    */
+    bool ProfileStale(uint8_t field, bool differs);
+    bool ProfileKnown(uint8_t field, bool result);
+    bool ProfileText(uint8_t field, char* dst, size_t size, const char* value, bool result);
+
+    /**
+     *  @brief Network selection helpers
+    */
+    void UnlockNetwork(void);
+    void LoadNetworkCache(void);
+    void StoreNetworkCache(void);
+    bool NoteServingCell(uint32_t regTime, bool sameSite = false);     //regTime 0: no registration measured
+    uint32_t RATCost(const SIM7080G_RAT_SCORE& score, const SIM7080G_RAT_SCORE& other) const;
+    void LogRAT(SIM7080G_RAT from, SIM7080G_RAT to, SIM7080G_RAT_REASON reason, uint32_t cost, uint32_t otherCost);
+    bool SwitchRAT(SIM7080G_RAT rat);
+
+    /**
+     *  @brief Signal sampler and transmit scheduler helpers
+    */
+    void AddSignalSample(const SIM7080G_SIGNAL_SAMPLE& sample);
+    void TransmitService(void);
+
+    /**
+     *  @brief Clock helpers
+    */
+    bool ReadRTC(SIM7080G_TIME_SOURCE source);
+    void TimeSample(uint64_t unixMs, uint32_t at, uint32_t error, SIM7080G_TIME_SOURCE source);
+    uint32_t TimeError(void) const;
+    void TimeService(void);
+
+    /**
+     *  @brief Power saving helpers
+    */
+    void ParseCEREG(const char* line);
+    void ParseEDRX(const char* line);
+    static void EncodePSMTimer(uint32_t seconds, bool tau, char* dst);
+    static uint32_t DecodePSMTimer(const char* bits, bool tau);
+
+    /**
+     *  @brief Link supervisor helpers
+    */
+    bool ProbeLink(void);
+    void EscalateLink(void);
+    void LinkRecovered(uint32_t now);
+    bool WaitRegistration(uint32_t timeout);
+
+};
+
+/**
+ *  @brief Scoped SIM7080G::Lock()
+*/
+class SIM7080G_LOCK {
+
+    SIM7080G* modem;
+    bool held;
+
+public:
+
+    SIM7080G_LOCK(SIM7080G* modem, SIM7080G_LANE lane = SIM_LANE_NORMAL, uint32_t timeout = UINT32_MAX);
+    ~SIM7080G_LOCK();
+    SIM7080G_LOCK(const SIM7080G_LOCK&) = delete;
+    SIM7080G_LOCK& operator=(const SIM7080G_LOCK&) = delete;
+
+    /**
+     *  @brief Whether the lock was granted
+    */
+    bool Held(void) const;
 };
 
 #endif  //SIM7080G_H
@@ -871,3 +3686,5 @@ private:
 #define SIM7080_INVALID_RETURN_VALUE        255     // If a function got no response from the device or the response cannot be processed, return this value indicating the error
 #define SIM7080_INVALID_PARAMETER           -1      //The function received invalid parameter(s)
 #define SIM7080_SIGNAL_QUALITY_UNKNOWN      99      //Value 99 indicates thaat the signal quality is unknown (SIM7080 AT Command manual)
+#define SIM7080_SIGNAL_UNKNOWN              INT16_MIN   //Signal measurement not reported by the module
+#define SIM7080_CE_UNKNOWN                  UINT8_MAX   //Coverage enhancement level not estimated (no RSRP measured)
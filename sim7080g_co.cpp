@@ -0,0 +1,492 @@
+//Header files
+#include "sim7080g_co.h"
+
+#if defined(__cpp_impl_coroutine) && SIM7080G_ENABLE_ASYNC
+
+//  #
+//  #   Task
+//  #
+
+//
+SIM7080G_TASK SIM7080G_TASK::promise_type::get_return_object() noexcept {
+    return SIM7080G_TASK(std::coroutine_handle<promise_type>::from_promise(*this));
+}
+
+//
+std::coroutine_handle<> SIM7080G_TASK::promise_type::FinalAwaiter::await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+    promise_type& promise = handle.promise();
+
+    //Lines consumed by the child are consumed for the parent too
+    if (promise.parent)
+        promise.parent->urcMark = promise.urcMark;
+
+    if (promise.continuation)
+        return promise.continuation;
+    return std::noop_coroutine();
+}
+
+//
+SIM7080G_TASK::SIM7080G_TASK(SIM7080G_TASK&& other) noexcept : handle(other.handle) {
+    other.handle = nullptr;
+}
+
+//
+SIM7080G_TASK& SIM7080G_TASK::operator=(SIM7080G_TASK&& other) noexcept {
+    if (this != &other) {
+        if (handle)
+            handle.destroy();
+        handle = other.handle;
+        other.handle = nullptr;
+    }
+    return *this;
+}
+
+//
+SIM7080G_TASK::~SIM7080G_TASK() {
+    if (handle)
+        handle.destroy();
+}
+
+//
+std::coroutine_handle<> SIM7080G_TASK::await_suspend(std::coroutine_handle<promise_type> parent) noexcept {
+    promise_type& child = handle.promise();
+    child.continuation = parent;
+    child.parent = &parent.promise();
+    child.root = parent.promise().root;
+    child.loop = parent.promise().loop;
+    child.urcMark = parent.promise().urcMark;
+    return handle;
+}
+
+//  #
+//  #   Awaitables
+//  #
+
+//
+bool SIM7080G_CO_WAIT::await_suspend(std::coroutine_handle<SIM7080G_TASK::promise_type> handle) {
+    promise = &handle.promise();
+    this->handle = handle;
+    start = millis();
+
+    //A cancelled task runs to its end without waiting
+    if (promise->root->cancelled) {
+        result.status = SIM_ASYNC_CANCELLED;
+        return false;
+    }
+
+    //Completed right away
+    if (Poll())
+        return false;
+
+    promise->loop->Queue(this);
+    return true;
+}
+
+//
+SIM7080G_CO_COMMAND::SIM7080G_CO_COMMAND(SIM7080G& modem, const char* command, uint32_t timeout, const char* until)
+    : SIM7080G_CO_WAIT(UINT32_MAX), modem(modem), command(command), until(until), commandTimeout(timeout) {}
+
+//
+bool SIM7080G_CO_COMMAND::Poll() {
+    //Wait for the command slot of the modem
+    if (!started) {
+        uint32_t mark = promise->loop->lineSeq;
+        if (!modem.CommandStart(command, commandTimeout, until))
+            return false;
+        promise->urcMark = mark;
+        started = true;
+        return false;
+    }
+
+    SIM7080G_ASYNC state = modem.CommandPoll();
+    if (state == SIM_ASYNC_PENDING)
+        return false;
+
+    //The response stays in the driver until the next command starts
+    result.status = state;
+    result.text = modem.CommandResponse();
+    modem.CommandRelease();
+    return true;
+}
+
+//
+void SIM7080G_CO_COMMAND::Abort() {
+    if (started)
+        modem.CommandRelease();
+}
+
+//
+SIM7080G_CO_URC::SIM7080G_CO_URC(SIM7080G& modem, const char* prefix, uint32_t timeout)
+    : SIM7080G_CO_WAIT(timeout), modem(modem), prefix(prefix) {}
+
+//
+bool SIM7080G_CO_URC::Poll() {
+    const char* line = promise->loop->FindLine(&modem, prefix, promise->urcMark);
+    if (!line)
+        return false;
+
+    result.status = SIM_ASYNC_OK;
+    result.text = line;
+    return true;
+}
+
+//
+SIM7080G_CO_DELAY::SIM7080G_CO_DELAY(uint32_t ms) : SIM7080G_CO_WAIT(UINT32_MAX), ms(ms) {}
+
+//
+bool SIM7080G_CO_DELAY::Poll() {
+    if (millis() - start < ms)
+        return false;
+
+    result.status = SIM_ASYNC_OK;
+    return true;
+}
+
+//  #
+//  #   Loop
+//  #
+
+//
+SIM7080G_CO_LOOP::~SIM7080G_CO_LOOP() {
+    for (uint8_t i = 0; i < SIM7080G_CO_MODEMS; i++)
+        if (modems[i])
+            modems[i]->SetURCHook(nullptr);
+
+    for (uint8_t i = 0; i < SIM7080G_CO_TASKS; i++)
+        if (tasks[i])
+            tasks[i].destroy();
+}
+
+//
+bool SIM7080G_CO_LOOP::Attach(SIM7080G& modem) {
+    for (uint8_t i = 0; i < SIM7080G_CO_MODEMS; i++)
+        if (modems[i] == &modem)
+            return true;
+
+    for (uint8_t i = 0; i < SIM7080G_CO_MODEMS; i++) {
+        if (!modems[i]) {
+            modems[i] = &modem;
+            modem.SetURCHook(LineHook, this);
+            return true;
+        }
+    }
+    return false;
+}
+
+//
+void SIM7080G_CO_LOOP::Detach(SIM7080G& modem) {
+    for (uint8_t i = 0; i < SIM7080G_CO_MODEMS; i++) {
+        if (modems[i] == &modem) {
+            modem.SetURCHook(nullptr);
+            modems[i] = nullptr;
+        }
+    }
+}
+
+//
+int SIM7080G_CO_LOOP::Spawn(SIM7080G_TASK task, uint32_t deadline, SIM7080G_CO_RESULT* result) {
+    if (!task.handle)
+        return -1;
+
+    for (uint8_t i = 0; i < SIM7080G_CO_TASKS; i++) {
+        if (tasks[i])
+            continue;
+
+        //The loop owns the frame from now on
+        tasks[i] = task.handle;
+        task.handle = nullptr;
+        taskResults[i] = result;
+
+        SIM7080G_TASK::promise_type& promise = tasks[i].promise();
+        promise.loop = this;
+        promise.urcMark = lineSeq;
+        promise.hasDeadline = deadline > 0;
+        promise.deadline = millis() + deadline;
+
+        //Run up to the first await
+        tasks[i].resume();
+        return i;
+    }
+    return -1;
+}
+
+//
+bool SIM7080G_CO_LOOP::Cancel(int id) {
+    if (id < 0 || id >= SIM7080G_CO_TASKS || !tasks[id])
+        return false;
+
+    tasks[id].promise().cancelled = true;
+    return true;
+}
+
+//
+bool SIM7080G_CO_LOOP::Done(int id) const {
+    return id < 0 || id >= SIM7080G_CO_TASKS || !tasks[id];
+}
+
+//
+uint8_t SIM7080G_CO_LOOP::Busy() const {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < SIM7080G_CO_TASKS; i++)
+        if (tasks[i])
+            count++;
+    return count;
+}
+
+//
+void SIM7080G_CO_LOOP::Poll() {
+    //Collect responses and URCs, the blocking services would stall every task
+    for (uint8_t i = 0; i < SIM7080G_CO_MODEMS; i++)
+        if (modems[i])
+            modems[i]->Loop(false);
+
+    //Resume completed awaits (awaiters queued by resumed tasks wait for the next pass)
+    SIM7080G_CO_WAIT* prev = nullptr;
+    SIM7080G_CO_WAIT* wait = waitHead;
+    SIM7080G_CO_WAIT* last = waitTail;
+
+    while (wait) {
+        SIM7080G_CO_WAIT* next = wait->next;
+        bool isLast = wait == last;
+
+        SIM7080G_TASK::promise_type* root = wait->promise->root;
+        uint32_t now = millis();
+        bool done = true;
+
+        if (root->cancelled) {
+            wait->Abort();
+            wait->result.status = SIM_ASYNC_CANCELLED;
+        }
+        else if ((root->hasDeadline && (int32_t)(now - root->deadline) >= 0) || (wait->timeout != UINT32_MAX && now - wait->start >= wait->timeout)) {
+            wait->Abort();
+            wait->result.status = SIM_ASYNC_TIMEOUT;
+        }
+        else
+            done = wait->Poll();
+
+        if (done) {
+            //Unlink before resuming, the awaiter lives in the coroutine frame
+            if (prev)
+                prev->next = next;
+            else
+                waitHead = next;
+            if (waitTail == wait)
+                waitTail = prev;
+            wait->next = nullptr;
+            wait->handle.resume();
+        }
+        else
+            prev = wait;
+
+        if (isLast)
+            break;
+        wait = next;
+    }
+
+    //Reap returned tasks
+    for (uint8_t i = 0; i < SIM7080G_CO_TASKS; i++) {
+        if (tasks[i] && tasks[i].done()) {
+            if (taskResults[i])
+                *taskResults[i] = tasks[i].promise().result;
+            tasks[i].destroy();
+            tasks[i] = nullptr;
+            taskResults[i] = nullptr;
+        }
+    }
+}
+
+//
+void SIM7080G_CO_LOOP::Queue(SIM7080G_CO_WAIT* wait) {
+    wait->next = nullptr;
+    if (waitTail)
+        waitTail->next = wait;
+    else
+        waitHead = wait;
+    waitTail = wait;
+}
+
+//
+const char* SIM7080G_CO_LOOP::FindLine(SIM7080G* modem, const char* prefix, uint32_t& mark) {
+    uint32_t first = lineSeq >= SIM7080G_CO_HISTORY ? lineSeq - SIM7080G_CO_HISTORY + 1 : 1;
+    if (mark + 1 > first)
+        first = mark + 1;
+
+    size_t prefixLength = strlen(prefix);
+    for (uint32_t seq = first; seq <= lineSeq; seq++) {
+        Line& line = history[seq % SIM7080G_CO_HISTORY];
+        if (line.seq == seq && line.modem == modem && !strncmp(line.text, prefix, prefixLength)) {
+            mark = seq;
+            return line.text;
+        }
+    }
+    return nullptr;
+}
+
+//
+void SIM7080G_CO_LOOP::LineHook(void* context, SIM7080G* modem, const char* text) {
+    SIM7080G_CO_LOOP* loop = (SIM7080G_CO_LOOP*)context;
+
+    Line& line = loop->history[++loop->lineSeq % SIM7080G_CO_HISTORY];
+    line.modem = modem;
+    line.seq = loop->lineSeq;
+    line.text[0] = '\0';
+    strncat(line.text, text, SIM7080G_CO_LINE - 1);
+}
+
+//  #
+//  #   Operations
+//  #
+
+//
+SIM7080G_CO_COMMAND CoCommand(SIM7080G& modem, const char* command, uint32_t timeout, const char* until) {
+    return SIM7080G_CO_COMMAND(modem, command, timeout, until);
+}
+
+//
+SIM7080G_CO_URC CoURC(SIM7080G& modem, const char* prefix, uint32_t timeout) {
+    return SIM7080G_CO_URC(modem, prefix, timeout);
+}
+
+//
+SIM7080G_CO_DELAY CoDelay(uint32_t ms) {
+    return SIM7080G_CO_DELAY(ms);
+}
+
+//
+SIM7080G_TASK CoActivateAppNetwork(SIM7080G& modem, uint8_t pdidx, uint32_t timeout) {
+    char command[24] = { '\0' };
+    char active[24] = { '\0' };
+    char token[24] = { '\0' };
+    sprintf(command, "AT+CNACT=%u,1\r", pdidx);
+    sprintf(active, "+CNACT: %u,1", pdidx);
+    sprintf(token, "+APP PDP: %u,ACTIVE", pdidx);
+
+    SIM7080G_CO_RESULT result = co_await CoCommand(modem, "AT+CNACT?\r", 250);
+    result.value = pdidx;
+    if (result.status == SIM_ASYNC_CANCELLED || (result.status == SIM_ASYNC_OK && strstr(result.text, active)))
+        co_return result;
+
+    //The URC can arrive together with the result code, the line history keeps it
+    result = co_await CoCommand(modem, command, 1000);
+    result.value = pdidx;
+    if (result.status != SIM_ASYNC_OK && !(result.status == SIM_ASYNC_ERROR && strstr(result.text, token)))
+        co_return result;
+
+    //The context is only usable after the module reports it active
+    result = co_await CoURC(modem, token, timeout);
+    result.value = pdidx;
+    if (result.status != SIM_ASYNC_OK)
+        co_return result;
+
+    //Verify
+    result = co_await CoCommand(modem, "AT+CNACT?\r", 250);
+    result.value = pdidx;
+    if (result.status == SIM_ASYNC_OK && !strstr(result.text, active))
+        result.status = SIM_ASYNC_ERROR;
+    co_return result;
+}
+
+#if SIM7080G_ENABLE_FTP
+/**
+ *  @brief FTP result of a failed await
+*/
+static int32_t FTPResult(SIM7080G_ASYNC status) {
+    if (status == SIM_ASYNC_TIMEOUT)
+        return SIM_FTP_TIMEOUT;
+    if (status == SIM_ASYNC_CANCELLED)
+        return SIM_FTP_MANQUIT;
+    return SIM_FTP_OTH_ERR;
+}
+
+//
+SIM7080G_TASK CoFTPUpload(SIM7080G& modem, const uint8_t* src, size_t length) {
+    SIM7080G_CO_RESULT result;
+    if (!src || !length) {
+        result.status = SIM_ASYNC_ERROR;
+        result.value = SIM_FTP_PAR_ERR;
+        co_return result;
+    }
+
+    //If in another FTP session close it
+    result = co_await CoCommand(modem, "AT+FTPSTATE\r", 250);
+    if (result.status == SIM_ASYNC_OK && strstr(result.text, "+FTPSTATE: 1"))
+        co_await CoCommand(modem, "AT+FTPQUIT\r", 1000);
+
+    //Initiate the connection, the server's reply arrives as +FTPPUT: 1,<code>,<max length>
+    result = co_await CoCommand(modem, "AT+FTPPUT=1\r");
+    if (result.status == SIM_ASYNC_OK)
+        result = co_await CoURC(modem, "+FTPPUT: 1,", 78000);
+
+    char* end = nullptr;
+    long code = result.status == SIM_ASYNC_OK ? strtol(result.text + 11, &end, 10) : 0;
+    size_t chunkLength = end && *end == ',' ? strtoul(end + 1, nullptr, 10) : 0;
+    if (result.status == SIM_ASYNC_OK && (code != 1 || !chunkLength)) {
+        result.status = SIM_ASYNC_ERROR;
+        result.value = code > 1 ? (int32_t)code : (int32_t)SIM_FTP_OTH_ERR;
+        co_return result;
+    }
+
+    char command[24] = { '\0' };
+    size_t dataSent = 0;
+
+    //Send data in segments of the length granted by the module
+    while (result.status == SIM_ASYNC_OK && dataSent < length) {
+        size_t chunk = length - dataSent < chunkLength ? length - dataSent : chunkLength;
+        sprintf(command, "AT+FTPPUT=2,%u\r", (unsigned)chunk);
+
+        //The module answers +FTPPUT: 2,<length> and expects the data
+        result = co_await CoCommand(modem, command, 75000, "+FTPPUT: 2,");
+        if (result.status != SIM_ASYNC_OK)
+            break;
+
+        const char* granted = strstr(result.text, "+FTPPUT: 2,");
+        size_t grantedLength = granted ? strtoul(granted + 11, nullptr, 10) : 0;
+        if (grantedLength && grantedLength < chunk)
+            chunk = grantedLength;
+
+        modem.Send((uint8_t*)src + dataSent, chunk);
+        dataSent += chunk;
+
+        //Wait for the module to accept more data
+        result = co_await CoURC(modem, "+FTPPUT: 1,", 75000);
+        if (result.status != SIM_ASYNC_OK)
+            break;
+
+        code = strtol(result.text + 11, &end, 10);
+        if (code != 1) {
+            result.status = SIM_ASYNC_ERROR;
+            result.value = code;
+            break;
+        }
+        if (*end == ',' && strtoul(end + 1, nullptr, 10))
+            chunkLength = strtoul(end + 1, nullptr, 10);
+    }
+
+    //End FTP transaction, +FTPPUT: 1,0 confirms the upload
+    if (result.status == SIM_ASYNC_OK) {
+        result = co_await CoCommand(modem, "AT+FTPPUT=2,0\r", 75000);
+        if (result.status == SIM_ASYNC_OK)
+            result = co_await CoURC(modem, "+FTPPUT: 1,", 75000);
+
+        if (result.status == SIM_ASYNC_OK) {
+            code = strtol(result.text + 11, nullptr, 10);
+            result.status = code ? SIM_ASYNC_ERROR : SIM_ASYNC_OK;
+            result.value = code ? (code > 1 ? (int32_t)code : (int32_t)SIM_FTP_UPL_ERR) : (int32_t)SIM_FTP_SUCCESS;
+            co_return result;
+        }
+    }
+
+    if (!result.value)
+        result.value = FTPResult(result.status);
+
+    //Leave the session like the blocking FTPUpload() does. An abandoned command keeps the
+    //slot until its result code arrived, a blocking command would take that result instead
+    if (modem.CommandPoll() == SIM_ASYNC_PENDING)
+        co_await CoCommand(modem, "AT+FTPQUIT\r", 1000);
+    else
+        modem.CloseFTPSession();
+    co_return result;
+}
+#endif
+
+#endif  //__cpp_impl_coroutine
@@ -0,0 +1,346 @@
+#ifndef SIM7080G_CO_H
+#define SIM7080G_CO_H
+
+#include "sim7080g.h"
+
+/*
+    Awaitable modem operations (C++20 coroutines)
+
+    Coroutines returning SIM7080G_TASK are run by a SIM7080G_CO_LOOP, which
+    drives the Loop() of the attached modems and resumes the coroutines
+    whose command, URC or delay completed. Several sequences interleave on
+    one thread, one AT command per modem is in flight at a time.
+
+        SIM7080G_TASK Report(SIM7080G& modem) {
+            SIM7080G_CO_RESULT r = co_await CoActivateAppNetwork(modem, 0);
+            if (r.status != SIM_ASYNC_OK)
+                co_return r;
+            r = co_await CoCommand(modem, "AT+CSQ\r");
+            ...
+        }
+
+        coLoop.Attach(modem);
+        coLoop.Spawn(Report(modem), 60000);
+        while (coLoop.Busy())
+            coLoop.Poll();
+
+    Do not call blocking driver functions on an attached modem while one of
+    its commands is pending. Poll() does not run the blocking services of
+    Loop(), call Loop() between the tasks for them.
+*/
+
+#if defined(__cpp_impl_coroutine) && SIM7080G_ENABLE_ASYNC
+
+#include <coroutine>
+
+//
+//  Config
+//
+#ifndef SIM7080G_CO_TASKS
+#define SIM7080G_CO_TASKS                   8       //Number of spawned tasks a loop runs at once
+#endif
+#ifndef SIM7080G_CO_MODEMS
+#define SIM7080G_CO_MODEMS                  4       //Number of modems a loop drives
+#endif
+#ifndef SIM7080G_CO_HISTORY
+#define SIM7080G_CO_HISTORY                 16      //Received lines kept for URC awaiters
+#endif
+#ifndef SIM7080G_CO_LINE
+#define SIM7080G_CO_LINE                    96      //Max length of a kept line
+#endif
+
+
+/**
+ *  @brief Result of an awaited operation
+*/
+struct SIM7080G_CO_RESULT {
+    SIM7080G_ASYNC status = SIM_ASYNC_IDLE;     //SIM_ASYNC_OK on success
+    int32_t value = 0;                          //Operation specific value (e.g. SIM7080G_FTP_RESULT)
+    const char* text = nullptr;                 //Command response or URC line, valid until the next co_await
+};
+
+class SIM7080G_CO_LOOP;
+
+/**
+ *  @brief Coroutine of modem operations. Starts when spawned on a loop or awaited by another task.
+*/
+class SIM7080G_TASK {
+
+public:
+
+    struct promise_type {
+        SIM7080G_CO_RESULT result;
+        std::coroutine_handle<> continuation;   //Awaiting task, resumed when this one returns
+        promise_type* parent = nullptr;         //Promise of the awaiting task
+        promise_type* root = this;              //Spawned task owning the deadline and cancellation
+        SIM7080G_CO_LOOP* loop = nullptr;       //Loop running the task
+        uint32_t deadline = 0;                  //Deadline of the spawned task (millis())
+        bool hasDeadline = false;
+        bool cancelled = false;
+        uint32_t urcMark = 0;                   //URC awaiters only see lines received after this sequence number
+
+        SIM7080G_TASK get_return_object() noexcept;
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept;
+            void await_resume() noexcept {}
+        };
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        void return_value(SIM7080G_CO_RESULT value) noexcept { result = value; }
+        void unhandled_exception() noexcept { result.status = SIM_ASYNC_ERROR; }
+    };
+
+    SIM7080G_TASK(SIM7080G_TASK&& other) noexcept;
+    SIM7080G_TASK& operator=(SIM7080G_TASK&& other) noexcept;
+    SIM7080G_TASK(const SIM7080G_TASK&) = delete;
+    SIM7080G_TASK& operator=(const SIM7080G_TASK&) = delete;
+    ~SIM7080G_TASK();
+
+    //Awaiting a task runs it as a child of the awaiting one
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> parent) noexcept;
+    SIM7080G_CO_RESULT await_resume() noexcept { return handle.promise().result; }
+
+private:
+
+    friend class SIM7080G_CO_LOOP;
+
+    explicit SIM7080G_TASK(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+    std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ *  @brief Base of the awaitables, queued on the loop until Poll() reports completion
+*/
+class SIM7080G_CO_WAIT {
+
+    friend class SIM7080G_CO_LOOP;
+
+public:
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<SIM7080G_TASK::promise_type> handle);
+    SIM7080G_CO_RESULT await_resume() const noexcept { return result; }
+
+protected:
+
+    explicit SIM7080G_CO_WAIT(uint32_t timeout) : timeout(timeout) {}
+
+    /**
+     *  @brief Advance the operation
+     *
+     *  @returns True once result is set
+    */
+    virtual bool Poll(void) = 0;
+
+    /**
+     *  @brief Undo a started operation after a timeout, deadline or cancellation
+    */
+    virtual void Abort(void) {}
+
+    SIM7080G_TASK::promise_type* promise = nullptr;     //Awaiting task
+    SIM7080G_CO_RESULT result;
+    uint32_t start = 0;                         //Time the wait began
+    uint32_t timeout;                           //Max wait in ms (UINT32_MAX: only the task deadline applies)
+
+private:
+
+    SIM7080G_CO_WAIT* next = nullptr;           //Next awaiter queued on the loop
+    std::coroutine_handle<> handle;             //Coroutine resumed on completion
+};
+
+/**
+ *  @brief Awaitable AT command, waits for a free command slot of the modem
+*/
+class SIM7080G_CO_COMMAND : public SIM7080G_CO_WAIT {
+
+public:
+
+    SIM7080G_CO_COMMAND(SIM7080G& modem, const char* command, uint32_t timeout, const char* until);
+
+protected:
+
+    bool Poll(void) override;
+    void Abort(void) override;
+
+private:
+
+    SIM7080G& modem;
+    const char* command;
+    const char* until;
+    uint32_t commandTimeout;                    //Result timeout, starts once the command is sent
+    bool started = false;
+};
+
+/**
+ *  @brief Awaitable URC line
+*/
+class SIM7080G_CO_URC : public SIM7080G_CO_WAIT {
+
+public:
+
+    SIM7080G_CO_URC(SIM7080G& modem, const char* prefix, uint32_t timeout);
+
+protected:
+
+    bool Poll(void) override;
+
+private:
+
+    SIM7080G& modem;
+    const char* prefix;
+};
+
+/**
+ *  @brief Awaitable delay
+*/
+class SIM7080G_CO_DELAY : public SIM7080G_CO_WAIT {
+
+public:
+
+    explicit SIM7080G_CO_DELAY(uint32_t ms);
+
+protected:
+
+    bool Poll(void) override;
+
+private:
+
+    uint32_t ms;
+};
+
+/**
+ *  @brief Event loop running SIM7080G_TASKs
+*/
+class SIM7080G_CO_LOOP {
+
+    friend class SIM7080G_CO_WAIT;
+    friend class SIM7080G_CO_URC;
+    friend class SIM7080G_CO_COMMAND;
+
+    //Driven modems
+    SIM7080G* modems[SIM7080G_CO_MODEMS] = { nullptr };
+
+    //Spawned tasks
+    std::coroutine_handle<SIM7080G_TASK::promise_type> tasks[SIM7080G_CO_TASKS];
+    SIM7080G_CO_RESULT* taskResults[SIM7080G_CO_TASKS] = { nullptr };
+
+    //Queued awaiters
+    SIM7080G_CO_WAIT* waitHead = nullptr;
+    SIM7080G_CO_WAIT* waitTail = nullptr;
+
+    //Received lines (ring buffer)
+    struct Line {
+        SIM7080G* modem = nullptr;
+        uint32_t seq = 0;
+        char text[SIM7080G_CO_LINE] = { '\0' };
+    };
+    Line history[SIM7080G_CO_HISTORY];
+    uint32_t lineSeq = 0;                       //Sequence number of the last received line
+
+public:
+
+    SIM7080G_CO_LOOP() = default;
+    ~SIM7080G_CO_LOOP();
+    SIM7080G_CO_LOOP(const SIM7080G_CO_LOOP&) = delete;
+    SIM7080G_CO_LOOP& operator=(const SIM7080G_CO_LOOP&) = delete;
+
+    /**
+     *  @brief Drive a modem from this loop, installs its URC hook
+     *
+     *  @returns False if all modem slots are used
+    */
+    bool Attach(SIM7080G& modem);
+
+    /**
+     *  @brief Stop driving a modem
+    */
+    void Detach(SIM7080G& modem);
+
+    /**
+     *  @brief Start a task
+     *
+     *  @param task Task to run
+     *  @param deadline Max run time in ms (0: none), awaits fail with SIM_ASYNC_TIMEOUT after it
+     *  @param result Receives the result when the task returns (optional)
+     *
+     *  @returns Task id or -1 if all task slots are used
+    */
+    int Spawn(SIM7080G_TASK task, uint32_t deadline = 0, SIM7080G_CO_RESULT* result = nullptr);
+
+    /**
+     *  @brief Cancel a task, its pending and following awaits fail with SIM_ASYNC_CANCELLED
+    */
+    bool Cancel(int id);
+
+    /**
+     *  @brief Whether a task has returned (or the id is unused)
+    */
+    bool Done(int id) const;
+
+    /**
+     *  @brief Number of running tasks
+    */
+    uint8_t Busy(void) const;
+
+    /**
+     *  @brief Run Loop() of the modems, resume completed awaits and reap returned tasks. Call periodically.
+     * 
+     *  The modems are polled with Loop(false). The network unlock after a
+     *  lost cached registration, signal sampling, deferred transmissions and
+     *  time synchronisation block, call Loop() of the modem for them while
+     *  none of its commands is pending.
+    */
+    void Poll(void);
+
+private:
+
+    void Queue(SIM7080G_CO_WAIT* wait);
+    const char* FindLine(SIM7080G* modem, const char* prefix, uint32_t& mark);
+    static void LineHook(void* context, SIM7080G* modem, const char* line);
+};
+
+
+//
+//  Operations
+//
+
+/**
+ *  @brief Send a command and await its result code
+ *
+ *  @param until Line prefix that completes the command before a result code
+*/
+SIM7080G_CO_COMMAND CoCommand(SIM7080G& modem, const char* command, uint32_t timeout = 1000, const char* until = nullptr);
+
+/**
+ *  @brief Await a line starting with prefix, received after the task's last command was sent
+*/
+SIM7080G_CO_URC CoURC(SIM7080G& modem, const char* prefix, uint32_t timeout);
+
+/**
+ *  @brief Await a delay
+*/
+SIM7080G_CO_DELAY CoDelay(uint32_t ms);
+
+/**
+ *  @brief Activate an APP network and verify it with AT+CNACT?
+ *
+ *  @returns SIM_ASYNC_OK once the context is active
+*/
+SIM7080G_TASK CoActivateAppNetwork(SIM7080G& modem, uint8_t pdidx, uint32_t timeout = 30000);
+
+#if SIM7080G_ENABLE_FTP
+/**
+ *  @brief Upload data to the FTP server configured with the SetFTP...() functions
+ *
+ *  @returns value: SIM7080G_FTP_RESULT
+*/
+SIM7080G_TASK CoFTPUpload(SIM7080G& modem, const uint8_t* src, size_t length);
+#endif
+
+#endif  //__cpp_impl_coroutine
+
+#endif  //SIM7080G_CO_H